@@ -40,45 +40,40 @@ waitdisk(void) {
         /* do nothing */;
 }
 
-/* readsect - read a single sector at @secno into @dst */
-static void
-readsect(void *dst, uint32_t secno) {
-    // wait for disk to be ready
-    waitdisk();
-
-    outb(0x1F2, 1);                         // count = 1
-    outb(0x1F3, secno & 0xFF);
-    outb(0x1F4, (secno >> 8) & 0xFF);
-    outb(0x1F5, (secno >> 16) & 0xFF);
-    outb(0x1F6, ((secno >> 24) & 0xF) | 0xE0);
-    outb(0x1F7, 0x20);                      // cmd 0x20 - read sectors
-
-    // wait for disk to be ready
-    waitdisk();
-
-    // read a sector
-    insl(0x1F0, dst, SECTSIZE / 4);
-}
-
 /* *
  * readseg - read @count bytes at @offset from kernel into virtual address @va,
  * might copy more than asked.
  * */
 static void
 readseg(uintptr_t va, uint32_t count, uint32_t offset) {
-    uintptr_t end_va = va + count;
-
     // round down to sector boundary
     va -= offset % SECTSIZE;
+    count += offset % SECTSIZE;
 
     // translate from bytes to sectors; kernel starts at sector 1
     uint32_t secno = (offset / SECTSIZE) + 1;
-
-    // If this is too slow, we could read lots of sectors at a time.
-    // We'd write more to memory than asked, but it doesn't matter --
-    // we load in increasing order.
-    for (; va < end_va; va += SECTSIZE, secno ++) {
-        readsect((void *)va, secno);
+    uint32_t nsect = (count + SECTSIZE - 1) / SECTSIZE, left;
+
+    // Read lots of sectors at a time, 256 at most per command (count 0): the
+    // first command reads nsect % 256 of them (or 256), the others 256 each.
+    for (left = nsect; left > 0; left --, va += SECTSIZE, secno ++) {
+        if (left == nsect || left % 256 == 0) {
+            // wait for disk to be ready
+            waitdisk();
+
+            outb(0x1F2, left);                      // count = left % 256
+            outb(0x1F3, secno & 0xFF);
+            outb(0x1F4, (secno >> 8) & 0xFF);
+            outb(0x1F5, (secno >> 16) & 0xFF);
+            outb(0x1F6, ((secno >> 24) & 0xF) | 0xE0);
+            outb(0x1F7, 0x20);                      // cmd 0x20 - read sectors
+        }
+
+        // wait for the next sector to be ready
+        waitdisk();
+
+        // read a sector
+        insl(0x1F0, (void *)va, SECTSIZE / 4);
     }
 }
 
@@ -99,7 +94,10 @@ bootmain(void) {
     ph = (struct proghdr *)((uintptr_t)ELFHDR + ELFHDR->e_phoff);
     eph = ph + ELFHDR->e_phnum;
     for (; ph < eph; ph ++) {
-        readseg(ph->p_va & 0xFFFFFF, ph->p_memsz, ph->p_offset);
+        // read the file image of the segment, and zero the rest (bss)
+        uintptr_t va = ph->p_va & 0xFFFFFF;
+        readseg(va, ph->p_filesz, ph->p_offset);
+        __memset((void *)(va + ph->p_filesz), 0, ph->p_memsz - ph->p_filesz);
     }
 
     // call the entry point from the ELF header
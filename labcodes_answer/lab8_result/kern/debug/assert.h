@@ -19,6 +19,22 @@ void __noreturn __panic(const char *file, int line, const char *fmt, ...);
         }                                               \
     } while (0)
 
+// self_check(x) runs the boot time self check x. Built with "DEFS+=-DNO_SELF_CHECK"
+// the checks are compiled out: x is still type checked, but never run.
+#ifdef NO_SELF_CHECK
+#define self_check(x)                                   \
+    do {                                                \
+        if (0) {                                        \
+            x;                                          \
+        }                                               \
+    } while (0)
+#else
+#define self_check(x)                                   \
+    do {                                                \
+        x;                                              \
+    } while (0)
+#endif
+
 // static_assert(x) will generate a compile-time error if 'x' is false.
 #define static_assert(x)                                \
     switch (x) { case 0: case (x): ; }
@@ -0,0 +1,76 @@
+#include <defs.h>
+#include <stdio.h>
+#include <x86.h>
+#include <clock.h>
+#include <boottime.h>
+
+static struct boot_phase {
+    const char *name;
+    uint64_t start, end;                    // TSC
+} phases[BOOT_MAX_PHASES];
+
+static int nphases, nlost;
+static uint64_t boot_tsc;                   // TSC at the entry of kern_init
+
+/*
+ * boot_time_init - called by kern_init once bss is cleared, start_tsc is the
+ *                  TSC read at its entry
+ */
+void
+boot_time_init(uint64_t start_tsc) {
+    boot_tsc = start_tsc;
+    nphases = nlost = 0;
+}
+
+/*
+ * boot_phase_record - the init phase name ran from start_tsc to end_tsc
+ */
+void
+boot_phase_record(const char *name, uint64_t start_tsc, uint64_t end_tsc) {
+    if (nphases < BOOT_MAX_PHASES) {
+        struct boot_phase *phase = phases + nphases ++;
+        phase->name = name, phase->start = start_tsc, phase->end = end_tsc;
+    }
+    else {
+        nlost ++;
+    }
+}
+
+/* cycles2usec - convert TSC cycles into usec with the calibrated frequency */
+static unsigned int
+cycles2usec(uint64_t cycles, uint32_t khz) {
+    cycles *= 1000;
+    do_div(cycles, khz);
+    return (unsigned int)cycles;
+}
+
+/*
+ * boot_time_report - print the recorded phases, in usec once the TSC is
+ *                    calibrated by clock_init, in cycles otherwise
+ */
+void
+boot_time_report(void) {
+    uint32_t khz = clock_tsc_khz();
+    uint64_t now = rdtsc();
+    int i;
+    cprintf("boot time (%s since kern_init):\n", (khz != 0) ? "usec" : "cycles");
+    for (i = 0; i < nphases; i ++) {
+        struct boot_phase *phase = phases + i;
+        uint64_t at = phase->start - boot_tsc, took = phase->end - phase->start;
+        if (khz != 0) {
+            cprintf("  %-24s at %8u, took %8u\n", phase->name, cycles2usec(at, khz), cycles2usec(took, khz));
+        }
+        else {
+            cprintf("  %-24s at %12llu, took %12llu\n", phase->name, at, took);
+        }
+    }
+    if (nlost != 0) {
+        cprintf("  (%d phases not recorded)\n", nlost);
+    }
+    if (khz != 0) {
+        cprintf("  %-24s at %8u\n", "first user process", cycles2usec(now - boot_tsc, khz));
+    }
+    else {
+        cprintf("  %-24s at %12llu\n", "first user process", now - boot_tsc);
+    }
+}
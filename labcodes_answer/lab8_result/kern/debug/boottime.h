@@ -0,0 +1,27 @@
+#ifndef __KERN_DEBUG_BOOTTIME_H__
+#define __KERN_DEBUG_BOOTTIME_H__
+
+#include <defs.h>
+#include <x86.h>
+
+/*
+ * Boot time profile. Each init phase run through boot_phase is timed with the
+ * TSC, and boot_time_report (called by init_main, just before the first user
+ * process) prints when each phase started and how long it took, counted from
+ * the entry of kern_init.
+ */
+
+#define BOOT_MAX_PHASES         24          // # of phases recorded
+
+void boot_time_init(uint64_t start_tsc);
+void boot_phase_record(const char *name, uint64_t start_tsc, uint64_t end_tsc);
+void boot_time_report(void);
+
+#define boot_phase(call)                                            \
+    do {                                                            \
+        uint64_t __start_tsc = rdtsc();                             \
+        call;                                                       \
+        boot_phase_record(#call, __start_tsc, rdtsc());             \
+    } while (0)
+
+#endif /* !__KERN_DEBUG_BOOTTIME_H__ */
@@ -4,6 +4,9 @@
 #include <trap.h>
 #include <kmonitor.h>
 #include <kdebug.h>
+#include <sched.h>
+#include <perf.h>
+#include <lockstat.h>
 
 /* *
  * Simple command-line kernel monitor useful for controlling the
@@ -21,6 +24,9 @@ static struct command commands[] = {
     {"help", "Display this list of commands.", mon_help},
     {"kerninfo", "Display information about the kernel.", mon_kerninfo},
     {"backtrace", "Print backtrace of stack frame.", mon_backtrace},
+    {"schedstat", "Print the scheduler accounting of all processes.", mon_schedstat},
+    {"perf", "Sampling profiler: perf start|stop|report.", mon_perf},
+    {"lockstat", "Print the lock statistics: lockstat [reset].", mon_lockstat},
 };
 
 /* return if kernel is panic, in kern/debug/panic.c */
@@ -130,3 +136,52 @@ mon_backtrace(int argc, char **argv, struct trapframe *tf) {
     return 0;
 }
 
+/* *
+ * mon_schedstat - call sched_print_stat in kern/schedule/sched.c to print
+ * the scheduler accounting of all processes.
+ * */
+int
+mon_schedstat(int argc, char **argv, struct trapframe *tf) {
+    sched_print_stat();
+    return 0;
+}
+
+/* *
+ * mon_perf - start or stop the sampling profiler in kern/debug/perf.c, or
+ * report its samples by function.
+ * */
+int
+mon_perf(int argc, char **argv, struct trapframe *tf) {
+    if (argc == 1 && strcmp(argv[0], "start") == 0) {
+        perf_start();
+    }
+    else if (argc == 1 && strcmp(argv[0], "stop") == 0) {
+        perf_stop();
+    }
+    else if (argc == 1 && strcmp(argv[0], "report") == 0) {
+        perf_report();
+    }
+    else {
+        cprintf("usage: perf start|stop|report\n");
+    }
+    return 0;
+}
+
+/* *
+ * mon_lockstat - print the statistics of the contended kernel locks, kept in
+ * kern/debug/lockstat.c, or clear them.
+ * */
+int
+mon_lockstat(int argc, char **argv, struct trapframe *tf) {
+    if (argc == 0) {
+        lockstat_report();
+    }
+    else if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+        lockstat_reset();
+    }
+    else {
+        cprintf("usage: lockstat [reset]\n");
+    }
+    return 0;
+}
+
@@ -0,0 +1,214 @@
+#include <defs.h>
+#include <stdio.h>
+#include <string.h>
+#include <list.h>
+#include <x86.h>
+#include <sync.h>
+#include <memlayout.h>
+#include <proc.h>
+#include <kdebug.h>
+#include <lockstat.h>
+
+#define LOCKSTAT_REPORT_TOP     16          // # of classes printed
+
+#ifdef LOCKSTAT
+
+static list_entry_t class_list = {&class_list, &class_list};
+
+/*
+ * lockstat_init_class - add class to the class list at the first lock initialized
+ *                       at its init site
+ */
+void
+lockstat_init_class(struct lock_class *class, bool mutex) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if (!class->registered) {
+            class->registered = 1, class->mutex = mutex;
+            list_add_before(&class_list, &(class->class_link));
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+void
+lockstat_acquired(struct lock_class *class) {
+    class->nacquire ++;
+}
+
+/*
+ * lockstat_callchain - the return addresses of the callers, walked through the
+ *                      frame pointers in the kernel stack of current
+ */
+static void
+lockstat_callchain(uintptr_t *callchain) {
+    int depth = 0;
+    if (current != NULL) {
+        uintptr_t ebp = read_ebp(), base = current->kstack, top = base + KSTACKSIZE;
+        while (depth < LOCKSTAT_DEPTH && ebp >= base && ebp + 2 * sizeof(uintptr_t) <= top) {
+            uintptr_t *frame = (uintptr_t *)ebp;
+            callchain[depth ++] = frame[1];
+            if (frame[0] <= ebp) {
+                break;
+            }
+            ebp = frame[0];
+        }
+    }
+    while (depth < LOCKSTAT_DEPTH) {
+        callchain[depth ++] = 0;
+    }
+}
+
+/*
+ * lockstat_contended - an acquisition of class waited for wait_nsec, count it
+ *                      to the callchain of the caller
+ */
+void __noinline
+lockstat_contended(struct lock_class *class, uint64_t wait_nsec) {
+    uintptr_t callchain[LOCKSTAT_DEPTH];
+    lockstat_callchain(callchain);
+
+    class->ncontend ++, class->wait_nsec += wait_nsec;
+    if (class->max_wait_nsec < wait_nsec) {
+        class->max_wait_nsec = wait_nsec;
+    }
+    int i;
+    for (i = 0; i < LOCKSTAT_NSITE; i ++) {
+        if (class->sites[i].count == 0) {
+            memcpy(class->sites[i].callchain, callchain, sizeof(callchain));
+            break;
+        }
+        if (memcmp(class->sites[i].callchain, callchain, sizeof(callchain)) == 0) {
+            break;
+        }
+    }
+    if (i == LOCKSTAT_NSITE) {
+        class->nsite_lost ++;
+    }
+    else {
+        class->sites[i].count ++;
+    }
+}
+
+void
+lockstat_released(struct lock_class *class, uint64_t hold_nsec) {
+    class->nhold ++, class->hold_nsec += hold_nsec;
+    if (class->max_hold_nsec < hold_nsec) {
+        class->max_hold_nsec = hold_nsec;
+    }
+}
+
+/*
+ * lockstat_reset - clear the statistics of all classes
+ */
+void
+lockstat_reset(void) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        list_entry_t *le = &class_list;
+        while ((le = list_next(le)) != &class_list) {
+            struct lock_class *class = to_struct(le, struct lock_class, class_link);
+            class->nacquire = class->ncontend = class->nhold = class->nsite_lost = 0;
+            class->wait_nsec = class->max_wait_nsec = 0;
+            class->hold_nsec = class->max_hold_nsec = 0;
+            memset(class->sites, 0, sizeof(class->sites));
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+static unsigned int
+nsec2usec(uint64_t nsec) {
+    do_div(nsec, 1000);
+    return (unsigned int)nsec;
+}
+
+/*
+ * lockstat_print_callchain - print the callers in a callchain, from the
+ *                            first one outside the lock functions
+ */
+static void
+lockstat_print_callchain(uint32_t count, uintptr_t *callchain) {
+    struct eipdebuginfo info;
+    int i, n = 0;
+    cprintf("    %8u ", count);
+    for (i = 0; i < LOCKSTAT_DEPTH && callchain[i] != 0; i ++) {
+        if (debuginfo_eip(callchain[i] - 1, &info) != 0) {
+            cprintf(" <- 0x%08x", callchain[i]);
+        }
+        else if (n != 0 || (strcmp(info.eip_file, "kern/sync/sem.c") != 0
+                    && strcmp(info.eip_file, "kern/sync/rwsem.c") != 0
+                    && strcmp(info.eip_file, "kern/debug/lockstat.c") != 0)) {
+            cprintf("%s%.*s", (n ++ == 0) ? " " : " <- ", info.eip_fn_namelen, info.eip_fn_name);
+        }
+    }
+    cprintf("\n");
+}
+
+/*
+ * lockstat_report - print the classes with the longest total wait, and the
+ *                   callchains contending on them
+ */
+void
+lockstat_report(void) {
+    struct lock_class *classes[LOCKSTAT_REPORT_TOP];
+    int nclass = 0, nall = 0, i, j;
+    list_entry_t *le = &class_list;
+    while ((le = list_next(le)) != &class_list) {
+        struct lock_class *class = to_struct(le, struct lock_class, class_link);
+        nall ++;
+        if (class->nacquire == 0) {
+            continue;
+        }
+        // insertion sort by wait time (then by acquisitions), keep the top ones
+        for (i = nclass; i > 0; i --) {
+            struct lock_class *prev = classes[i - 1];
+            if (prev->wait_nsec > class->wait_nsec
+                    || (prev->wait_nsec == class->wait_nsec && prev->nacquire >= class->nacquire)) {
+                break;
+            }
+            if (i < LOCKSTAT_REPORT_TOP) {
+                classes[i] = prev;
+            }
+        }
+        if (i < LOCKSTAT_REPORT_TOP) {
+            classes[i] = class;
+            if (nclass < LOCKSTAT_REPORT_TOP) {
+                nclass ++;
+            }
+        }
+    }
+
+    cprintf("lockstat: %d lock classes, %d used\n", nall, nclass);
+    for (i = 0; i < nclass; i ++) {
+        struct lock_class *class = classes[i];
+        cprintf("%s (%s:%d)\n", class->name, class->file, class->line);
+        cprintf("  acquire %u, contend %u, wait %u us (max %u us)", class->nacquire, class->ncontend,
+                nsec2usec(class->wait_nsec), nsec2usec(class->max_wait_nsec));
+        if (class->mutex) {
+            cprintf(", hold %u us (max %u us)", nsec2usec(class->hold_nsec), nsec2usec(class->max_hold_nsec));
+        }
+        cprintf("\n");
+        for (j = 0; j < LOCKSTAT_NSITE && class->sites[j].count != 0; j ++) {
+            lockstat_print_callchain(class->sites[j].count, class->sites[j].callchain);
+        }
+        if (class->nsite_lost != 0) {
+            cprintf("    %8u  (other callers)\n", class->nsite_lost);
+        }
+    }
+}
+
+#else /* !LOCKSTAT */
+
+void
+lockstat_reset(void) {
+}
+
+void
+lockstat_report(void) {
+    cprintf("lockstat: not compiled in, build with \"DEFS+=-DLOCKSTAT\".\n");
+}
+
+#endif /* LOCKSTAT */
@@ -0,0 +1,65 @@
+#ifndef __KERN_DEBUG_LOCKSTAT_H__
+#define __KERN_DEBUG_LOCKSTAT_H__
+
+#include <defs.h>
+#include <list.h>
+
+/*
+ * Lock statistics for kernel semaphores and rw-semaphores. Build with
+ * "DEFS+=-DLOCKSTAT" to compile them in; otherwise all the hooks below are
+ * empty and the locks carry no extra fields.
+ *
+ * A lock class is the init site of a lock (sem_init/rwsem_init), so all the
+ * inode semaphores are one class, all the fs_sem ones another. For each
+ * class: acquisitions, contended acquisitions, the time spent waiting and,
+ * for the locks used as mutexes (initialized to 1, or any rwsem writer), the
+ * time held. The callchains of the contended acquisitions show which caller
+ * waits. "lockstat" in the kernel monitor prints them.
+ */
+
+#define LOCKSTAT_NSITE          4           // # of contending callchains kept per class
+#define LOCKSTAT_DEPTH          5           // # of return addresses of a callchain
+
+struct lock_class {
+    const char *name;                       // the lock expression at the init site
+    const char *file;
+    int line;
+    bool registered;                        // BOOL: in the class list
+    bool mutex;                             // BOOL: hold time is measured
+    list_entry_t class_link;
+    uint32_t nacquire;                      // # of acquisitions
+    uint32_t ncontend;                      // # of acquisitions that had to wait
+    uint32_t nhold;                         // # of measured hold times
+    uint64_t wait_nsec, max_wait_nsec;
+    uint64_t hold_nsec, max_hold_nsec;
+    struct {
+        uint32_t count;
+        uintptr_t callchain[LOCKSTAT_DEPTH];
+    } sites[LOCKSTAT_NSITE];
+    uint32_t nsite_lost;                    // # of contentions from other callchains
+};
+
+#ifdef LOCKSTAT
+
+#define LOCK_CLASS(lock)                                                                \
+    ({                                                                                  \
+        static struct lock_class __class = {.name = #lock, .file = __FILE__,            \
+                                            .line = __LINE__};                          \
+        &__class;                                                                       \
+    })
+
+void lockstat_init_class(struct lock_class *class, bool mutex);
+void lockstat_acquired(struct lock_class *class);
+void lockstat_contended(struct lock_class *class, uint64_t wait_nsec);
+void lockstat_released(struct lock_class *class, uint64_t hold_nsec);
+
+#else
+
+#define LOCK_CLASS(lock)                        NULL
+
+#endif /* LOCKSTAT */
+
+void lockstat_reset(void);
+void lockstat_report(void);
+
+#endif /* !__KERN_DEBUG_LOCKSTAT_H__ */
@@ -0,0 +1,203 @@
+#include <defs.h>
+#include <stdio.h>
+#include <string.h>
+#include <mmu.h>
+#include <memlayout.h>
+#include <pmm.h>
+#include <vmm.h>
+#include <trap.h>
+#include <proc.h>
+#include <kdebug.h>
+#include <perf.h>
+
+/*
+ * Sampling profiler. While started, each timer interrupt records the
+ * interrupted eip and a short callchain, walked through the saved frame
+ * pointers, into a ring buffer (ucore runs on one cpu, so there is one
+ * buffer). perf_report folds the samples into functions with debuginfo_eip.
+ *
+ * The stabs of a user program are only mapped in its own address space,
+ * so user samples are reported by process, not by function.
+ */
+
+#define PERF_NENTRY             128         // # of functions reported at most
+#define PERF_REPORT_TOP         20          // # of functions printed
+
+static struct perf_sample perf_buf[PERF_NSAMPLE];
+static unsigned int perf_nsample;           // # of samples taken, the last PERF_NSAMPLE are kept
+static bool perf_enabled = 0;
+
+// perf_start - drop the old samples and start sampling
+void
+perf_start(void) {
+    perf_nsample = 0;
+    perf_enabled = 1;
+}
+
+void
+perf_stop(void) {
+    perf_enabled = 0;
+}
+
+// perf_running - samples are taken, they need the periodic tick
+bool
+perf_running(void) {
+    return perf_enabled;
+}
+
+// perf_user_readable - test if the word at addr can be read in mm without a page fault
+static bool
+perf_user_readable(struct mm_struct *mm, uintptr_t addr) {
+    pte_t *ptep;
+    if (mm == NULL || addr < UTEXT || addr + sizeof(uintptr_t) > USERTOP) {
+        return 0;
+    }
+    ptep = get_pte(mm->pgdir, addr, 0);
+    return ptep != NULL && (*ptep & (PTE_P | PTE_U)) == (PTE_P | PTE_U);
+}
+
+/*
+ * perf_sample - called at each timer interrupt. The callchain follows the
+ *               frame pointers while they stay in the kernel stack of current
+ *               (or in mapped user memory) and move up the stack.
+ */
+void
+perf_sample(struct trapframe *tf) {
+    if (!perf_enabled) {
+        return;
+    }
+    struct perf_sample *sample = perf_buf + (perf_nsample ++) % PERF_NSAMPLE;
+    sample->eip = tf->tf_eip;
+    sample->pid = current->pid;
+    sample->user = !trap_in_kernel(tf);
+    sample->depth = 0;
+
+    uintptr_t ebp = tf->tf_regs.reg_ebp, base = current->kstack, top = base + KSTACKSIZE;
+    while (sample->depth < PERF_MAX_DEPTH && ebp != 0 && ebp % sizeof(uintptr_t) == 0) {
+        if (sample->user) {
+            if (!perf_user_readable(current->mm, ebp) ||
+                !perf_user_readable(current->mm, ebp + sizeof(uintptr_t))) {
+                break;
+            }
+        }
+        else if (ebp < base || ebp + 2 * sizeof(uintptr_t) > top) {
+            break;
+        }
+        uintptr_t *frame = (uintptr_t *)ebp;
+        sample->callchain[sample->depth ++] = frame[1];
+        if (frame[0] <= ebp) {
+            break;
+        }
+        ebp = frame[0];
+    }
+}
+
+/* a function (or the user mode of a process) in the report */
+struct perf_entry {
+    uintptr_t addr;                         // start of the function, or pid if user
+    bool user;
+    char name[32];
+    unsigned int self;                      // # of samples in it
+    unsigned int total;                     // # of samples in it or in its callees
+};
+
+static struct perf_entry perf_entries[PERF_NENTRY];
+static int perf_nentry;
+
+// perf_lookup - the entry of the kernel function at eip, or of user process pid
+static struct perf_entry *
+perf_lookup(uintptr_t eip, int pid, bool user) {
+    uintptr_t addr = pid;
+    struct eipdebuginfo info;
+    bool found = 0;
+    if (!user) {
+        found = (debuginfo_eip(eip, &info) == 0);
+        addr = info.eip_fn_addr;
+    }
+    int i;
+    for (i = 0; i < perf_nentry; i ++) {
+        if (perf_entries[i].addr == addr && perf_entries[i].user == user) {
+            return perf_entries + i;
+        }
+    }
+    if (perf_nentry == PERF_NENTRY) {
+        return NULL;
+    }
+    struct perf_entry *entry = perf_entries + (perf_nentry ++);
+    entry->addr = addr, entry->user = user;
+    entry->self = entry->total = 0;
+    if (user) {
+        snprintf(entry->name, sizeof(entry->name), "[user pid %d]", pid);
+    }
+    else if (!found) {
+        snprintf(entry->name, sizeof(entry->name), "0x%08x", eip);
+    }
+    else {
+        int len = info.eip_fn_namelen;
+        if (len >= sizeof(entry->name)) {
+            len = sizeof(entry->name) - 1;
+        }
+        memcpy(entry->name, info.eip_fn_name, len);
+        entry->name[len] = '\0';
+    }
+    return entry;
+}
+
+/*
+ * perf_report - print the functions with the most samples. A sample counts
+ *               as self for the function it hit, and as total for it and the
+ *               kernel functions in its callchain (once each).
+ */
+void
+perf_report(void) {
+    bool enabled = perf_enabled;
+    perf_enabled = 0;
+
+    unsigned int n = (perf_nsample < PERF_NSAMPLE) ? perf_nsample : PERF_NSAMPLE;
+    unsigned int i, nlost = 0;
+    int j, k;
+    perf_nentry = 0;
+    for (i = 0; i < n; i ++) {
+        struct perf_sample *sample = perf_buf + i;
+        struct perf_entry *seen[PERF_MAX_DEPTH + 1], *entry;
+        int nseen = 0;
+        if ((entry = perf_lookup(sample->eip, sample->pid, sample->user)) == NULL) {
+            nlost ++;
+            continue;
+        }
+        entry->self ++, entry->total ++;
+        seen[nseen ++] = entry;
+        for (j = 0; !sample->user && j < sample->depth; j ++) {
+            if ((entry = perf_lookup(sample->callchain[j] - 1, sample->pid, 0)) == NULL) {
+                break;
+            }
+            for (k = 0; k < nseen && seen[k] != entry; k ++)
+                /* do nothing */;
+            if (k == nseen) {
+                entry->total ++;
+                seen[nseen ++] = entry;
+            }
+        }
+    }
+
+    // sort by self samples, perf_nentry is small
+    for (j = 1; j < perf_nentry; j ++) {
+        struct perf_entry tmp = perf_entries[j];
+        for (k = j; k > 0 && perf_entries[k - 1].self < tmp.self; k --) {
+            perf_entries[k] = perf_entries[k - 1];
+        }
+        perf_entries[k] = tmp;
+    }
+
+    cprintf("perf: %u samples (%u taken, %u not reported)\n", n, perf_nsample, nlost);
+    if (n != 0) {
+        cprintf("  self%%  total%%  samples  function\n");
+        for (j = 0; j < perf_nentry && j < PERF_REPORT_TOP; j ++) {
+            struct perf_entry *entry = perf_entries + j;
+            cprintf("  %4u%%  %5u%%  %7u  %s\n", entry->self * 100 / n, entry->total * 100 / n,
+                    entry->self, entry->name);
+        }
+    }
+    perf_enabled = enabled;
+}
+
@@ -0,0 +1,27 @@
+#ifndef __KERN_DEBUG_PERF_H__
+#define __KERN_DEBUG_PERF_H__
+
+#include <defs.h>
+
+struct trapframe;
+
+#define PERF_NSAMPLE            2048        // size of the sample ring buffer
+#define PERF_MAX_DEPTH          4           // # of callers recorded with a sample
+
+/* a sample taken at a timer interrupt */
+struct perf_sample {
+    uintptr_t eip;                          // where the cpu was interrupted
+    int pid;                                // the current process
+    bool user;                              // BOOL: eip is in user mode
+    int depth;                              // # of callers in callchain
+    uintptr_t callchain[PERF_MAX_DEPTH];    // return addresses, innermost first
+};
+
+void perf_start(void);
+void perf_stop(void);
+bool perf_running(void);
+void perf_sample(struct trapframe *tf);
+void perf_report(void);
+
+#endif /* !__KERN_DEBUG_PERF_H__ */
+
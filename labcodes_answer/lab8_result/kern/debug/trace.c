@@ -0,0 +1,70 @@
+#include <defs.h>
+#include <x86.h>
+#include <atomic.h>
+#include <string.h>
+#include <clock.h>
+#include <proc.h>
+#include <trace.h>
+
+/*
+ * The trace ring. A writer takes a slot with one xadd on trace_head, fills
+ * in the event and then commits it by storing its index + 1 in
+ * trace_commit, so a tracepoint in an interrupt handler never waits for
+ * the code it interrupted. The oldest events are overwritten; the reader
+ * skips (and counts) what it has missed. ucore runs on one cpu, so there
+ * is a single ring.
+ */
+
+volatile uint32_t trace_mask = 0;
+
+static struct trace_event trace_ring[TRACE_NEVENT];
+static volatile uint32_t trace_commit[TRACE_NEVENT];
+static volatile unsigned int trace_head = 0;
+static unsigned int trace_tail = 0;
+
+void
+trace_record(int id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    unsigned int idx = fetch_and_add(&trace_head, 1);
+    unsigned int slot = idx % TRACE_NEVENT;
+    struct trace_event *ev = trace_ring + slot;
+    trace_commit[slot] = 0;
+    barrier();
+    ev->time = clock_nsec();
+    ev->cpu = 0;
+    ev->id = id;
+    ev->pid = (current != NULL) ? current->pid : -1;
+    ev->args[0] = a0, ev->args[1] = a1, ev->args[2] = a2, ev->args[3] = a3;
+    barrier();
+    trace_commit[slot] = idx + 1;
+}
+
+/*
+ * trace_read - copy at most n of the oldest unread events to events, stop at
+ *              an event still being written. *lost_store gets the # of
+ *              events overwritten before they were read.
+ */
+size_t
+trace_read(struct trace_event *events, size_t n, uint32_t *lost_store) {
+    unsigned int head = trace_head;
+    *lost_store = 0;
+    if (head - trace_tail > TRACE_NEVENT) {
+        *lost_store = head - trace_tail - TRACE_NEVENT;
+        trace_tail = head - TRACE_NEVENT;
+    }
+    size_t copied = 0;
+    while (copied < n && trace_tail != head) {
+        unsigned int slot = trace_tail % TRACE_NEVENT;
+        if (trace_commit[slot] != trace_tail + 1) {
+            break;
+        }
+        events[copied] = trace_ring[slot];
+        barrier();
+        if (trace_commit[slot] != trace_tail + 1) {
+            // overwritten while copied
+            break;
+        }
+        copied ++, trace_tail ++;
+    }
+    return copied;
+}
+
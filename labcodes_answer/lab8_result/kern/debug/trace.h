@@ -0,0 +1,37 @@
+#ifndef __KERN_DEBUG_TRACE_H__
+#define __KERN_DEBUG_TRACE_H__
+
+#include <defs.h>
+#include <traceevent.h>
+
+/*
+ * Static tracepoints. trace(id, ...) records a fixed-size binary event into
+ * the trace ring if the bit of id is set in trace_mask; a disabled
+ * tracepoint costs one test and a not-taken branch. Build with
+ * "DEFS+=-DNO_TRACE" to compile all tracepoints out.
+ *
+ * The ring is read (and trace_mask written) through the "trace:" device,
+ * see kern/fs/devs/dev_trace.c; tools/tracedump.c decodes the events.
+ */
+
+#define TRACE_NEVENT                1024    // # of events in the ring, a power of 2
+
+extern volatile uint32_t trace_mask;
+
+void trace_record(int id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+size_t trace_read(struct trace_event *events, size_t n, uint32_t *lost_store);
+
+#ifndef NO_TRACE
+#define trace(id, a0, a1, a2, a3)                                                       \
+    do {                                                                                \
+        if (__builtin_expect((trace_mask & (1 << (id))) != 0, 0)) {                     \
+            trace_record((id), (uint32_t)(a0), (uint32_t)(a1),                          \
+                         (uint32_t)(a2), (uint32_t)(a3));                               \
+        }                                                                               \
+    } while (0)
+#else
+#define trace(id, a0, a1, a2, a3)       do { } while (0)
+#endif
+
+#endif /* !__KERN_DEBUG_TRACE_H__ */
+
@@ -2,10 +2,32 @@
 #include <trap.h>
 #include <stdio.h>
 #include <picirq.h>
+#include <pmm.h>
+#include <vmm.h>
+#include <shmem.h>
+#include <timepage.h>
+#include <clock.h>
+#include <sync.h>
+#include <sched.h>
+#include <proc.h>
+#include <error.h>
+#include <assert.h>
 
 /* *
  * Support for time-related hardware gadgets - the 8253 timer,
- * which generates interruptes on IRQ-0.
+ * which generates interruptes on IRQ-0, and the TSC, which is
+ * calibrated against counter 2 of the 8253 and gives the time
+ * between ticks.
+ *
+ * The periodic tick is replaced by a one-shot of counter 0 when no tick is
+ * needed for a while: clock_idle does it while the cpu is idle, for the ticks
+ * until the first expiring timer, and clock_run_slice before going back to a
+ * user process, for the rest of its time_slice (or until the first timer if
+ * sooner). A one-shot is at most CLOCK_ONESHOT_MAX_TICKS, the 16 bits counter
+ * can not wait longer. It ends on a tick boundary, and the ticks in it are
+ * counted when it expires or when clock_sync stops it: at a context switch, a
+ * new timer, or a wakeup of the idle cpu by another interrupt. The time page
+ * then lags by at most a one-shot in ticks, the TSC clock keeps running.
  * */
 
 #define IO_TIMER1           0x040               // 8253 Timer #1
@@ -22,28 +44,361 @@
 #define TIMER_SEL0      0x00                    // select counter 0
 #define TIMER_RATEGEN   0x04                    // mode 2, rate generator
 #define TIMER_16BIT     0x30                    // r/w counter 16 bits, LSB first
+#define TIMER_SEL2      0x80                    // select counter 2
+#define TIMER_INTTC     0x00                    // mode 0, intr on terminal cnt
+#define TIMER_CNTR2     (IO_TIMER1 + 2)         // timer 2 counter port
+
+#define PORTB           0x61                    // keyboard controller port b
+#define PORTB_GATE2     0x01                    // gate of counter 2
+#define PORTB_SPKR      0x02                    // speaker data
+#define PORTB_OUT2      0x20                    // output of counter 2
+
+#define TIMER_READBACK  0xC0                    // read-back command
+#define TIMER_RB_COUNT0 0x02                    // read-back counter 0 (count and status)
+#define TIMER_STAT_OUT  0x80                    // read-back status: output is high
+
+#define TICK_HZ         100
+#define TICK_LATCH      TIMER_DIV(TICK_HZ)      // input clocks per tick
+#define CLOCK_ONESHOT_MAX_TICKS (0xFFFF / TICK_LATCH)
+#define CALIBRATE_MS    10                      // length of the TSC calibration
+#define TSC_SHIFT       24
 
 volatile size_t ticks;
 
+// the time page, shared with all user processes
+static struct shmem_struct *timepage_shmem;
+static volatile struct timepage *timepage;
+
+// counter 0 is in one-shot mode for oneshot_latch input clocks
+static bool oneshot = 0;
+static uint32_t oneshot_latch;
+// input clocks passed but not accounted as a whole tick yet
+static uint32_t residual_latch = 0;
+// the pending IRQ0 is not the end of a one-shot or of a whole tick, it only
+// counts stale_latch input clocks
+static bool stale_irq = 0;
+static uint32_t stale_latch;
+
 long SYSTEM_READ_TIMER( void ){
     return ticks;
 }
 
+/* *
+ * tsc_calibrate - count the TSC cycles while counter 2 of the 8253 counts
+ * down CALIBRATE_MS, return the TSC frequency in kHz, 0 if there is no TSC.
+ * */
+static uint32_t
+tsc_calibrate(void) {
+    uint32_t edx;
+    cpuid(1, NULL, NULL, NULL, &edx);
+    if (!(edx & CPUID_FEAT_TSC)) {
+        return 0;
+    }
+
+    // gate counter 2 on with the speaker off, and load it in one-shot mode
+    outb(PORTB, (inb(PORTB) & ~PORTB_SPKR) | PORTB_GATE2);
+    outb(TIMER_MODE, TIMER_SEL2 | TIMER_INTTC | TIMER_16BIT);
+    uint32_t latch = TIMER_FREQ / (1000 / CALIBRATE_MS);
+    outb(TIMER_CNTR2, latch % 256);
+    outb(TIMER_CNTR2, latch / 256);
+
+    uint64_t start = rdtsc();
+    uint32_t loops = 0;
+    while (!(inb(PORTB) & PORTB_OUT2)) {
+        if (++ loops == 0x1000000) {
+            break;
+        }
+    }
+    uint64_t cycles = rdtsc() - start;
+    // gate counter 2 off again
+    outb(PORTB, inb(PORTB) & ~PORTB_GATE2);
+    if (loops == 0x1000000) {
+        return 0;
+    }
+    do_div(cycles, CALIBRATE_MS);
+    return (uint32_t)cycles;
+}
+
+/* *
+ * timepage_init - alloc the time page and calibrate the TSC for it
+ * */
+static void
+timepage_init(void) {
+    struct Page *page;
+    if ((timepage_shmem = shmem_create(PGSIZE)) == NULL
+            || (page = shmem_get_page(timepage_shmem, 0)) == NULL) {
+        panic("alloc time page failed.\n");
+    }
+    shmem_ref_inc(timepage_shmem);
+    timepage = page2kva(page);
+
+    uint32_t khz = tsc_calibrate();
+    timepage->tsc_khz = khz;
+    if (khz != 0) {
+        // nsec per cycle is NSEC_PER_MSEC / khz, a slow TSC needs a smaller shift
+        // for the scale to fit in 32 bits
+        uint32_t shift = TSC_SHIFT + 1;
+        uint64_t mult;
+        do {
+            shift --;
+            mult = (uint64_t)NSEC_PER_MSEC << shift;
+            do_div(mult, khz);
+        } while ((mult >> 32) != 0 && shift != 0);
+        if ((mult >> 32) == 0 && mult != 0) {
+            timepage->tsc_mult = (uint32_t)mult, timepage->tsc_shift = shift;
+            timepage->base_tsc = rdtsc();
+        }
+        // otherwise tsc_mult stays 0, and the clock only moves at ticks
+    }
+}
+
+// clock_set_periodic - let counter 0 interrupt TICK_HZ times per second
+static void
+clock_set_periodic(void) {
+    outb(TIMER_MODE, TIMER_SEL0 | TIMER_RATEGEN | TIMER_16BIT);
+    outb(IO_TIMER1, TICK_LATCH % 256);
+    outb(IO_TIMER1, TICK_LATCH / 256);
+    oneshot = 0;
+}
+
+// clock_set_oneshot - let counter 0 interrupt once after latch input clocks
+static void
+clock_set_oneshot(uint32_t latch) {
+    assert(latch != 0 && latch <= 0xFFFF);
+    oneshot_latch = latch;
+    outb(TIMER_MODE, TIMER_SEL0 | TIMER_INTTC | TIMER_16BIT);
+    outb(IO_TIMER1, oneshot_latch % 256);
+    outb(IO_TIMER1, oneshot_latch / 256);
+    oneshot = 1;
+}
+
+/* *
+ * clock_advance - latch input clocks have passed since the last tick, count
+ * the whole ticks in them and move the base of the time page to now.
+ * Returns the # of ticks counted.
+ * */
+static uint32_t
+clock_advance(uint32_t latch) {
+    latch += residual_latch;
+    uint32_t nticks = latch / TICK_LATCH;
+    residual_latch = latch % TICK_LATCH;
+    ticks += nticks;
+
+    volatile struct timepage *tp = timepage;
+    tp->seq ++;
+    barrier();
+    if (tp->tsc_mult != 0) {
+        uint64_t tsc = rdtsc();
+        tp->base_nsec += mul_u64_u32_shr(tsc - tp->base_tsc, tp->tsc_mult, tp->tsc_shift);
+        tp->base_tsc = tsc;
+    }
+    else {
+        tp->base_nsec += (uint64_t)nticks * (NSEC_PER_SEC / TICK_HZ);
+    }
+    tp->ticks = ticks;
+    barrier();
+    tp->seq ++;
+    return nticks;
+}
+
 /* *
  * clock_init - initialize 8253 clock to interrupt 100 times per second,
  * and then enable IRQ_TIMER.
  * */
 void
 clock_init(void) {
+    timepage_init();
+
     // set 8253 timer-chip
-    outb(TIMER_MODE, TIMER_SEL0 | TIMER_RATEGEN | TIMER_16BIT);
-    outb(IO_TIMER1, TIMER_DIV(100) % 256);
-    outb(IO_TIMER1, TIMER_DIV(100) / 256);
+    clock_set_periodic();
 
     // initialize time counter 'ticks' to zero
     ticks = 0;
 
     cprintf("++ setup timer interrupts\n");
+    if (timepage->tsc_mult != 0) {
+        cprintf("++ tsc clock: %d kHz\n", timepage->tsc_khz);
+    }
     pic_enable(IRQ_TIMER);
 }
 
+// clock_read_count0 - the count of counter 0 now, and its status
+static uint32_t
+clock_read_count0(uint8_t *status_store) {
+    outb(TIMER_MODE, TIMER_READBACK | TIMER_RB_COUNT0);
+    uint8_t status = inb(IO_TIMER1);
+    uint32_t count = inb(IO_TIMER1);
+    count |= inb(IO_TIMER1) << 8;
+    if (status_store != NULL) {
+        *status_store = status;
+    }
+    return count;
+}
+
+/* *
+ * clock_oneshot_passed - input clocks passed since the one-shot was armed.
+ * After the one-shot ends, counter 0 goes on counting down from 0, so the
+ * time since its end is known too (for less than 0x10000 input clocks).
+ * */
+static uint32_t
+clock_oneshot_passed(bool *expired_store) {
+    uint8_t status;
+    uint32_t count = clock_read_count0(&status);
+    if ((*expired_store = ((status & TIMER_STAT_OUT) != 0))) {
+        return oneshot_latch + ((0x10000 - count) & 0xFFFF);
+    }
+    return oneshot_latch - count;
+}
+
+/* *
+ * clock_oneshot_start - replace the periodic tick by a one-shot that ends nticks
+ * after the last tick. The input clocks of the current tick already passed
+ * are moved to residual_latch, the one-shot is shorter by as many.
+ * */
+static void
+clock_oneshot_start(uint32_t nticks) {
+    assert(nticks > 1 && nticks <= CLOCK_ONESHOT_MAX_TICKS);
+    uint32_t passed = TICK_LATCH - clock_read_count0(NULL);
+    clock_set_oneshot(nticks * TICK_LATCH - passed);
+    residual_latch += passed;
+    if (pic_pending(IRQ_TIMER)) {
+        // the periodic tick expired after the read-back: its interrupt only counts
+        // the rest of that tick, and the one-shot still ends on a tick boundary
+        stale_irq = 1, stale_latch = TICK_LATCH - passed;
+    }
+}
+
+/* *
+ * clock_tick - called at each timer interrupt, count the tick (all ticks of a
+ * one-shot, and go back to periodic mode). Returns the # of ticks counted.
+ * */
+uint32_t
+clock_tick(void) {
+    if (stale_irq) {
+        stale_irq = 0;
+        return clock_advance(stale_latch);
+    }
+    if (oneshot) {
+        bool expired;
+        uint32_t passed = clock_oneshot_passed(&expired);
+        clock_set_periodic();
+        return clock_advance(passed);
+    }
+    return clock_advance(TICK_LATCH);
+}
+
+/* *
+ * clock_sync - stop a running one-shot: count the ticks passed in it so far,
+ * run the timers, and go back to periodic mode
+ * */
+void
+clock_sync(void) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    if (oneshot) {
+        bool expired;
+        uint32_t passed = clock_oneshot_passed(&expired);
+        clock_set_periodic();
+        if (expired || pic_pending(IRQ_TIMER)) {
+            // the one-shot ended (maybe after the read-back), count all of it here,
+            // not once more when its interrupt is taken
+            if (!stale_irq) {
+                stale_irq = 1, stale_latch = 0;
+            }
+            if (!expired) {
+                stale_latch += oneshot_latch - passed;
+            }
+        }
+        uint32_t nticks = clock_advance(passed);
+        if (nticks != 0) {
+            run_timer_list(nticks);
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+// clock_oneshot_ticks - the one-shot for nticks, cut at the first timer to expire
+static uint32_t
+clock_oneshot_ticks(uint32_t nticks) {
+    uint32_t expires = timer_next_expires();
+    if (expires != 0 && expires < nticks) {
+        nticks = expires;
+    }
+    return (nticks > CLOCK_ONESHOT_MAX_TICKS) ? CLOCK_ONESHOT_MAX_TICKS : nticks;
+}
+
+/* *
+ * clock_idle - called by the idle process, wait in hlt for an interrupt. The
+ * periodic tick is replaced by a one-shot for the first timer to expire.
+ * */
+void
+clock_idle(void) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    if (!current->need_resched) {
+        uint32_t nticks = clock_oneshot_ticks(CLOCK_ONESHOT_MAX_TICKS);
+        if (nticks > 1 && !oneshot && !pic_pending(IRQ_TIMER)) {
+            clock_oneshot_start(nticks);
+        }
+        // sti delays interrupts by one instruction, so none is taken before hlt
+        asm volatile ("sti; hlt; cli" ::: "memory");
+        // woken up by another interrupt, count the ticks so far
+        clock_sync();
+    }
+    local_intr_restore(intr_flag);
+}
+
+/* *
+ * clock_run_slice - called before going back to user mode: current needs no
+ * tick until its time_slice is used up, so run it on a one-shot until then
+ * (or until the first timer expires)
+ * */
+void
+clock_run_slice(void) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    if (!oneshot && current != idleproc && current->time_slice > 1) {
+        uint32_t nticks = clock_oneshot_ticks(current->time_slice);
+        if (nticks > 1 && !pic_pending(IRQ_TIMER)) {
+            clock_oneshot_start(nticks);
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+/* *
+ * clock_nsec - the monotonic time in nsec since boot, 0 before clock_init
+ * */
+uint64_t
+clock_nsec(void) {
+    if (timepage == NULL) {
+        return 0;
+    }
+    return timepage_nsec(timepage);
+}
+
+/* *
+ * clock_tsc_khz - the TSC frequency in kHz, 0 before clock_init or without a TSC
+ * */
+uint32_t
+clock_tsc_khz(void) {
+    if (timepage == NULL) {
+        return 0;
+    }
+    return timepage->tsc_khz;
+}
+
+/* *
+ * clock_map_timepage - map the time page read-only at UTIMEPAGE in mm, called by load_icode
+ * */
+int
+clock_map_timepage(struct mm_struct *mm) {
+    int ret;
+    struct vma_struct *vma;
+    if ((ret = mm_map(mm, UTIMEPAGE, PGSIZE, VM_READ, &vma)) != 0) {
+        return ret;
+    }
+    vma_set_shmem(vma, timepage_shmem, 0);
+    return page_insert(mm->pgdir, shmem_get_page(timepage_shmem, 0), UTIMEPAGE, PTE_U);
+}
+
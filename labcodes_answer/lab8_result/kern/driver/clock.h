@@ -5,7 +5,16 @@
 
 extern volatile size_t ticks;
 
+struct mm_struct;
+
 void clock_init(void);
+uint32_t clock_tick(void);
+void clock_idle(void);
+void clock_sync(void);
+void clock_run_slice(void);
+uint64_t clock_nsec(void);
+uint32_t clock_tsc_khz(void);
+int clock_map_timepage(struct mm_struct *mm);
 
 long SYSTEM_READ_TIMER( void );
 
@@ -27,6 +27,16 @@ pic_enable(unsigned int irq) {
     pic_setmask(irq_mask & ~(1 << irq));
 }
 
+/* pic_pending - irq is requested but not taken by the cpu yet (pic_init sets the
+ * controllers to read the IRR) */
+bool
+pic_pending(unsigned int irq) {
+    if (irq < 8) {
+        return (inb(IO_PIC1) >> irq) & 1;
+    }
+    return (inb(IO_PIC2) >> (irq - 8)) & 1;
+}
+
 /* pic_init - initialize the 8259A interrupt controllers */
 void
 pic_init(void) {
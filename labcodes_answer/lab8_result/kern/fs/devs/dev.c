@@ -154,6 +154,7 @@ dev_init(void) {
     init_device(stdin);
     init_device(stdout);
     init_device(disk0);
+    init_device(trace);
 }
 /* dev_create_inode - Create inode for a vfs-level device. */
 struct inode *
@@ -49,7 +49,7 @@ dev_stdin_read(char *buf, size_t len) {
             }
             else {
                 wait_t __wait, *wait = &__wait;
-                wait_current_set(wait_queue, wait, WT_KBD);
+                wait_current_set_exclusive(wait_queue, wait, WT_KBD);
                 local_intr_restore(intr_flag);
 
                 schedule();
@@ -62,6 +62,10 @@ dev_stdin_read(char *buf, size_t len) {
                 break;
             }
         }
+        // one reader is woken up per input, pass the rest of it on to the next
+        if (p_rpos < p_wpos && !wait_queue_empty(wait_queue)) {
+            wakeup_queue(wait_queue, WT_KBD, 1);
+        }
     }
     local_intr_restore(intr_flag);
     return ret;
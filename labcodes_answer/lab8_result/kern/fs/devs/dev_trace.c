@@ -0,0 +1,105 @@
+#include <defs.h>
+#include <stdio.h>
+#include <string.h>
+#include <sem.h>
+#include <dev.h>
+#include <vfs.h>
+#include <iobuf.h>
+#include <inode.h>
+#include <unistd.h>
+#include <trace.h>
+#include <error.h>
+#include <assert.h>
+
+/*
+ * The "trace:" device. A read returns whole struct trace_events from the
+ * trace ring, oldest first, without waiting; events missed by the reader
+ * show up as one TRACE_LOST event. A write of a uint32_t sets trace_mask,
+ * (1 << id) enables the tracepoints of event id.
+ */
+
+#define TRACE_READ_BATCH            16
+
+static semaphore_t trace_sem;
+static uint32_t trace_nlost = 0;        /* lost events not reported yet, under trace_sem */
+
+static int
+trace_open(struct device *dev, uint32_t open_flags) {
+    return 0;
+}
+
+static int
+trace_close(struct device *dev) {
+    return 0;
+}
+
+static int
+trace_io(struct device *dev, struct iobuf *iob, bool write) {
+    if (write) {
+        uint32_t mask;
+        if (iob->io_resid != sizeof(uint32_t)) {
+            return -E_INVAL;
+        }
+        iobuf_move(iob, &mask, sizeof(uint32_t), 0, NULL);
+        trace_mask = mask;
+        return 0;
+    }
+
+    struct trace_event events[TRACE_READ_BATCH];
+    down(&trace_sem);
+    while (iob->io_resid >= sizeof(struct trace_event)) {
+        size_t i = 1, n = iob->io_resid / sizeof(struct trace_event);
+        uint32_t lost;
+        // count the lost events first, the TRACE_LOST event takes a slot of iob
+        trace_read(events + 1, 0, &lost);
+        trace_nlost += lost;
+        if (trace_nlost != 0) {
+            memset(events, 0, sizeof(struct trace_event));
+            events[0].id = TRACE_LOST, events[0].pid = -1, events[0].args[0] = trace_nlost;
+            trace_nlost = 0, i = 0, n --;
+        }
+        if (n > TRACE_READ_BATCH - 1) {
+            n = TRACE_READ_BATCH - 1;
+        }
+        // events overwritten since are reported by the next TRACE_LOST event
+        n = trace_read(events + 1, n, &lost);
+        trace_nlost += lost;
+        if (n + 1 - i == 0) {
+            break;
+        }
+        iobuf_move(iob, events + i, (n + 1 - i) * sizeof(struct trace_event), 1, NULL);
+    }
+    up(&trace_sem);
+    return 0;
+}
+
+static int
+trace_ioctl(struct device *dev, int op, void *data) {
+    return -E_INVAL;
+}
+
+static void
+trace_device_init(struct device *dev) {
+    dev->d_blocks = 0;
+    dev->d_blocksize = 1;
+    dev->d_open = trace_open;
+    dev->d_close = trace_close;
+    dev->d_io = trace_io;
+    dev->d_ioctl = trace_ioctl;
+    sem_init(&trace_sem, 1);
+}
+
+void
+dev_init_trace(void) {
+    struct inode *node;
+    if ((node = dev_create_inode()) == NULL) {
+        panic("trace: dev_create_node.\n");
+    }
+    trace_device_init(vop_info(node, device));
+
+    int ret;
+    if ((ret = vfs_add_dev("trace", node, 0)) != 0) {
+        panic("trace: vfs_add_dev: %e.\n", ret);
+    }
+}
+
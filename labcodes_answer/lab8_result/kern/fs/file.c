@@ -6,6 +6,7 @@
 #include <unistd.h>
 #include <iobuf.h>
 #include <inode.h>
+#include <pipe.h>
 #include <stat.h>
 #include <dirent.h>
 #include <error.h>
@@ -353,4 +354,109 @@ file_dup(int fd1, int fd2) {
     return file2->fd;
 }
 
+// create a pipe, fd[0] is the read end and fd[1] the write end
+int
+file_pipe(int fd[]) {
+    int ret;
+    struct file *file[2] = {NULL, NULL};
+    if ((ret = fd_array_alloc(NO_FD, &file[0])) != 0) {
+        goto failed_cleanup;
+    }
+    if ((ret = fd_array_alloc(NO_FD, &file[1])) != 0) {
+        goto failed_cleanup;
+    }
+    if ((ret = pipe_open(&(file[0]->node), &(file[1]->node))) != 0) {
+        goto failed_cleanup;
+    }
+    file[0]->pos = 0;
+    file[0]->readable = 1, file[0]->writable = 0;
+    fd_array_open(file[0]);
+
+    file[1]->pos = 0;
+    file[1]->readable = 0, file[1]->writable = 1;
+    fd_array_open(file[1]);
+
+    fd[0] = file[0]->fd, fd[1] = file[1]->fd;
+    return 0;
+
+failed_cleanup:
+    if (file[0] != NULL) {
+        fd_array_free(file[0]);
+    }
+    if (file[1] != NULL) {
+        fd_array_free(file[1]);
+    }
+    return ret;
+}
+
+// open the read (O_RDONLY) or write (O_WRONLY) end of the named pipe name
+int
+file_mkfifo(const char *name, uint32_t open_flags) {
+    int ret;
+    struct file *file;
+    if ((ret = fd_array_alloc(NO_FD, &file)) != 0) {
+        return ret;
+    }
+    struct inode *node;
+    if ((ret = pipe_open_fifo(name, open_flags, &node)) != 0) {
+        fd_array_free(file);
+        return ret;
+    }
+    file->pos = 0;
+    file->node = node;
+    file->readable = ((open_flags & O_ACCMODE) == O_RDONLY);
+    file->writable = !file->readable;
+    fd_array_open(file);
+    return file->fd;
+}
+
+// is fd an end of a pipe?
+bool
+file_ispipe(int fd) {
+    struct file *file;
+    if (fd2file(fd, &file) != 0) {
+        return 0;
+    }
+    return check_inode_type(file->node, pipe_inode);
+}
+
+// get the inode of a readable regular file to map, with its ref count increased
+int
+file_mmap_node(int fd, struct inode **node_store) {
+    int ret;
+    struct file *file;
+    if ((ret = fd2file(fd, &file)) != 0) {
+        return ret;
+    }
+    if (!file->readable) {
+        return -E_INVAL;
+    }
+    uint32_t type;
+    if ((ret = vop_gettype(file->node, &type)) != 0) {
+        return ret;
+    }
+    if (!S_ISREG(type)) {
+        return -E_INVAL;
+    }
+    vop_ref_inc(file->node);
+    *node_store = file->node;
+    return 0;
+}
 
+// read/write a pipe straight from/to user memory
+int
+file_pipe_io(int fd, void *base, size_t len, bool write, size_t *copied_store) {
+    int ret;
+    struct file *file;
+    *copied_store = 0;
+    if ((ret = fd2file(fd, &file)) != 0) {
+        return ret;
+    }
+    if (write ? !file->writable : !file->readable) {
+        return -E_INVAL;
+    }
+    fd_array_acquire(file);
+    ret = pipe_io_user(file->node, base, len, write, copied_store);
+    fd_array_release(file);
+    return ret;
+}
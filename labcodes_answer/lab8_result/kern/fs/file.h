@@ -40,6 +40,9 @@ int file_getdirentry(int fd, struct dirent *dirent);
 int file_dup(int fd1, int fd2);
 int file_pipe(int fd[]);
 int file_mkfifo(const char *name, uint32_t open_flags);
+bool file_ispipe(int fd);
+int file_pipe_io(int fd, void *base, size_t len, bool write, size_t *copied_store);
+int file_mmap_node(int fd, struct inode **node_store);
 
 static inline int
 fopen_count(struct file *file) {
@@ -5,18 +5,32 @@
 #include <dev.h>
 #include <file.h>
 #include <sfs.h>
+#include <pipe.h>
 #include <inode.h>
 #include <assert.h>
-//called when init_main proc start
+//called in kern_init, the disks are mounted later by init_main
 void
 fs_init(void) {
     vfs_init();
     dev_init();
+    pipe_init();
+}
+
+//called when init_main proc start, mount the fs on the disks
+void
+fs_mount_init(void) {
     sfs_init();
 }
 
+//called by init_main once the system is up, start the fs kernel daemons
+void
+fs_daemon_init(void) {
+    sfs_daemon_init();
+}
+
 void
 fs_cleanup(void) {
+    sfs_daemon_cleanup();
     vfs_cleanup();
 }
 
@@ -14,6 +14,8 @@
 #define DISK1_DEV_NO        3
 
 void fs_init(void);
+void fs_mount_init(void);
+void fs_daemon_init(void);
 void fs_cleanup(void);
 
 struct inode;
@@ -1,5 +1,6 @@
 #include <defs.h>
 #include <string.h>
+#include <uio.h>
 #include <iobuf.h>
 #include <error.h>
 #include <assert.h>
@@ -14,7 +15,40 @@ struct iobuf *
 iobuf_init(struct iobuf *iob, void *base, size_t len, off_t offset) {
     iob->io_base = base;
     iob->io_offset = offset;
+    iob->io_len = iob->io_resid = iob->io_segresid = len;
+    iob->io_iov = NULL, iob->io_iovcnt = 0;
+    return iob;
+}
+
+/*
+ * iobuf_next_seg - go on to the next non-empty segment once the current one is used up
+ */
+static void
+iobuf_next_seg(struct iobuf *iob) {
+    while (iob->io_segresid == 0 && iob->io_iovcnt > 0) {
+        iob->io_base = iob->io_iov->iov_base;
+        iob->io_segresid = iob->io_iov->iov_len;
+        iob->io_iov ++, iob->io_iovcnt --;
+    }
+}
+
+/*
+ * iobuf_init_iov - init io buffer struct for the iovcnt segments in iov (used by readv/writev).
+ *                  iov must stay valid while the iobuf is in use.
+ */
+struct iobuf *
+iobuf_init_iov(struct iobuf *iob, struct iovec *iov, int iovcnt, off_t offset) {
+    size_t len = 0;
+    int i;
+    for (i = 0; i < iovcnt; i ++) {
+        len += iov[i].iov_len;
+    }
+    iob->io_base = NULL;
+    iob->io_offset = offset;
     iob->io_len = iob->io_resid = len;
+    iob->io_segresid = 0;
+    iob->io_iov = iov, iob->io_iovcnt = iovcnt;
+    iobuf_next_seg(iob);
     return iob;
 }
 
@@ -31,15 +65,21 @@ iobuf_move(struct iobuf *iob, void *data, size_t len, bool m2b, size_t *copiedp)
     if ((alen = iob->io_resid) > len) {
         alen = len;
     }
-    if (alen > 0) {
-        void *src = iob->io_base, *dst = data;
+    size_t copied = 0;
+    while (copied < alen) {
+        size_t n;
+        if ((n = iob->io_segresid) > alen - copied) {
+            n = alen - copied;
+        }
+        void *src = iob->io_base, *dst = data + copied;
         if (m2b) {
             void *tmp = src;
             src = dst, dst = tmp;
         }
-        memmove(dst, src, alen);
-        iobuf_skip(iob, alen), len -= alen;
+        memmove(dst, src, n);
+        iobuf_skip(iob, n), copied += n;
     }
+    len -= alen;
     if (copiedp != NULL) {
         *copiedp = alen;
     }
@@ -56,10 +96,16 @@ iobuf_move_zeros(struct iobuf *iob, size_t len, size_t *copiedp) {
     if ((alen = iob->io_resid) > len) {
         alen = len;
     }
-    if (alen > 0) {
-        memset(iob->io_base, 0, alen);
-        iobuf_skip(iob, alen), len -= alen;
+    size_t copied = 0;
+    while (copied < alen) {
+        size_t n;
+        if ((n = iob->io_segresid) > alen - copied) {
+            n = alen - copied;
+        }
+        memset(iob->io_base, 0, n);
+        iobuf_skip(iob, n), copied += n;
     }
+    len -= alen;
     if (copiedp != NULL) {
         *copiedp = alen;
     }
@@ -72,6 +118,14 @@ iobuf_move_zeros(struct iobuf *iob, size_t len, size_t *copiedp) {
 void
 iobuf_skip(struct iobuf *iob, size_t n) {
     assert(iob->io_resid >= n);
-    iob->io_base += n, iob->io_offset += n, iob->io_resid -= n;
+    iob->io_offset += n, iob->io_resid -= n;
+    while (n > 0) {
+        size_t alen;
+        if ((alen = iob->io_segresid) > n) {
+            alen = n;
+        }
+        iob->io_base += alen, iob->io_segresid -= alen, n -= alen;
+        iobuf_next_seg(iob);
+    }
 }
 
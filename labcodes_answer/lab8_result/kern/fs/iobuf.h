@@ -3,19 +3,31 @@
 
 #include <defs.h>
 
+struct iovec;
+
 /*
  * iobuf is a buffer Rd/Wr status record
+ *
+ * An iobuf made by iobuf_init_iov spans several segments: io_base is the current
+ * position in the current segment, which has io_segresid bytes left, and io_iov
+ * points to the io_iovcnt segments after it. Such an iobuf may only be accessed
+ * through iobuf_move/iobuf_move_zeros/iobuf_skip; the vop_read/vop_write of the
+ * file systems and devices always get one segment.
  */
 struct iobuf {
     void *io_base;     // the base addr of buffer (used for Rd/Wr)
     off_t io_offset;   // current Rd/Wr position in buffer, will have been incremented by the amount transferred
     size_t io_len;     // the length of buffer  (used for Rd/Wr)
     size_t io_resid;   // current resident length need to Rd/Wr, will have been decremented by the amount transferred.
+    size_t io_segresid;         // resident length of the current segment
+    struct iovec *io_iov;       // the segments after the current one
+    int io_iovcnt;              // # of segments after the current one
 };
 
 #define iobuf_used(iob)                         ((size_t)((iob)->io_len - (iob)->io_resid))
 
 struct iobuf *iobuf_init(struct iobuf *iob, void *base, size_t len, off_t offset);
+struct iobuf *iobuf_init_iov(struct iobuf *iob, struct iovec *iov, int iovcnt, off_t offset);
 int iobuf_move(struct iobuf *iob, void *data, size_t len, bool m2b, size_t *copiedp);
 int iobuf_move_zeros(struct iobuf *iob, size_t len, size_t *copiedp);
 void iobuf_skip(struct iobuf *iob, size_t n);
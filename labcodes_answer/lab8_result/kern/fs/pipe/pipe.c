@@ -0,0 +1,265 @@
+#include <defs.h>
+#include <string.h>
+#include <stat.h>
+#include <list.h>
+#include <sem.h>
+#include <vfs.h>
+#include <inode.h>
+#include <iobuf.h>
+#include <unistd.h>
+#include <pipe.h>
+#include <error.h>
+#include <assert.h>
+
+/*
+ * Pipes.
+ *
+ * A pipe is a pipe_state (see pipe_state.c) and an inode for each end. An anonymous
+ * pipe is made by pipe_open; a named pipe (fifo) lives in fifo_list while any of its
+ * ends is in use, and each pipe_open_fifo with the same name opens one more end of it.
+ */
+
+static list_entry_t fifo_list;
+static semaphore_t fifo_sem;            /* for fifo_list and pipe_state->ref_count */
+
+static const struct inode_ops pipe_node_ops;
+
+/*
+ * pipe_close - the last close of a pipe end
+ */
+static int
+pipe_close(struct inode *node) {
+    struct pipe_inode *pin = vop_info(node, pipe_inode);
+    pipe_state_close(pin->state, pin->write_end);
+    return 0;
+}
+
+/*
+ * pipe_read - read from the read end of a pipe, the offset in iob is ignored
+ */
+static int
+pipe_read(struct inode *node, struct iobuf *iob) {
+    struct pipe_inode *pin = vop_info(node, pipe_inode);
+    if (pin->write_end) {
+        return -E_INVAL;
+    }
+    int ret;
+    size_t alen;
+    ret = pipe_state_read(pin->state, iob->io_base, iob->io_resid, 0, &alen);
+    if (alen != 0) {
+        iobuf_skip(iob, alen);
+    }
+    return ret;
+}
+
+/*
+ * pipe_write - write to the write end of a pipe, the offset in iob is ignored
+ */
+static int
+pipe_write(struct inode *node, struct iobuf *iob) {
+    struct pipe_inode *pin = vop_info(node, pipe_inode);
+    if (!pin->write_end) {
+        return -E_INVAL;
+    }
+    int ret;
+    size_t alen;
+    ret = pipe_state_write(pin->state, iob->io_base, iob->io_resid, 0, &alen);
+    if (alen != 0) {
+        iobuf_skip(iob, alen);
+    }
+    return ret;
+}
+
+/*
+ * pipe_fstat - a pipe has one link, no blocks, and the size of the data buffered
+ */
+static int
+pipe_fstat(struct inode *node, struct stat *stat) {
+    int ret;
+    memset(stat, 0, sizeof(struct stat));
+    if ((ret = vop_gettype(node, &(stat->st_mode))) != 0) {
+        return ret;
+    }
+    struct pipe_state *state = vop_info(node, pipe_inode)->state;
+    stat->st_nlinks = 1;
+    stat->st_size = state->p_wpos - state->p_rpos;
+    return 0;
+}
+
+/*
+ * pipe_gettype - a pipe is a fifo
+ */
+static int
+pipe_gettype(struct inode *node, uint32_t *type_store) {
+    *type_store = S_IFIFO;
+    return 0;
+}
+
+/*
+ * pipe_tryseek - seeking is illegal on a pipe
+ */
+static int
+pipe_tryseek(struct inode *node, off_t pos) {
+    return -E_SEEK;
+}
+
+/*
+ * pipe_reclaim - free the pipe end, and the pipe_state after its last end
+ */
+static int
+pipe_reclaim(struct inode *node) {
+    struct pipe_state *state = vop_info(node, pipe_inode)->state;
+    bool destroy;
+    down(&fifo_sem);
+    {
+        assert(state->ref_count > 0);
+        if ((destroy = (-- state->ref_count == 0))) {
+            list_del_init(&(state->fifo_link));
+        }
+    }
+    up(&fifo_sem);
+    if (destroy) {
+        pipe_state_destroy(state);
+    }
+    vop_kill(node);
+    return 0;
+}
+
+/*
+ * pipe_create_inode - create an inode for the read (or write) end of state, opened once
+ */
+static int
+pipe_create_inode(struct pipe_state *state, bool write_end, struct inode **node_store) {
+    struct inode *node;
+    if ((node = alloc_inode(pipe_inode)) == NULL) {
+        return -E_NO_MEM;
+    }
+    vop_init(node, &pipe_node_ops, NULL);
+    struct pipe_inode *pin = vop_info(node, pipe_inode);
+    pin->state = state, pin->write_end = write_end;
+    state->ref_count ++;
+    pipe_state_open(state, write_end);
+    vop_open_inc(node);
+    *node_store = node;
+    return 0;
+}
+
+/*
+ * pipe_open - create an anonymous pipe, return the inodes of its read and write ends
+ */
+int
+pipe_open(struct inode **rnode_store, struct inode **wnode_store) {
+    int ret = -E_NO_MEM;
+    struct pipe_state *state;
+    struct inode *rnode, *wnode;
+    if ((state = pipe_state_create()) == NULL) {
+        return ret;
+    }
+    down(&fifo_sem);
+    if ((ret = pipe_create_inode(state, 0, &rnode)) != 0) {
+        goto failed_cleanup_state;
+    }
+    if ((ret = pipe_create_inode(state, 1, &wnode)) != 0) {
+        goto failed_cleanup_rnode;
+    }
+    up(&fifo_sem);
+    *rnode_store = rnode, *wnode_store = wnode;
+    return 0;
+
+failed_cleanup_rnode:
+    up(&fifo_sem);
+    vfs_close(rnode);
+    return ret;
+failed_cleanup_state:
+    up(&fifo_sem);
+    pipe_state_destroy(state);
+    return ret;
+}
+
+/*
+ * pipe_open_fifo - open the read (O_RDONLY) or write (O_WRONLY) end of the named pipe
+ *                  name, create the pipe if it does not exist yet
+ */
+int
+pipe_open_fifo(const char *name, uint32_t open_flags, struct inode **node_store) {
+    bool write_end;
+    switch (open_flags & O_ACCMODE) {
+    case O_RDONLY: write_end = 0; break;
+    case O_WRONLY: write_end = 1; break;
+    default:
+        return -E_INVAL;
+    }
+    if (*name == '\0' || strlen(name) > PIPE_MAX_NAME_LEN) {
+        return -E_INVAL;
+    }
+
+    int ret;
+    struct pipe_state *state = NULL;
+    down(&fifo_sem);
+    list_entry_t *list = &fifo_list, *le = list;
+    while ((le = list_next(le)) != list) {
+        if (strcmp(le2pipe(le, fifo_link)->name, name) == 0) {
+            state = le2pipe(le, fifo_link);
+            break;
+        }
+    }
+    if (state == NULL) {
+        if ((state = pipe_state_create()) == NULL) {
+            ret = -E_NO_MEM;
+            goto out_unlock;
+        }
+        strcpy(state->name, name);
+        list_add(&fifo_list, &(state->fifo_link));
+    }
+    if ((ret = pipe_create_inode(state, write_end, node_store)) != 0) {
+        if (state->ref_count == 0) {
+            list_del(&(state->fifo_link));
+            pipe_state_destroy(state);
+        }
+    }
+
+out_unlock:
+    up(&fifo_sem);
+    return ret;
+}
+
+/*
+ * pipe_io_user - read (or write) the pipe end node straight from (to) user memory,
+ *                without the bounce buffer of sysfile_read/sysfile_write
+ */
+int
+pipe_io_user(struct inode *node, void *base, size_t len, bool write, size_t *copied_store) {
+    struct pipe_inode *pin = vop_info(node, pipe_inode);
+    if (pin->write_end != write) {
+        *copied_store = 0;
+        return -E_INVAL;
+    }
+    if (write) {
+        return pipe_state_write(pin->state, base, len, 1, copied_store);
+    }
+    return pipe_state_read(pin->state, base, len, 1, copied_store);
+}
+
+/*
+ * pipe_init - called in fs_init
+ */
+void
+pipe_init(void) {
+    list_init(&fifo_list);
+    sem_init(&fifo_sem, 1);
+}
+
+/*
+ * Function table for pipe inodes.
+ */
+static const struct inode_ops pipe_node_ops = {
+    .vop_magic                      = VOP_MAGIC,
+    .vop_close                      = pipe_close,
+    .vop_read                       = pipe_read,
+    .vop_write                      = pipe_write,
+    .vop_fstat                      = pipe_fstat,
+    .vop_gettype                    = pipe_gettype,
+    .vop_tryseek                    = pipe_tryseek,
+    .vop_reclaim                    = pipe_reclaim,
+};
+
@@ -0,0 +1,58 @@
+#ifndef __KERN_FS_PIPE_PIPE_H__
+#define __KERN_FS_PIPE_PIPE_H__
+
+#include <defs.h>
+#include <list.h>
+#include <wait.h>
+#include <sem.h>
+
+struct inode;
+struct iobuf;
+
+#define PIPE_BUFSIZE                    4096                /* size of the ring buffer, one page */
+#define PIPE_MAX_NAME_LEN               32                  /* max length of the name of a fifo */
+
+/*
+ * pipe_state - the ring buffer shared by the two ends of a pipe.
+ *
+ * p_rpos and p_wpos run freely and are taken modulo PIPE_BUFSIZE: only the reader
+ * moves p_rpos and only the writer moves p_wpos, so the data is copied without any
+ * lock between them. r_sem (w_sem) lets one reader (writer) in at a time, and the
+ * wait queues are only touched with interrupts disabled.
+ */
+struct pipe_state {
+    volatile uint32_t p_rpos;                   /* read position */
+    volatile uint32_t p_wpos;                   /* write position */
+    char *buf;                                  /* PIPE_BUFSIZE bytes of data */
+    int nreaders, nwriters;                     /* # of opened read/write ends */
+    bool rclosed, wclosed;                      /* all read/write ends are closed */
+    semaphore_t r_sem, w_sem;                   /* one reader/writer at a time */
+    wait_queue_t r_queue, w_queue;              /* readers wait for data, writers for space */
+    int ref_count;                              /* # of pipe inodes using it */
+    list_entry_t fifo_link;                     /* entry in the fifo list, for a named pipe */
+    char name[PIPE_MAX_NAME_LEN + 1];           /* name of a named pipe, "" if anonymous */
+};
+
+#define le2pipe(le, member)                     \
+    to_struct((le), struct pipe_state, member)
+
+/* inode for one end of a pipe */
+struct pipe_inode {
+    struct pipe_state *state;
+    bool write_end;                             /* BOOL: write end or read end */
+};
+
+struct pipe_state *pipe_state_create(void);
+void pipe_state_destroy(struct pipe_state *state);
+int pipe_state_read(struct pipe_state *state, void *buf, size_t len, bool user, size_t *copied_store);
+int pipe_state_write(struct pipe_state *state, void *buf, size_t len, bool user, size_t *copied_store);
+void pipe_state_open(struct pipe_state *state, bool write_end);
+void pipe_state_close(struct pipe_state *state, bool write_end);
+
+void pipe_init(void);
+int pipe_open(struct inode **rnode_store, struct inode **wnode_store);
+int pipe_open_fifo(const char *name, uint32_t open_flags, struct inode **node_store);
+int pipe_io_user(struct inode *node, void *base, size_t len, bool write, size_t *copied_store);
+
+#endif /* !__KERN_FS_PIPE_PIPE_H__ */
+
@@ -0,0 +1,261 @@
+#include <defs.h>
+#include <string.h>
+#include <kmalloc.h>
+#include <pmm.h>
+#include <vmm.h>
+#include <sync.h>
+#include <proc.h>
+#include <sched.h>
+#include <pipe.h>
+#include <error.h>
+#include <assert.h>
+
+/*
+ * pipe_state_create - alloc a pipe_state with an empty ring buffer of one page
+ */
+struct pipe_state *
+pipe_state_create(void) {
+    struct pipe_state *state;
+    struct Page *page;
+    if ((state = kmalloc(sizeof(struct pipe_state))) == NULL) {
+        return NULL;
+    }
+    if ((page = alloc_page()) == NULL) {
+        kfree(state);
+        return NULL;
+    }
+    static_assert(PIPE_BUFSIZE == PGSIZE);
+    state->buf = page2kva(page);
+    state->p_rpos = state->p_wpos = 0;
+    state->nreaders = state->nwriters = 0;
+    state->rclosed = state->wclosed = 0;
+    sem_init(&(state->r_sem), 1);
+    sem_init(&(state->w_sem), 1);
+    wait_queue_init(&(state->r_queue));
+    wait_queue_init(&(state->w_queue));
+    state->ref_count = 0;
+    list_init(&(state->fifo_link));
+    state->name[0] = '\0';
+    return state;
+}
+
+/*
+ * pipe_state_destroy - free the ring buffer and the pipe_state, nobody may wait on it
+ */
+void
+pipe_state_destroy(struct pipe_state *state) {
+    assert(state->ref_count == 0);
+    assert(wait_queue_empty(&(state->r_queue)) && wait_queue_empty(&(state->w_queue)));
+    free_page(kva2page(state->buf));
+    kfree(state);
+}
+
+/*
+ * pipe_wakeup - wake all processes waiting in queue, called once per batch of data
+ *               (or space) instead of once per byte
+ */
+static void
+pipe_wakeup(wait_queue_t *queue) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if (!wait_queue_empty(queue)) {
+            wakeup_queue(queue, WT_PIPE, 1);
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+/*
+ * pipe_wait - sleep on the read (or write) queue of state until there is data (space)
+ *             or the other side is closed. The condition is checked with interrupts
+ *             disabled, so the wakeup from the other side can not get lost.
+ */
+static int
+pipe_wait(struct pipe_state *state, bool write_end) {
+    int ret = 0;
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        bool empty = (state->p_wpos == state->p_rpos);
+        bool full = (state->p_wpos - state->p_rpos == PIPE_BUFSIZE);
+        if (write_end ? (full && !state->rclosed) : (empty && !state->wclosed)) {
+            wait_queue_t *queue = write_end ? &(state->w_queue) : &(state->r_queue);
+            wait_t __wait, *wait = &__wait;
+            wait_current_set(queue, wait, WT_PIPE);
+            local_intr_restore(intr_flag);
+
+            schedule();
+
+            local_intr_save(intr_flag);
+            wait_current_del(queue, wait);
+            if (wait->wakeup_flags != WT_PIPE) {
+                ret = -E_KILLED;
+            }
+        }
+    }
+    local_intr_restore(intr_flag);
+    return ret;
+}
+
+/*
+ * pipe_copy - copy len bytes between the ring buffer and buf, which is in the
+ *             user space of current if user is set
+ */
+static bool
+pipe_copy(void *dst, void *src, size_t len, bool to_user, bool from_user) {
+    struct mm_struct *mm = current->mm;
+    bool ret = 1;
+    if (to_user || from_user) {
+        lock_mm_shared(mm);
+        {
+            ret = to_user ? copy_to_user(mm, dst, src, len) : copy_from_user(mm, dst, src, len, 0);
+        }
+        unlock_mm_shared(mm);
+    }
+    else {
+        memcpy(dst, src, len);
+    }
+    return ret;
+}
+
+/*
+ * pipe_state_read - read at most len bytes from the pipe into buf
+ * @user:         BOOL, buf is in user space (copied without a kernel bounce buffer)
+ * @copied_store: the length really read
+ *
+ * Waits until there is some data, returns 0 with nothing read at end of file
+ * (all write ends are closed and the buffer is empty).
+ */
+int
+pipe_state_read(struct pipe_state *state, void *buf, size_t len, bool user, size_t *copied_store) {
+    int ret = 0;
+    size_t copied = 0;
+    down(&(state->r_sem));
+    while (copied < len) {
+        uint32_t rpos = state->p_rpos, avail = state->p_wpos - rpos;
+        if (avail == 0) {
+            if (copied != 0 || state->wclosed) {
+                break;
+            }
+            if ((ret = pipe_wait(state, 0)) != 0) {
+                break;
+            }
+            continue;
+        }
+        size_t n = PIPE_BUFSIZE - rpos % PIPE_BUFSIZE;
+        if (n > avail) {
+            n = avail;
+        }
+        if (n > len - copied) {
+            n = len - copied;
+        }
+        if (!pipe_copy(buf + copied, state->buf + rpos % PIPE_BUFSIZE, n, user, 0)) {
+            ret = -E_INVAL;
+            break;
+        }
+        state->p_rpos = rpos + n, copied += n;
+    }
+    up(&(state->r_sem));
+    if (copied != 0) {
+        pipe_wakeup(&(state->w_queue));
+    }
+    *copied_store = copied;
+    return ret;
+}
+
+/*
+ * pipe_state_write - write len bytes from buf into the pipe
+ * @user:         BOOL, buf is in user space (copied without a kernel bounce buffer)
+ * @copied_store: the length really written
+ *
+ * Waits for space until all of buf is written, fails with -E_PIPE once all read
+ * ends are closed.
+ */
+int
+pipe_state_write(struct pipe_state *state, void *buf, size_t len, bool user, size_t *copied_store) {
+    int ret = 0;
+    size_t copied = 0, batch = 0;
+    down(&(state->w_sem));
+    while (copied < len) {
+        if (state->rclosed) {
+            ret = -E_PIPE;
+            break;
+        }
+        uint32_t wpos = state->p_wpos, space = PIPE_BUFSIZE - (wpos - state->p_rpos);
+        if (space == 0) {
+            if (batch != 0) {
+                pipe_wakeup(&(state->r_queue));
+                batch = 0;
+            }
+            if ((ret = pipe_wait(state, 1)) != 0) {
+                break;
+            }
+            continue;
+        }
+        size_t n = PIPE_BUFSIZE - wpos % PIPE_BUFSIZE;
+        if (n > space) {
+            n = space;
+        }
+        if (n > len - copied) {
+            n = len - copied;
+        }
+        if (!pipe_copy(state->buf + wpos % PIPE_BUFSIZE, buf + copied, n, 0, user)) {
+            ret = -E_INVAL;
+            break;
+        }
+        state->p_wpos = wpos + n, copied += n, batch += n;
+    }
+    up(&(state->w_sem));
+    if (batch != 0) {
+        pipe_wakeup(&(state->r_queue));
+    }
+    *copied_store = copied;
+    return ret;
+}
+
+/*
+ * pipe_state_open - a read (or write) end of the pipe is opened
+ */
+void
+pipe_state_open(struct pipe_state *state, bool write_end) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if (write_end) {
+            state->nwriters ++, state->wclosed = 0;
+        }
+        else {
+            state->nreaders ++, state->rclosed = 0;
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+/*
+ * pipe_state_close - a read (or write) end of the pipe is closed. After the last
+ *                    one, wake up the other side to see end of file (broken pipe).
+ */
+void
+pipe_state_close(struct pipe_state *state, bool write_end) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if (write_end) {
+            assert(state->nwriters > 0);
+            if (-- state->nwriters == 0) {
+                state->wclosed = 1;
+                wakeup_queue(&(state->r_queue), WT_PIPE, 1);
+            }
+        }
+        else {
+            assert(state->nreaders > 0);
+            if (-- state->nreaders == 0) {
+                state->rclosed = 1;
+                wakeup_queue(&(state->w_queue), WT_PIPE, 1);
+            }
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
@@ -7,7 +7,7 @@
  * sfs_init - mount sfs on disk0
  *
  * CALL GRAPH:
- *   kern_init-->fs_init-->sfs_init
+ *   init_main-->fs_mount_init-->sfs_init
  */
 void
 sfs_init(void) {
@@ -17,3 +17,23 @@ sfs_init(void) {
     }
 }
 
+/*
+ * sfs_daemon_init - start the sfs kernel daemons
+ *
+ * CALL GRAPH:
+ *   init_main-->fs_daemon_init-->sfs_daemon_init
+ */
+void
+sfs_daemon_init(void) {
+    sfs_readahead_init();
+    sfs_writeback_init();
+}
+
+/*
+ * sfs_daemon_cleanup - stop the sfs kernel daemons, before the final sync in fs_cleanup
+ */
+void
+sfs_daemon_cleanup(void) {
+    sfs_writeback_cleanup();
+    sfs_readahead_cleanup();
+}
@@ -5,6 +5,7 @@
 #include <mmu.h>
 #include <list.h>
 #include <sem.h>
+#include <rwsem.h>
 #include <unistd.h>
 
 /*
@@ -21,6 +22,15 @@
 #define SFS_BLKN_SUPER                              0                       /* block the superblock lives in */
 #define SFS_BLKN_ROOT                               1                       /* location of the root dir inode */
 #define SFS_BLKN_FREEMAP                            2                       /* 1st block of the freemap */
+#define SFS_JOURNAL_MAGIC                           0x4a4e4c21              /* magic number for journal blocks */
+#define SFS_JOURNAL_NBLKS                           64                      /* # of blocks mksfs reserves for the journal */
+#define SFS_JOURNAL_NBUF                            16                      /* max # of metadata blocks held by the journal */
+#define SFS_CACHE_NBLKS                             32                      /* # of blocks in the block cache */
+#define SFS_RA_MIN                                  4                       /* initial readahead window (in blocks) */
+#define SFS_RA_MAX                                  16                      /* max readahead window (in blocks) */
+#define SFS_WB_NBUF                                 64                      /* # of dirty file blocks buffered */
+#define SFS_WB_CHUNK                                8                       /* max # of blocks in one write-back request */
+#define SFS_WB_INTERVAL                             500                     /* ticks between periodic write-backs */
 
 /* # of bits in a block */
 #define SFS_BLKBITS                                 (SFS_BLKSIZE * CHAR_BIT)
@@ -42,6 +52,8 @@ struct sfs_super {
     uint32_t blocks;                                /* # of blocks in fs */
     uint32_t unused_blocks;                         /* # of unused blocks in fs */
     char info[SFS_MAX_INFO_LEN + 1];                /* infomation for sfs  */
+    uint32_t journal;                               /* 1st block of the journal region, 0 if none */
+    uint32_t journal_blocks;                        /* # of blocks in the journal region */
 };
 
 /* inode (on disk) */
@@ -65,20 +77,111 @@ struct sfs_disk_entry {
 #define sfs_dentry_size                             \
     sizeof(((struct sfs_disk_entry *)0)->name)
 
+/*
+ * On-disk journal. The 1st block of the journal region holds the header, the
+ * rest is a circular log of transactions: descriptor | block images | commit.
+ */
+struct sfs_journal_header {
+    uint32_t magic;                                 /* magic number, should be SFS_JOURNAL_MAGIC */
+    uint32_t sequence;                              /* sequence of the 1st transaction to replay */
+    uint32_t start;                                 /* log offset of that transaction */
+};
+
+/* transaction descriptor (on disk) */
+struct sfs_journal_desc {
+    uint32_t magic;                                 /* magic number, should be SFS_JOURNAL_MAGIC */
+    uint32_t sequence;                              /* sequence of the transaction */
+    uint32_t nblks;                                 /* # of block images following */
+    uint32_t blkno[SFS_JOURNAL_NBUF];               /* home location of each image */
+};
+
+/* transaction commit block (on disk), the transaction is valid once it is written */
+struct sfs_journal_commit {
+    uint32_t magic;                                 /* magic number, should be SFS_JOURNAL_MAGIC */
+    uint32_t sequence;                              /* sequence of the transaction */
+    uint32_t nblks;                                 /* # of block images in the transaction */
+    uint32_t checksum;                              /* checksum of the block images */
+};
+
 /* inode for sfs */
 struct sfs_inode {
     struct sfs_disk_inode *din;                     /* on-disk inode */
     uint32_t ino;                                   /* inode number */
     bool dirty;                                     /* true if inode modified */
     int reclaim_count;                              /* kill inode if it hits zero */
-    semaphore_t sem;                                /* semaphore for din */
+    rwsem_t sem;                                    /* semaphore for din, shared by readers */
     list_entry_t inode_link;                        /* entry for linked-list in sfs_fs */
     list_entry_t hash_link;                         /* entry for hash linked-list in sfs_fs */
+    uint32_t ra_next;                               /* block index a sequential read goes on with */
+    uint32_t ra_end;                                /* end of the blocks already sent to readahead */
+    uint32_t ra_size;                               /* current readahead window, 0 if access is random */
+    list_entry_t dirty_list;                        /* dirty file blocks, sorted by index */
+    int ndirty;                                     /* # of dirty file blocks */
 };
 
 #define le2sin(le, member)                          \
     to_struct((le), struct sfs_inode, member)
 
+/* metadata block held by the journal */
+struct sfs_jbuf {
+    uint32_t blkno;                                 /* home location of the block */
+    bool running;                                   /* modified in the running transaction */
+    void *data;                                     /* newest image of the block */
+};
+
+/* in-memory journal state */
+struct sfs_journal {
+    uint32_t start;                                 /* 1st block of the log, 0 if no journal */
+    uint32_t size;                                  /* # of blocks in the log */
+    uint32_t sequence;                              /* sequence of the running transaction */
+    uint32_t head;                                  /* log offset where the next commit goes */
+    uint32_t used;                                  /* # of log blocks not checkpointed yet */
+    int nbuf;                                       /* # of bufs in use */
+    int nrunning;                                   /* # of bufs in the running transaction */
+    struct sfs_jbuf bufs[SFS_JOURNAL_NBUF];         /* committed or running metadata blocks */
+    void *buffer;                                   /* SFS_JOURNAL_NBUF block images */
+    void *scratch;                                  /* buffer for descriptor/commit/header */
+};
+
+#define sfs_journal_enabled(sfs)                    ((sfs)->journal.start != 0)
+
+/* clean copy of a disk block in the block cache */
+struct sfs_cblock {
+    uint32_t blkno;                                 /* NO. of the disk block, 0 if unused */
+    list_entry_t lru_link;                          /* entry in sfs_cache's lru list */
+    void *data;                                     /* content of the block */
+};
+
+#define le2cblock(le, member)                       \
+    to_struct((le), struct sfs_cblock, member)
+
+/* block cache, filled by readahead and kept in sync by writes */
+struct sfs_cache {
+    list_entry_t lru;                               /* most recently used first */
+    struct sfs_cblock blocks[SFS_CACHE_NBLKS];
+    void *buffer;                                   /* SFS_CACHE_NBLKS block contents */
+};
+
+/* dirty file block buffered by write-back, its disk block is allocated when flushed */
+struct sfs_dblock {
+    uint32_t index;                                 /* logical index of the block in the file */
+    list_entry_t dirty_link;                        /* entry in sfs_inode's dirty list or the free list */
+    void *data;                                     /* content of the block */
+};
+
+#define le2dblock(le, member)                       \
+    to_struct((le), struct sfs_dblock, member)
+
+/* write-back buffers */
+struct sfs_wb {
+    list_entry_t free_list;                         /* free dblocks */
+    int nfree;                                      /* # of free dblocks */
+    struct sfs_dblock blocks[SFS_WB_NBUF];
+    void *buffer;                                   /* SFS_WB_NBUF block contents */
+    void *chunk;                                    /* SFS_WB_CHUNK blocks, staging area for a write-back request */
+    semaphore_t chunk_sem;                          /* semaphore for chunk */
+};
+
 /* filesystem for sfs */
 struct sfs_fs {
     struct sfs_super super;                         /* on-disk superblock */
@@ -86,11 +189,14 @@ struct sfs_fs {
     struct bitmap *freemap;                         /* blocks in use are mared 0 */
     bool super_dirty;                               /* true if super/freemap modified */
     void *sfs_buffer;                               /* buffer for non-block aligned io */
-    semaphore_t fs_sem;                             /* semaphore for fs */
+    rwsem_t fs_sem;                                 /* semaphore for fs, shared by lookups */
     semaphore_t io_sem;                             /* semaphore for io */
     semaphore_t mutex_sem;                          /* semaphore for link/unlink and rename */
     list_entry_t inode_list;                        /* inode linked-list */
     list_entry_t *hash_list;                        /* inode hash linked-list */
+    struct sfs_journal journal;                     /* metadata journal */
+    struct sfs_cache cache;                         /* block cache */
+    struct sfs_wb wb;                               /* write-back buffers */
 };
 
 /* hash for sfs */
@@ -108,13 +214,18 @@ struct fs;
 struct inode;
 
 void sfs_init(void);
+void sfs_daemon_init(void);
+void sfs_daemon_cleanup(void);
 int sfs_mount(const char *devname);
 
 void lock_sfs_fs(struct sfs_fs *sfs);
+void lock_sfs_fs_shared(struct sfs_fs *sfs);
 void lock_sfs_io(struct sfs_fs *sfs);
 void unlock_sfs_fs(struct sfs_fs *sfs);
+void unlock_sfs_fs_shared(struct sfs_fs *sfs);
 void unlock_sfs_io(struct sfs_fs *sfs);
 
+int sfs_rwblock_raw_nolock(struct sfs_fs *sfs, void *buf, uint32_t blkno, bool write);
 int sfs_rblock(struct sfs_fs *sfs, void *buf, uint32_t blkno, uint32_t nblks);
 int sfs_wblock(struct sfs_fs *sfs, void *buf, uint32_t blkno, uint32_t nblks);
 int sfs_rbuf(struct sfs_fs *sfs, void *buf, size_t len, uint32_t blkno, off_t offset);
@@ -122,8 +233,36 @@ int sfs_wbuf(struct sfs_fs *sfs, void *buf, size_t len, uint32_t blkno, off_t of
 int sfs_sync_super(struct sfs_fs *sfs);
 int sfs_sync_freemap(struct sfs_fs *sfs);
 int sfs_clear_block(struct sfs_fs *sfs, uint32_t blkno, uint32_t nblks);
+int sfs_wextent(struct sfs_fs *sfs, void *buf, uint32_t blkno, uint32_t nblks);
 
 int sfs_load_inode(struct sfs_fs *sfs, struct inode **node_store, uint32_t ino);
+int sfs_sync_inode(struct sfs_fs *sfs, struct sfs_inode *sin, bool wait);
+
+int sfs_journal_init(struct sfs_fs *sfs);
+void sfs_journal_destroy(struct sfs_fs *sfs);
+int sfs_journal_replay(struct sfs_fs *sfs);
+int sfs_journal_write(struct sfs_fs *sfs, void *buf, size_t len, uint32_t blkno, off_t offset);
+int sfs_journal_commit(struct sfs_fs *sfs);
+int sfs_journal_checkpoint(struct sfs_fs *sfs);
+bool sfs_journal_read_nolock(struct sfs_fs *sfs, void *buf, uint32_t blkno);
+int sfs_journal_revoke_nolock(struct sfs_fs *sfs, uint32_t blkno);
+
+int sfs_cache_init(struct sfs_fs *sfs);
+void sfs_cache_destroy(struct sfs_fs *sfs);
+bool sfs_cache_read_nolock(struct sfs_fs *sfs, void *buf, uint32_t blkno);
+void sfs_cache_update_nolock(struct sfs_fs *sfs, void *buf, uint32_t blkno);
+int sfs_cache_fill_nolock(struct sfs_fs *sfs, uint32_t blkno);
+
+void sfs_readahead(struct sfs_fs *sfs, uint32_t *blknos, uint32_t nblks);
+void sfs_readahead_init(void);
+void sfs_readahead_cleanup(void);
+
+int sfs_wb_init(struct sfs_fs *sfs);
+void sfs_wb_destroy(struct sfs_fs *sfs);
+struct sfs_dblock *sfs_dblock_alloc(struct sfs_fs *sfs);
+void sfs_dblock_free(struct sfs_fs *sfs, struct sfs_dblock *db);
+void sfs_writeback_init(void);
+void sfs_writeback_cleanup(void);
 
 #endif /* !__KERN_FS_SFS_SFS_H__ */
 
@@ -0,0 +1,110 @@
+#include <defs.h>
+#include <string.h>
+#include <list.h>
+#include <kmalloc.h>
+#include <sfs.h>
+#include <error.h>
+#include <assert.h>
+
+/*
+ * Block cache for SFS.
+ *
+ * A small LRU cache of clean disk blocks. It is filled by readahead (and by the
+ * indirect block lookups readahead needs), every read in sfs_rwblock_nolock looks
+ * here before going to the device, and every write to the device updates the
+ * cached copy, so the cache never holds stale data. All functions run under
+ * sfs->io_sem.
+ */
+
+/*
+ * sfs_cache_init - allocate the cache blocks of sfs, called in sfs_do_mount
+ */
+int
+sfs_cache_init(struct sfs_fs *sfs) {
+    struct sfs_cache *cache = &(sfs->cache);
+    void *buffer;
+    if ((buffer = kmalloc(SFS_CACHE_NBLKS * SFS_BLKSIZE)) == NULL) {
+        return -E_NO_MEM;
+    }
+    cache->buffer = buffer;
+    list_init(&(cache->lru));
+    int i;
+    for (i = 0; i < SFS_CACHE_NBLKS; i ++) {
+        struct sfs_cblock *cb = cache->blocks + i;
+        cb->blkno = 0, cb->data = buffer + i * SFS_BLKSIZE;
+        list_add_before(&(cache->lru), &(cb->lru_link));
+    }
+    return 0;
+}
+
+/*
+ * sfs_cache_destroy - free the cache blocks of sfs
+ */
+void
+sfs_cache_destroy(struct sfs_fs *sfs) {
+    kfree(sfs->cache.buffer);
+}
+
+/*
+ * sfs_cache_lookup - find the cache block holding disk block blkno
+ */
+static struct sfs_cblock *
+sfs_cache_lookup(struct sfs_cache *cache, uint32_t blkno) {
+    list_entry_t *list = &(cache->lru), *le = list;
+    while ((le = list_next(le)) != list) {
+        struct sfs_cblock *cb = le2cblock(le, lru_link);
+        if (cb->blkno == blkno) {
+            return cb;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * sfs_cache_read_nolock - if blkno is cached, copy it into buf and return 1
+ */
+bool
+sfs_cache_read_nolock(struct sfs_fs *sfs, void *buf, uint32_t blkno) {
+    struct sfs_cache *cache = &(sfs->cache);
+    struct sfs_cblock *cb;
+    if (blkno != 0 && (cb = sfs_cache_lookup(cache, blkno)) != NULL) {
+        memcpy(buf, cb->data, SFS_BLKSIZE);
+        list_del(&(cb->lru_link));
+        list_add_after(&(cache->lru), &(cb->lru_link));
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * sfs_cache_update_nolock - blkno is written to the device, keep the cached copy in sync
+ */
+void
+sfs_cache_update_nolock(struct sfs_fs *sfs, void *buf, uint32_t blkno) {
+    struct sfs_cblock *cb;
+    if (blkno != 0 && (cb = sfs_cache_lookup(&(sfs->cache), blkno)) != NULL) {
+        memcpy(cb->data, buf, SFS_BLKSIZE);
+    }
+}
+
+/*
+ * sfs_cache_fill_nolock - read disk block blkno into the least recently used cache block
+ */
+int
+sfs_cache_fill_nolock(struct sfs_fs *sfs, uint32_t blkno) {
+    struct sfs_cache *cache = &(sfs->cache);
+    assert(blkno != 0);
+    if (sfs_cache_lookup(cache, blkno) != NULL) {
+        return 0;
+    }
+    struct sfs_cblock *cb = le2cblock(list_prev(&(cache->lru)), lru_link);
+    int ret;
+    cb->blkno = 0;
+    if ((ret = sfs_rwblock_raw_nolock(sfs, cb->data, blkno, 0)) != 0) {
+        return ret;
+    }
+    cb->blkno = blkno;
+    list_del(&(cb->lru_link));
+    list_add_after(&(cache->lru), &(cb->lru_link));
+    return 0;
+}
@@ -15,19 +15,25 @@
 
 /*
  * sfs_sync - sync sfs's superblock and freemap in memroy into disk
+ *
+ * The dirty data blocks of all inodes are written back, then the dirty inodes,
+ * the superblock and the freemap go into one journal transaction, which is then
+ * checkpointed to the home locations. An inode locked by its user is skipped
+ * (waiting for it under fs_sem could deadlock with sfs_lookup), it is synced
+ * when that user closes it. The inode list is only read, so fs_sem is shared.
  */
 static int
 sfs_sync(struct fs *fs) {
     struct sfs_fs *sfs = fsop_info(fs, sfs);
-    lock_sfs_fs(sfs);
+    lock_sfs_fs_shared(sfs);
     {
         list_entry_t *list = &(sfs->inode_list), *le = list;
         while ((le = list_next(le)) != list) {
             struct sfs_inode *sin = le2sin(le, inode_link);
-            vop_fsync(info2node(sin, sfs_inode));
+            sfs_sync_inode(sfs, sin, 0);
         }
     }
-    unlock_sfs_fs(sfs);
+    unlock_sfs_fs_shared(sfs);
 
     int ret;
     if (sfs->super_dirty) {
@@ -41,7 +47,7 @@ sfs_sync(struct fs *fs) {
             return ret;
         }
     }
-    return 0;
+    return sfs_journal_checkpoint(sfs);
 }
 
 /*
@@ -67,6 +73,9 @@ sfs_unmount(struct fs *fs) {
         return -E_BUSY;
     }
     assert(!sfs->super_dirty);
+    sfs_wb_destroy(sfs);
+    sfs_journal_destroy(sfs);
+    sfs_cache_destroy(sfs);
     bitmap_destroy(sfs->freemap);
     kfree(sfs->sfs_buffer);
     kfree(sfs->hash_list);
@@ -191,6 +200,22 @@ sfs_do_mount(struct device *dev, struct fs **fs_store) {
     super->info[SFS_MAX_INFO_LEN] = '\0';
     sfs->super = *super;
 
+    /* redo committed journal transactions, then reload the superblock they may have changed */
+    if ((ret = sfs_cache_init(sfs)) != 0) {
+        goto failed_cleanup_sfs_buffer;
+    }
+    if ((ret = sfs_journal_init(sfs)) != 0) {
+        goto failed_cleanup_cache;
+    }
+    if ((ret = sfs_journal_replay(sfs)) != 0) {
+        goto failed_cleanup_journal;
+    }
+    if ((ret = sfs_init_read(dev, SFS_BLKN_SUPER, sfs_buffer)) != 0) {
+        goto failed_cleanup_journal;
+    }
+    super->info[SFS_MAX_INFO_LEN] = '\0';
+    sfs->super = *super;
+
     ret = -E_NO_MEM;
 
     uint32_t i;
@@ -198,7 +223,7 @@ sfs_do_mount(struct device *dev, struct fs **fs_store) {
     /* alloc and initialize hash list */
     list_entry_t *hash_list;
     if ((sfs->hash_list = hash_list = kmalloc(sizeof(list_entry_t) * SFS_HLIST_SIZE)) == NULL) {
-        goto failed_cleanup_sfs_buffer;
+        goto failed_cleanup_journal;
     }
     for (i = 0; i < SFS_HLIST_SIZE; i ++) {
         list_init(hash_list + i);
@@ -223,9 +248,14 @@ sfs_do_mount(struct device *dev, struct fs **fs_store) {
     }
     assert(unused_blocks == sfs->super.unused_blocks);
 
+    /* alloc write-back buffers */
+    if ((ret = sfs_wb_init(sfs)) != 0) {
+        goto failed_cleanup_freemap;
+    }
+
     /* and other fields */
     sfs->super_dirty = 0;
-    sem_init(&(sfs->fs_sem), 1);
+    rwsem_init(&(sfs->fs_sem));
     sem_init(&(sfs->io_sem), 1);
     sem_init(&(sfs->mutex_sem), 1);
     list_init(&(sfs->inode_list));
@@ -244,6 +274,10 @@ failed_cleanup_freemap:
     bitmap_destroy(freemap);
 failed_cleanup_hash_list:
     kfree(hash_list);
+failed_cleanup_journal:
+    sfs_journal_destroy(sfs);
+failed_cleanup_cache:
+    sfs_cache_destroy(sfs);
 failed_cleanup_sfs_buffer:
     kfree(sfs_buffer);
 failed_cleanup_fs:
@@ -10,6 +10,7 @@
 #include <inode.h>
 #include <iobuf.h>
 #include <bitmap.h>
+#include <trace.h>
 #include <error.h>
 #include <assert.h>
 
@@ -21,7 +22,7 @@ static const struct inode_ops sfs_node_fileops; // file operations
  */
 static void
 lock_sin(struct sfs_inode *sin) {
-    down(&(sin->sem));
+    down_write(&(sin->sem));
 }
 
 /*
@@ -29,7 +30,24 @@ lock_sin(struct sfs_inode *sin) {
  */
 static void
 unlock_sin(struct sfs_inode *sin) {
-    up(&(sin->sem));
+    up_write(&(sin->sem));
+}
+
+/*
+ * lock_sin_shared - lock the inode for reading only: file reads, directory lookups
+ *                   and listings of one inode run in parallel
+ */
+static void
+lock_sin_shared(struct sfs_inode *sin) {
+    down_read(&(sin->sem));
+}
+
+/*
+ * unlock_sin_shared - unlock the inode locked for reading
+ */
+static void
+unlock_sin_shared(struct sfs_inode *sin) {
+    up_read(&(sin->sem));
 }
 
 /*
@@ -85,9 +103,10 @@ sfs_block_inuse(struct sfs_fs *sfs, uint32_t ino) {
 
 /*
  * sfs_block_alloc -  check and get a free disk block
+ * @clear:    BOOL, clear the new block on disk (0 if the caller writes all of it soon)
  */
 static int
-sfs_block_alloc(struct sfs_fs *sfs, uint32_t *ino_store) {
+sfs_block_alloc(struct sfs_fs *sfs, uint32_t *ino_store, bool clear) {
     int ret;
     if ((ret = bitmap_alloc(sfs->freemap, ino_store)) != 0) {
         return ret;
@@ -95,7 +114,7 @@ sfs_block_alloc(struct sfs_fs *sfs, uint32_t *ino_store) {
     assert(sfs->super.unused_blocks > 0);
     sfs->super.unused_blocks --, sfs->super_dirty = 1;
     assert(sfs_block_inuse(sfs, *ino_store));
-    return sfs_clear_block(sfs, *ino_store, 1);
+    return clear ? sfs_clear_block(sfs, *ino_store, 1) : 0;
 }
 
 /*
@@ -118,7 +137,9 @@ sfs_create_inode(struct sfs_fs *sfs, struct sfs_disk_inode *din, uint32_t ino, s
         vop_init(node, sfs_get_ops(din->type), info2fs(sfs, sfs));
         struct sfs_inode *sin = vop_info(node, sfs_inode);
         sin->din = din, sin->ino = ino, sin->dirty = 0, sin->reclaim_count = 1;
-        sem_init(&(sin->sem), 1);
+        sin->ra_next = sin->ra_end = sin->ra_size = 0;
+        list_init(&(sin->dirty_list)), sin->ndirty = 0;
+        rwsem_init(&(sin->sem));
         *node_store = node;
         return 0;
     }
@@ -153,8 +174,19 @@ lookup_sfs_nolock(struct sfs_fs *sfs, uint32_t ino) {
  */
 int
 sfs_load_inode(struct sfs_fs *sfs, struct inode **node_store, uint32_t ino) {
-    lock_sfs_fs(sfs);
     struct inode *node;
+    lock_sfs_fs_shared(sfs);
+    {
+        node = lookup_sfs_nolock(sfs, ino);
+    }
+    unlock_sfs_fs_shared(sfs);
+    if (node != NULL) {
+        *node_store = node;
+        return 0;
+    }
+
+    lock_sfs_fs(sfs);
+    // it may be loaded by someone else while fs_sem was released
     if ((node = lookup_sfs_nolock(sfs, ino)) != NULL) {
         goto out_unlock;
     }
@@ -195,10 +227,11 @@ failed_unlock:
  * @entp:     the pointer of index of entry disk block
  * @index:    the index of block in indrect block
  * @create:   BOOL, if the block isn't allocated, if create = 1 the alloc a block,  otherwise just do nothing
+ * @clear:    BOOL, clear the new allocated block (the indirect block is always cleared)
  * @ino_store: 0 OR the index of already inused block or new allocated block.
  */
 static int
-sfs_bmap_get_sub_nolock(struct sfs_fs *sfs, uint32_t *entp, uint32_t index, bool create, uint32_t *ino_store) {
+sfs_bmap_get_sub_nolock(struct sfs_fs *sfs, uint32_t *entp, uint32_t index, bool create, bool clear, uint32_t *ino_store) {
     assert(index < SFS_BLK_NENTRY);
     int ret;
     uint32_t ent, ino = 0;
@@ -217,15 +250,15 @@ sfs_bmap_get_sub_nolock(struct sfs_fs *sfs, uint32_t *entp, uint32_t index, bool
             goto out;
         }
 		//if entry block isn't existd, allocated a entry block (for indrect block)
-        if ((ret = sfs_block_alloc(sfs, &ent)) != 0) {
+        if ((ret = sfs_block_alloc(sfs, &ent, 1)) != 0) {
             return ret;
         }
     }
     
-    if ((ret = sfs_block_alloc(sfs, &ino)) != 0) {
+    if ((ret = sfs_block_alloc(sfs, &ino, clear)) != 0) {
         goto failed_cleanup;
     }
-    if ((ret = sfs_wbuf(sfs, &ino, sizeof(uint32_t), ent, offset)) != 0) {
+    if ((ret = sfs_journal_write(sfs, &ino, sizeof(uint32_t), ent, offset)) != 0) {
         sfs_block_free(sfs, ino);
         goto failed_cleanup;
     }
@@ -251,17 +284,18 @@ failed_cleanup:
  * @sin:      sfs inode in memory
  * @index:    the index of block in inode
  * @create:   BOOL, if the block isn't allocated, if create = 1 the alloc a block,  otherwise just do nothing
+ * @clear:    BOOL, clear the new allocated block
  * @ino_store: 0 OR the index of already inused block or new allocated block.
  */
 static int
-sfs_bmap_get_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t index, bool create, uint32_t *ino_store) {
+sfs_bmap_get_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t index, bool create, bool clear, uint32_t *ino_store) {
     struct sfs_disk_inode *din = sin->din;
     int ret;
     uint32_t ent, ino;
 	// the index of disk block is in the fist SFS_NDIRECT  direct blocks
     if (index < SFS_NDIRECT) {
         if ((ino = din->direct[index]) == 0 && create) {
-            if ((ret = sfs_block_alloc(sfs, &ino)) != 0) {
+            if ((ret = sfs_block_alloc(sfs, &ino, clear)) != 0) {
                 return ret;
             }
             din->direct[index] = ino;
@@ -273,7 +307,7 @@ sfs_bmap_get_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t index, b
     index -= SFS_NDIRECT;
     if (index < SFS_BLK_NENTRY) {
         ent = din->indirect;
-        if ((ret = sfs_bmap_get_sub_nolock(sfs, &ent, index, create, &ino)) != 0) {
+        if ((ret = sfs_bmap_get_sub_nolock(sfs, &ent, index, create, clear, &ino)) != 0) {
             return ret;
         }
         if (ent != din->indirect) {
@@ -304,7 +338,7 @@ sfs_bmap_free_sub_nolock(struct sfs_fs *sfs, uint32_t ent, uint32_t index) {
         return ret;
     }
     if (ino != 0) {
-        if ((ret = sfs_wbuf(sfs, &zero, sizeof(uint32_t), ent, offset)) != 0) {
+        if ((ret = sfs_journal_write(sfs, &zero, sizeof(uint32_t), ent, offset)) != 0) {
             return ret;
         }
         sfs_block_free(sfs, ino);
@@ -357,7 +391,7 @@ sfs_bmap_load_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t index,
     int ret;
     uint32_t ino;
     bool create = (index == din->blocks);
-    if ((ret = sfs_bmap_get_nolock(sfs, sin, index, create, &ino)) != 0) {
+    if ((ret = sfs_bmap_get_nolock(sfs, sin, index, create, 1, &ino)) != 0) {
         return ret;
     }
     assert(sfs_block_inuse(sfs, ino));
@@ -370,6 +404,35 @@ sfs_bmap_load_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t index,
     return 0;
 }
 
+/*
+ * sfs_bmap_extend_nolock - like sfs_bmap_load_nolock, but index may be past the end of file:
+ *                          the blocks in between are allocated (and cleared) first
+ * @clear:    BOOL, clear the block of index if it is new (0 if the caller writes all of it)
+ */
+static int
+sfs_bmap_extend_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t index, bool clear, uint32_t *ino_store) {
+    struct sfs_disk_inode *din = sin->din;
+    int ret;
+    uint32_t ino;
+    while (din->blocks < index) {
+        if ((ret = sfs_bmap_load_nolock(sfs, sin, din->blocks, NULL)) != 0) {
+            return ret;
+        }
+        sin->dirty = 1;
+    }
+    if (index < din->blocks) {
+        return sfs_bmap_load_nolock(sfs, sin, index, ino_store);
+    }
+    if ((ret = sfs_bmap_get_nolock(sfs, sin, index, 1, clear, &ino)) != 0) {
+        return ret;
+    }
+    assert(sfs_block_inuse(sfs, ino));
+    din->blocks ++;
+    sin->dirty = 1;
+    *ino_store = ino;
+    return 0;
+}
+
 /*
  * sfs_bmap_truncate_nolock - free the disk block at the end of file
  */
@@ -499,11 +562,11 @@ static int
 sfs_lookup_once(struct sfs_fs *sfs, struct sfs_inode *sin, const char *name, struct inode **node_store, int *slot) {
     int ret;
     uint32_t ino;
-    lock_sin(sin);
+    lock_sin_shared(sin);
     {   // find the NO. of disk block and logical index of file entry
         ret = sfs_dirent_search_nolock(sfs, sin, name, &ino, slot, NULL);
     }
-    unlock_sin(sin);
+    unlock_sin_shared(sin);
     if (ret == 0) {
 		// load the content of inode with the the NO. of disk block
         ret = sfs_load_inode(sfs, node_store, ino);
@@ -540,6 +603,173 @@ sfs_close(struct inode *node) {
     return vop_fsync(node);
 }
 
+/*
+ * sfs_dirty_lookup - find the dirty block of sin holding file block index, NULL if it is clean
+ */
+static struct sfs_dblock *
+sfs_dirty_lookup(struct sfs_inode *sin, uint32_t index) {
+    list_entry_t *list = &(sin->dirty_list), *le = list;
+    while ((le = list_prev(le)) != list) {
+        struct sfs_dblock *db = le2dblock(le, dirty_link);
+        if (db->index <= index) {
+            return (db->index == index) ? db : NULL;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * sfs_dirty_insert - link db into the dirty list of sin, which is kept sorted by index
+ */
+static void
+sfs_dirty_insert(struct sfs_inode *sin, struct sfs_dblock *db) {
+    list_entry_t *list = &(sin->dirty_list), *le = list;
+    while ((le = list_prev(le)) != list) {
+        if (le2dblock(le, dirty_link)->index < db->index) {
+            break;
+        }
+    }
+    list_add_after(le, &(db->dirty_link));
+    sin->ndirty ++;
+}
+
+/*
+ * sfs_dirty_drop_nolock - discard the dirty blocks of sin from file block index on (truncate)
+ */
+static void
+sfs_dirty_drop_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, uint32_t index) {
+    list_entry_t *list = &(sin->dirty_list), *le;
+    while ((le = list_prev(list)) != list) {
+        struct sfs_dblock *db = le2dblock(le, dirty_link);
+        if (db->index < index) {
+            break;
+        }
+        list_del(le);
+        sin->ndirty --;
+        sfs_dblock_free(sfs, db);
+    }
+}
+
+/*
+ * sfs_dirty_flush_nolock - write all dirty blocks of sin back to disk. no lock protect
+ *
+ * The disk blocks are allocated here, in file order, so a file written sequentially gets
+ * contiguous blocks; each run of up to SFS_WB_CHUNK of them is written with one request.
+ */
+static int
+sfs_dirty_flush_nolock(struct sfs_fs *sfs, struct sfs_inode *sin) {
+    struct sfs_wb *wb = &(sfs->wb);
+    if (sin->ndirty == 0) {
+        return 0;
+    }
+    int ret = 0;
+    down(&(wb->chunk_sem));
+    list_entry_t *list = &(sin->dirty_list), *le;
+    while (!list_empty(list)) {
+        uint32_t first = le2dblock(list_next(list), dirty_link)->index;
+        uint32_t n, ino, blkno = 0;
+        for (n = 0, le = list_next(list); n < SFS_WB_CHUNK && le != list; n ++, le = list_next(le)) {
+            struct sfs_dblock *db = le2dblock(le, dirty_link);
+            if (db->index != first + n) {
+                break;
+            }
+            if ((ret = sfs_bmap_extend_nolock(sfs, sin, db->index, 0, &ino)) != 0) {
+                break;
+            }
+            if (n == 0) {
+                blkno = ino;
+            }
+            else if (ino != blkno + n) {
+                break;
+            }
+            memcpy(wb->chunk + n * SFS_BLKSIZE, db->data, SFS_BLKSIZE);
+        }
+        if (n != 0) {
+            int err;
+            if ((err = sfs_wextent(sfs, wb->chunk, blkno, n)) != 0) {
+                ret = err;
+                break;
+            }
+            while (n -- > 0) {
+                le = list_next(list);
+                list_del(le);
+                sin->ndirty --;
+                sfs_dblock_free(sfs, le2dblock(le, dirty_link));
+            }
+        }
+        if (ret != 0) {
+            break;
+        }
+    }
+    up(&(wb->chunk_sem));
+    return ret;
+}
+
+/*
+ * sfs_rblk_nolock - read size bytes at blkoff of file block index: from its dirty block,
+ *                   as zeros if it has no disk block yet, or from the disk
+ */
+static int
+sfs_rblk_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, void *buf, uint32_t index, off_t blkoff, size_t size) {
+    struct sfs_dblock *db;
+    if ((db = sfs_dirty_lookup(sin, index)) != NULL) {
+        memcpy(buf, db->data + blkoff, size);
+        return 0;
+    }
+    if (index >= sin->din->blocks) {
+        memset(buf, 0, size);
+        return 0;
+    }
+    int ret;
+    uint32_t ino;
+    if ((ret = sfs_bmap_load_nolock(sfs, sin, index, &ino)) != 0) {
+        return ret;
+    }
+    if (size == SFS_BLKSIZE) {
+        return sfs_rblock(sfs, buf, ino, 1);
+    }
+    return sfs_rbuf(sfs, buf, size, ino, blkoff);
+}
+
+/*
+ * sfs_wblk_nolock - write size bytes at blkoff of file block index into its dirty block.
+ *                   If no write-back buffer is left even after flushing sin, write through.
+ */
+static int
+sfs_wblk_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, void *buf, uint32_t index, off_t blkoff, size_t size) {
+    int ret;
+    struct sfs_dblock *db;
+    if ((db = sfs_dirty_lookup(sin, index)) != NULL) {
+        goto out;
+    }
+    if ((db = sfs_dblock_alloc(sfs)) == NULL) {
+        if ((ret = sfs_dirty_flush_nolock(sfs, sin)) != 0) {
+            return ret;
+        }
+        if ((db = sfs_dblock_alloc(sfs)) == NULL) {
+            uint32_t ino;
+            if ((ret = sfs_bmap_extend_nolock(sfs, sin, index, size != SFS_BLKSIZE, &ino)) != 0) {
+                return ret;
+            }
+            if (size == SFS_BLKSIZE) {
+                return sfs_wblock(sfs, buf, ino, 1);
+            }
+            return sfs_wbuf(sfs, buf, size, ino, blkoff);
+        }
+    }
+    if (size != SFS_BLKSIZE) {
+        if ((ret = sfs_rblk_nolock(sfs, sin, db->data, index, 0, SFS_BLKSIZE)) != 0) {
+            sfs_dblock_free(sfs, db);
+            return ret;
+        }
+    }
+    db->index = index;
+    sfs_dirty_insert(sin, db);
+out:
+    memcpy(db->data + blkoff, buf, size);
+    return 0;
+}
+
 /*  
  * sfs_io_nolock - Rd/Wr a file contentfrom offset position to offset+ length  disk blocks<-->buffer (in memroy)
  * @sfs:      sfs file system
@@ -553,6 +783,7 @@ static int
 sfs_io_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, void *buf, off_t offset, size_t *alenp, bool write) {
     struct sfs_disk_inode *din = sin->din;
     assert(din->type != SFS_TYPE_DIR);
+    trace(TRACE_SFS_IO, sin->ino, offset, *alenp, write);
     off_t endpos = offset + *alenp, blkoff;
     *alenp = 0;
 	// calculate the Rd/Wr end position
@@ -574,65 +805,29 @@ sfs_io_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, void *buf, off_t offset
         }
     }
 
-    int (*sfs_buf_op)(struct sfs_fs *sfs, void *buf, size_t len, uint32_t blkno, off_t offset);
-    int (*sfs_block_op)(struct sfs_fs *sfs, void *buf, uint32_t blkno, uint32_t nblks);
-    if (write) {
-        sfs_buf_op = sfs_wbuf, sfs_block_op = sfs_wblock;
-    }
-    else {
-        sfs_buf_op = sfs_rbuf, sfs_block_op = sfs_rblock;
-    }
-
+    /*
+     * Rd/Wr block by block: a write only fills dirty blocks of sin (see sfs_wblk_nolock),
+     * the disk blocks are allocated and written when sin is flushed (sfs_dirty_flush_nolock)
+     */
     int ret = 0;
     size_t size, alen = 0;
-    uint32_t ino;
     uint32_t blkno = offset / SFS_BLKSIZE;          // The NO. of Rd/Wr begin block
-    uint32_t nblks = endpos / SFS_BLKSIZE - blkno;  // The size of Rd/Wr blocks
-
-  //LAB8:EXERCISE1 YOUR CODE HINT: call sfs_bmap_load_nolock, sfs_rbuf, sfs_rblock,etc. read different kind of blocks in file
-	/*
-	 * (1) If offset isn't aligned with the first block, Rd/Wr some content from offset to the end of the first block
-	 *       NOTICE: useful function: sfs_bmap_load_nolock, sfs_buf_op
-	 *               Rd/Wr size = (nblks != 0) ? (SFS_BLKSIZE - blkoff) : (endpos - offset)
-	 * (2) Rd/Wr aligned blocks 
-	 *       NOTICE: useful function: sfs_bmap_load_nolock, sfs_block_op
-     * (3) If end position isn't aligned with the last block, Rd/Wr some content from begin to the (endpos % SFS_BLKSIZE) of the last block
-	 *       NOTICE: useful function: sfs_bmap_load_nolock, sfs_buf_op	
-	*/
-    if ((blkoff = offset % SFS_BLKSIZE) != 0) {
-        size = (nblks != 0) ? (SFS_BLKSIZE - blkoff) : (endpos - offset);
-        if ((ret = sfs_bmap_load_nolock(sfs, sin, blkno, &ino)) != 0) {
-            goto out;
-        }
-        if ((ret = sfs_buf_op(sfs, buf, size, ino, blkoff)) != 0) {
-            goto out;
-        }
-        alen += size;
-        if (nblks == 0) {
-            goto out;
-        }
-        buf += size, blkno ++, nblks --;
-    }
-
-    size = SFS_BLKSIZE;
-    while (nblks != 0) {
-        if ((ret = sfs_bmap_load_nolock(sfs, sin, blkno, &ino)) != 0) {
-            goto out;
+    blkoff = offset % SFS_BLKSIZE;
+    while (offset + alen < endpos) {
+        size = SFS_BLKSIZE - blkoff;
+        if (size > endpos - offset - alen) {
+            size = endpos - offset - alen;
         }
-        if ((ret = sfs_block_op(sfs, buf, ino, 1)) != 0) {
-            goto out;
+        if (write) {
+            ret = sfs_wblk_nolock(sfs, sin, buf, blkno, blkoff, size);
         }
-        alen += size, buf += size, blkno ++, nblks --;
-    }
-
-    if ((size = endpos % SFS_BLKSIZE) != 0) {
-        if ((ret = sfs_bmap_load_nolock(sfs, sin, blkno, &ino)) != 0) {
-            goto out;
+        else {
+            ret = sfs_rblk_nolock(sfs, sin, buf, blkno, blkoff, size);
         }
-        if ((ret = sfs_buf_op(sfs, buf, size, ino, 0)) != 0) {
+        if (ret != 0) {
             goto out;
         }
-        alen += size;
+        alen += size, buf += size, blkno ++, blkoff = 0;
     }
 out:
     *alenp = alen;
@@ -643,6 +838,66 @@ out:
     return ret;
 }
 
+/*
+ * sfs_readahead_nolock - after reading [offset, offset + alen), detect sequential access and
+ *                        send the next window of blocks to the readahead daemon
+ * @sfs:      sfs file system
+ * @sin:      sfs inode in memory
+ * @offset:   the offset of file the read started at
+ * @alen:     the length really read
+ *
+ * A read that starts in the block where the previous one stopped is sequential. Each time
+ * the blocks already sent ahead of the reader drop below half a window, the next window is
+ * sent and the window doubles, from SFS_RA_MIN up to SFS_RA_MAX. Any other read resets the
+ * window, so random access costs nothing beyond this check.
+ */
+static void
+sfs_readahead_nolock(struct sfs_fs *sfs, struct sfs_inode *sin, off_t offset, size_t alen) {
+    uint32_t blkno = offset / SFS_BLKSIZE, end = ROUNDUP_DIV(offset + alen, SFS_BLKSIZE);
+    bool sequential = (blkno == sin->ra_next || blkno + 1 == sin->ra_next);
+    sin->ra_next = end;
+    if (alen == 0 || !sequential) {
+        sin->ra_size = 0, sin->ra_end = end;
+        return;
+    }
+
+    uint32_t size = (sin->ra_size == 0) ? SFS_RA_MIN : sin->ra_size * 2;
+    if (size > SFS_RA_MAX) {
+        size = SFS_RA_MAX;
+    }
+    if (sin->ra_end < end) {
+        sin->ra_end = end;
+    }
+    if (sin->ra_end - end >= size / 2) {
+        return;
+    }
+
+    uint32_t index, stop = end + size, nblks = 0, ino, blknos[SFS_RA_MAX];
+    if (stop > sin->din->blocks) {
+        stop = sin->din->blocks;
+    }
+    if (sin->ra_end >= stop) {
+        return;
+    }
+    // the window reaches the indirect block: cache it, so resolving the window
+    // (and the reader's own block mapping) does not go to the disk for every entry
+    if (stop > SFS_NDIRECT && sin->din->indirect != 0) {
+        lock_sfs_io(sfs);
+        sfs_cache_fill_nolock(sfs, sin->din->indirect);
+        unlock_sfs_io(sfs);
+    }
+    for (index = sin->ra_end; index < stop; index ++) {
+        if (sfs_bmap_get_nolock(sfs, sin, index, 0, 0, &ino) != 0) {
+            break;
+        }
+        if (ino != 0) {
+            blknos[nblks ++] = ino;
+        }
+    }
+    sfs_readahead(sfs, blknos, nblks);
+    sin->ra_end = index, sin->ra_size = size;
+}
+
 /*
  * sfs_io - Rd/Wr file. the wrapper of sfs_io_nolock
             with lock protect
@@ -652,15 +907,20 @@ sfs_io(struct inode *node, struct iobuf *iob, bool write) {
     struct sfs_fs *sfs = fsop_info(vop_fs(node), sfs);
     struct sfs_inode *sin = vop_info(node, sfs_inode);
     int ret;
-    lock_sin(sin);
+    // readers only share the readahead state of sin, which is just a hint
+    write ? lock_sin(sin) : lock_sin_shared(sin);
     {
         size_t alen = iob->io_resid;
-        ret = sfs_io_nolock(sfs, sin, iob->io_base, iob->io_offset, &alen, write);
+        off_t offset = iob->io_offset;
+        ret = sfs_io_nolock(sfs, sin, iob->io_base, offset, &alen, write);
         if (alen != 0) {
             iobuf_skip(iob, alen);
         }
+        if (!write && ret == 0) {
+            sfs_readahead_nolock(sfs, sin, offset, alen);
+        }
     }
-    unlock_sin(sin);
+    write ? unlock_sin(sin) : unlock_sin_shared(sin);
     return ret;
 }
 
@@ -693,27 +953,53 @@ sfs_fstat(struct inode *node, struct stat *stat) {
     return 0;
 }
 
+/*
+ * sfs_sync_inode - write the dirty data blocks of sin back, then log its dirty on-disk inode
+ *                  into the running journal transaction (or write it in place if sfs has no journal)
+ * @wait:     BOOL, if sin is locked by someone else, 0 skips it (its owner syncs it on close)
+ */
+int
+sfs_sync_inode(struct sfs_fs *sfs, struct sfs_inode *sin, bool wait) {
+    int ret = 0;
+    if (sin->dirty || sin->ndirty != 0) {
+        if (wait) {
+            lock_sin(sin);
+        }
+        else if (!try_down_write(&(sin->sem))) {
+            return 0;
+        }
+        if ((ret = sfs_dirty_flush_nolock(sfs, sin)) == 0 && sin->dirty) {
+            sin->dirty = 0;
+            if ((ret = sfs_journal_write(sfs, sin->din, sizeof(struct sfs_disk_inode), sin->ino, 0)) != 0) {
+                sin->dirty = 1;
+            }
+        }
+        unlock_sin(sin);
+    }
+    return ret;
+}
+
 /*
  * sfs_fsync - Force any dirty inode info associated with this file to stable storage.
+ *             The inode, and the superblock/freemap it changed, are committed as one
+ *             journal transaction together with whatever other processes logged.
  */
 static int
 sfs_fsync(struct inode *node) {
     struct sfs_fs *sfs = fsop_info(vop_fs(node), sfs);
     struct sfs_inode *sin = vop_info(node, sfs_inode);
-    int ret = 0;
-    if (sin->dirty) {
-        lock_sin(sin);
-        {
-            if (sin->dirty) {
-                sin->dirty = 0;
-                if ((ret = sfs_wbuf(sfs, sin->din, sizeof(struct sfs_disk_inode), sin->ino, 0)) != 0) {
-                    sin->dirty = 1;
-                }
-            }
+    int ret;
+    if ((ret = sfs_sync_inode(sfs, sin, 1)) != 0) {
+        return ret;
+    }
+    if (sfs_journal_enabled(sfs) && sfs->super_dirty) {
+        sfs->super_dirty = 0;
+        if ((ret = sfs_sync_super(sfs)) != 0 || (ret = sfs_sync_freemap(sfs)) != 0) {
+            sfs->super_dirty = 1;
+            return ret;
         }
-        unlock_sin(sin);
     }
-    return ret;
+    return sfs_journal_commit(sfs);
 }
 
 /*
@@ -750,11 +1036,11 @@ sfs_namefile(struct inode *node, struct iobuf *iob) {
         node = parent, sin = vop_info(node, sfs_inode);
         assert(ino != sin->ino && sin->din->type == SFS_TYPE_DIR);
 
-        lock_sin(sin);
+        lock_sin_shared(sin);
         {
             ret = sfs_dirent_findino_nolock(sfs, sin, ino, entry);
         }
-        unlock_sin(sin);
+        unlock_sin_shared(sin);
 
         if (ret != 0) {
             goto failed;
@@ -826,12 +1112,12 @@ sfs_getdirentry(struct inode *node, struct iobuf *iob) {
         kfree(entry);
         return -E_NOENT;
     }
-    lock_sin(sin);
+    lock_sin_shared(sin);
     if ((ret = sfs_getdirentry_sub_nolock(sfs, sin, slot, entry)) != 0) {
-        unlock_sin(sin);
+        unlock_sin_shared(sin);
         goto out;
     }
-    unlock_sin(sin);
+    unlock_sin_shared(sin);
     ret = iobuf_move(iob, entry->name, sfs_dentry_size, 1, NULL);
 out:
     kfree(entry);
@@ -858,7 +1144,7 @@ sfs_reclaim(struct inode *node) {
             goto failed_unlock;
         }
     }
-    if (sin->dirty) {
+    if (sin->dirty || sin->ndirty != 0) {
         if ((ret = vop_fsync(node)) != 0) {
             goto failed_unlock;
         }
@@ -872,6 +1158,7 @@ sfs_reclaim(struct inode *node) {
             sfs_block_free(sfs, ent);
         }
     }
+    assert(sin->ndirty == 0);
     kfree(sin->din);
     vop_kill(node);
     return 0;
@@ -931,12 +1218,17 @@ sfs_truncfile(struct inode *node, off_t len) {
     int ret = 0;
 	//new number of disk blocks of file
     uint32_t nblks, tblks = ROUNDUP_DIV(len, SFS_BLKSIZE);
+
+    lock_sin(sin);
+    // dirty blocks past the new end are dropped, the rest are written back first
+    sfs_dirty_drop_nolock(sfs, sin, tblks);
+    if ((ret = sfs_dirty_flush_nolock(sfs, sin)) != 0) {
+        goto out_unlock;
+    }
     if (din->size == len) {
         assert(tblks == din->blocks);
-        return 0;
+        goto out_unlock;
     }
-
-    lock_sin(sin);
 	// old number of disk blocks of file
     nblks = din->blocks;
     if (nblks < tblks) {
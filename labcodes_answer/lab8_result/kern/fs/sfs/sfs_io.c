@@ -15,10 +15,38 @@
  * @blkno: the NO. of disk block
  * @write: BOOL: Read or Write
  * @check: BOOL: if check (blono < sfs super.blocks)
+ *
+ * NOTICE: blocks held by the journal or the block cache are read from memory, and
+ *         a direct write to a journaled block checkpoints the journal first.
  */
 static int
 sfs_rwblock_nolock(struct sfs_fs *sfs, void *buf, uint32_t blkno, bool write, bool check) {
     assert((blkno != 0 || !check) && blkno < sfs->super.blocks);
+    if (write) {
+        int ret;
+        if ((ret = sfs_journal_revoke_nolock(sfs, blkno)) != 0) {
+            return ret;
+        }
+    }
+    else if (sfs_journal_read_nolock(sfs, buf, blkno) || sfs_cache_read_nolock(sfs, buf, blkno)) {
+        return 0;
+    }
+    return sfs_rwblock_raw_nolock(sfs, buf, blkno, write);
+}
+
+/* sfs_rwblock_raw_nolock - Rd/Wr one disk block on the device, bypassing the journal,
+ *                          used by the journal and the block cache. no lock protect
+ * @sfs:   sfs_fs which will be process
+ * @buf:   the buffer uesed for Rd/Wr
+ * @blkno: the NO. of disk block
+ * @write: BOOL: Read or Write
+ */
+int
+sfs_rwblock_raw_nolock(struct sfs_fs *sfs, void *buf, uint32_t blkno, bool write) {
+    assert(blkno < sfs->super.blocks);
+    if (write) {
+        sfs_cache_update_nolock(sfs, buf, blkno);
+    }
     struct iobuf __iob, *iob = iobuf_init(&__iob, buf, SFS_BLKSIZE, blkno * SFS_BLKSIZE);
     return dop_io(sfs->dev, iob, write);
 }
@@ -72,6 +100,34 @@ sfs_wblock(struct sfs_fs *sfs, void *buf, uint32_t blkno, uint32_t nblks) {
     return sfs_rwblock(sfs, buf, blkno, nblks, 1);
 }
 
+/* sfs_wextent - Wr N contiguous disk blocks with one device request (used by write-back),
+ *               with lock protect for mutex process on Rd/Wr disk block
+ * @sfs:   sfs_fs which will be process
+ * @buf:   the buffer uesed for Wr
+ * @blkno: the NO. of the first disk block
+ * @nblks: Wr number of disk block
+ */
+int
+sfs_wextent(struct sfs_fs *sfs, void *buf, uint32_t blkno, uint32_t nblks) {
+    assert(blkno != 0 && blkno + nblks <= sfs->super.blocks);
+    int ret = 0;
+    lock_sfs_io(sfs);
+    {
+        uint32_t i;
+        for (i = 0; i < nblks; i ++) {
+            if ((ret = sfs_journal_revoke_nolock(sfs, blkno + i)) != 0) {
+                goto out;
+            }
+            sfs_cache_update_nolock(sfs, buf + i * SFS_BLKSIZE, blkno + i);
+        }
+        struct iobuf __iob, *iob = iobuf_init(&__iob, buf, nblks * SFS_BLKSIZE, blkno * SFS_BLKSIZE);
+        ret = dop_io(sfs->dev, iob, 1);
+    }
+out:
+    unlock_sfs_io(sfs);
+    return ret;
+}
+
 /* sfs_rbuf - The Basic block-level I/O routine for  Rd( non-block & non-aligned io) one disk block(using sfs->sfs_buffer)
  *            with lock protect for mutex process on Rd/Wr disk block
  * @sfs:    sfs_fs which will be process
@@ -119,9 +175,13 @@ sfs_wbuf(struct sfs_fs *sfs, void *buf, size_t len, uint32_t blkno, off_t offset
 
 /*
  * sfs_sync_super - write sfs->super (in memory) into disk (SFS_BLKN_SUPER, 1) with lock protect.
+ *                  If sfs has a journal, log it into the running transaction instead.
  */
 int
 sfs_sync_super(struct sfs_fs *sfs) {
+    if (sfs_journal_enabled(sfs)) {
+        return sfs_journal_write(sfs, &(sfs->super), sizeof(sfs->super), SFS_BLKN_SUPER, 0);
+    }
     int ret;
     lock_sfs_io(sfs);
     {
@@ -135,11 +195,23 @@ sfs_sync_super(struct sfs_fs *sfs) {
 
 /*
  * sfs_sync_freemap - write sfs bitmap into disk (SFS_BLKN_FREEMAP, nblks)  without lock protect.
+ *                    If sfs has a journal, log it into the running transaction instead.
  */
 int
 sfs_sync_freemap(struct sfs_fs *sfs) {
     uint32_t nblks = sfs_freemap_blocks(&(sfs->super));
-    return sfs_wblock(sfs, bitmap_getdata(sfs->freemap, NULL), SFS_BLKN_FREEMAP, nblks);
+    void *data = bitmap_getdata(sfs->freemap, NULL);
+    if (sfs_journal_enabled(sfs)) {
+        int ret;
+        uint32_t i;
+        for (i = 0; i < nblks; i ++, data += SFS_BLKSIZE) {
+            if ((ret = sfs_journal_write(sfs, data, SFS_BLKSIZE, SFS_BLKN_FREEMAP + i, 0)) != 0) {
+                return ret;
+            }
+        }
+        return 0;
+    }
+    return sfs_wblock(sfs, data, SFS_BLKN_FREEMAP, nblks);
 }
 
 /*
@@ -0,0 +1,398 @@
+#include <defs.h>
+#include <stdio.h>
+#include <string.h>
+#include <kmalloc.h>
+#include <dev.h>
+#include <sfs.h>
+#include <error.h>
+#include <assert.h>
+
+/*
+ * Write-ahead metadata journal for SFS.
+ *
+ * Metadata updates (inodes, indirect blocks, superblock and freemap) are copied
+ * into in-memory block images instead of being written in place. A commit appends
+ * all blocks modified since the previous commit to the circular log as one
+ * transaction
+ *
+ *      descriptor | block image ... | commit block
+ *
+ * so every fsync caller that arrives before the commit shares one sequential
+ * write (group commit). The images stay in memory, where reads find them, until
+ * a checkpoint writes them to their home locations and advances the header.
+ * After a crash, sfs_journal_replay redoes every transaction whose commit block
+ * made it to disk.
+ *
+ * All functions run under sfs->io_sem, which serializes them with block I/O.
+ */
+
+/* sfs_journal_blkno - the disk block of log offset */
+static inline uint32_t
+sfs_journal_blkno(struct sfs_journal *j, uint32_t offset) {
+    return j->start + offset % j->size;
+}
+
+/* sfs_journal_checksum - fold one block image into the transaction checksum */
+static uint32_t
+sfs_journal_checksum(uint32_t sum, const void *data) {
+    const uint32_t *p = data;
+    int i;
+    for (i = 0; i < SFS_BLK_NENTRY; i ++) {
+        sum = ((sum << 1) | (sum >> 31)) ^ p[i];
+    }
+    return sum;
+}
+
+/* sfs_journal_lookup - find the buf holding disk block blkno */
+static struct sfs_jbuf *
+sfs_journal_lookup(struct sfs_journal *j, uint32_t blkno) {
+    int i;
+    for (i = 0; i < j->nbuf; i ++) {
+        if (j->bufs[i].blkno == blkno) {
+            return j->bufs + i;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * sfs_journal_write_header_nolock - record where replay has to start
+ */
+static int
+sfs_journal_write_header_nolock(struct sfs_fs *sfs, uint32_t sequence, uint32_t start) {
+    struct sfs_journal *j = &(sfs->journal);
+    struct sfs_journal_header *header = j->scratch;
+    memset(header, 0, SFS_BLKSIZE);
+    header->magic = SFS_JOURNAL_MAGIC;
+    header->sequence = sequence, header->start = start;
+    return sfs_rwblock_raw_nolock(sfs, header, j->start - 1, 1);
+}
+
+/*
+ * sfs_journal_commit_nolock - append the running transaction to the log
+ *
+ * The caller keeps j->used + SFS_JOURNAL_NBUF + 2 <= j->size, so a transaction
+ * always fits without overwriting blocks that are not checkpointed yet.
+ */
+static int
+sfs_journal_commit_nolock(struct sfs_fs *sfs) {
+    struct sfs_journal *j = &(sfs->journal);
+    if (j->nrunning == 0) {
+        return 0;
+    }
+    assert(j->used + j->nrunning + 2 <= j->size);
+
+    int ret, i, n = 0;
+    uint32_t offset = j->head, checksum = j->sequence;
+    struct sfs_journal_desc *desc = j->scratch;
+    memset(desc, 0, SFS_BLKSIZE);
+    desc->magic = SFS_JOURNAL_MAGIC;
+    desc->sequence = j->sequence, desc->nblks = j->nrunning;
+    for (i = 0; i < j->nbuf; i ++) {
+        if (j->bufs[i].running) {
+            desc->blkno[n ++] = j->bufs[i].blkno;
+        }
+    }
+    assert(n == j->nrunning);
+    if ((ret = sfs_rwblock_raw_nolock(sfs, desc, sfs_journal_blkno(j, offset ++), 1)) != 0) {
+        return ret;
+    }
+
+    for (i = 0; i < j->nbuf; i ++) {
+        struct sfs_jbuf *jb = j->bufs + i;
+        if (jb->running) {
+            if ((ret = sfs_rwblock_raw_nolock(sfs, jb->data, sfs_journal_blkno(j, offset ++), 1)) != 0) {
+                return ret;
+            }
+            checksum = sfs_journal_checksum(checksum, jb->data);
+        }
+    }
+
+    struct sfs_journal_commit *commit = j->scratch;
+    memset(commit, 0, SFS_BLKSIZE);
+    commit->magic = SFS_JOURNAL_MAGIC;
+    commit->sequence = j->sequence, commit->nblks = n, commit->checksum = checksum;
+    if ((ret = sfs_rwblock_raw_nolock(sfs, commit, sfs_journal_blkno(j, offset ++), 1)) != 0) {
+        return ret;
+    }
+
+    for (i = 0; i < j->nbuf; i ++) {
+        j->bufs[i].running = 0;
+    }
+    j->nrunning = 0, j->sequence ++;
+    j->head = offset % j->size, j->used += n + 2;
+    return 0;
+}
+
+/*
+ * sfs_journal_checkpoint_nolock - commit, write every held block to its home
+ *                                 location and empty the log
+ */
+static int
+sfs_journal_checkpoint_nolock(struct sfs_fs *sfs) {
+    struct sfs_journal *j = &(sfs->journal);
+    int ret, i, k;
+    if ((ret = sfs_journal_commit_nolock(sfs)) != 0) {
+        return ret;
+    }
+    if (j->nbuf == 0) {
+        return 0;
+    }
+
+    // sort by home location, so the write-back sweeps the disk once
+    for (i = 1; i < j->nbuf; i ++) {
+        struct sfs_jbuf tmp = j->bufs[i];
+        for (k = i; k > 0 && j->bufs[k - 1].blkno > tmp.blkno; k --) {
+            j->bufs[k] = j->bufs[k - 1];
+        }
+        j->bufs[k] = tmp;
+    }
+    for (i = 0; i < j->nbuf; i ++) {
+        if ((ret = sfs_rwblock_raw_nolock(sfs, j->bufs[i].data, j->bufs[i].blkno, 1)) != 0) {
+            return ret;
+        }
+    }
+    if ((ret = sfs_journal_write_header_nolock(sfs, j->sequence, j->head)) != 0) {
+        return ret;
+    }
+    j->nbuf = 0, j->used = 0;
+    return 0;
+}
+
+/*
+ * sfs_journal_init - set up the in-memory journal of sfs, called in sfs_do_mount
+ *                    after sfs->super is loaded. A volume without a journal region
+ *                    keeps writing metadata in place.
+ */
+int
+sfs_journal_init(struct sfs_fs *sfs) {
+    struct sfs_journal *j = &(sfs->journal);
+    struct sfs_super *super = &(sfs->super);
+    memset(j, 0, sizeof(struct sfs_journal));
+    if (super->journal == 0) {
+        return 0;
+    }
+    if (super->journal_blocks < SFS_JOURNAL_NBUF + 3 || super->journal + super->journal_blocks > super->blocks) {
+        cprintf("sfs: bad journal region (%u, %u).\n", super->journal, super->journal_blocks);
+        return -E_INVAL;
+    }
+
+    void *buffer, *scratch;
+    if ((buffer = kmalloc(SFS_JOURNAL_NBUF * SFS_BLKSIZE)) == NULL) {
+        return -E_NO_MEM;
+    }
+    if ((scratch = kmalloc(SFS_BLKSIZE)) == NULL) {
+        kfree(buffer);
+        return -E_NO_MEM;
+    }
+
+    int i;
+    for (i = 0; i < SFS_JOURNAL_NBUF; i ++) {
+        j->bufs[i].data = buffer + i * SFS_BLKSIZE;
+    }
+    j->buffer = buffer, j->scratch = scratch;
+    j->start = super->journal + 1, j->size = super->journal_blocks - 1;
+    j->sequence = 1;
+    return 0;
+}
+
+/*
+ * sfs_journal_destroy - free the in-memory journal, it must be checkpointed
+ */
+void
+sfs_journal_destroy(struct sfs_fs *sfs) {
+    struct sfs_journal *j = &(sfs->journal);
+    if (sfs_journal_enabled(sfs)) {
+        assert(j->nbuf == 0);
+        kfree(j->buffer);
+        kfree(j->scratch);
+        j->start = 0;
+    }
+}
+
+/*
+ * sfs_journal_replay - redo the committed transactions found in the log, called in
+ *                      sfs_do_mount before the freemap is loaded.
+ *
+ *      (1) read the header to find the 1st transaction to replay
+ *      (2) for each descriptor with the expected sequence, verify its commit block
+ *          and checksum, then copy its images to their home locations
+ *      (3) stop at the 1st missing or torn transaction and reset the header
+ */
+int
+sfs_journal_replay(struct sfs_fs *sfs) {
+    struct sfs_journal *j = &(sfs->journal);
+    if (!sfs_journal_enabled(sfs)) {
+        return 0;
+    }
+
+    int ret;
+    struct sfs_journal_header *header = j->scratch;
+    if ((ret = sfs_rwblock_raw_nolock(sfs, header, j->start - 1, 0)) != 0) {
+        return ret;
+    }
+    if (header->magic != SFS_JOURNAL_MAGIC || header->start >= j->size) {
+        cprintf("sfs: wrong journal header (%08x should be %08x).\n",
+                header->magic, SFS_JOURNAL_MAGIC);
+        return -E_INVAL;
+    }
+
+    uint32_t sequence = header->sequence, offset = header->start, scanned = 0;
+    uint32_t i, n, checksum, count = 0;
+    struct sfs_journal_desc *desc = j->scratch;
+    struct sfs_journal_commit *commit = sfs->sfs_buffer;
+    while (scanned < j->size) {
+        if ((ret = sfs_rwblock_raw_nolock(sfs, desc, sfs_journal_blkno(j, offset), 0)) != 0) {
+            return ret;
+        }
+        if (desc->magic != SFS_JOURNAL_MAGIC || desc->sequence != sequence
+                || desc->nblks == 0 || desc->nblks > SFS_JOURNAL_NBUF
+                || scanned + desc->nblks + 2 > j->size) {
+            break;
+        }
+        n = desc->nblks, checksum = sequence;
+        for (i = 0; i < n; i ++) {
+            if ((ret = sfs_rwblock_raw_nolock(sfs, sfs->sfs_buffer, sfs_journal_blkno(j, offset + 1 + i), 0)) != 0) {
+                return ret;
+            }
+            checksum = sfs_journal_checksum(checksum, sfs->sfs_buffer);
+        }
+        if ((ret = sfs_rwblock_raw_nolock(sfs, commit, sfs_journal_blkno(j, offset + 1 + n), 0)) != 0) {
+            return ret;
+        }
+        if (commit->magic != SFS_JOURNAL_MAGIC || commit->sequence != sequence
+                || commit->nblks != n || commit->checksum != checksum) {
+            break;
+        }
+        for (i = 0; i < n; i ++) {
+            if (desc->blkno[i] >= sfs->super.blocks) {
+                cprintf("sfs: journal block out of range %u.\n", desc->blkno[i]);
+                return -E_INVAL;
+            }
+            if ((ret = sfs_rwblock_raw_nolock(sfs, sfs->sfs_buffer, sfs_journal_blkno(j, offset + 1 + i), 0)) != 0) {
+                return ret;
+            }
+            if ((ret = sfs_rwblock_raw_nolock(sfs, sfs->sfs_buffer, desc->blkno[i], 1)) != 0) {
+                return ret;
+            }
+        }
+        offset = (offset + n + 2) % j->size, scanned += n + 2;
+        sequence ++, count ++;
+    }
+
+    j->sequence = sequence, j->head = offset, j->used = 0;
+    if (count != 0) {
+        if ((ret = sfs_journal_write_header_nolock(sfs, sequence, offset)) != 0) {
+            return ret;
+        }
+        cprintf("sfs: journal: replayed %u transactions.\n", count);
+    }
+    return 0;
+}
+
+/*
+ * sfs_journal_write - log a metadata update of (blkno, offset, len) into the running
+ *                     transaction. Without a journal, write it in place.
+ * @sfs:    sfs_fs which will be process
+ * @buf:    the new content
+ * @len:    the length of the new content
+ * @blkno:  the NO. of disk block
+ * @offset: the offset in the content of disk block
+ */
+int
+sfs_journal_write(struct sfs_fs *sfs, void *buf, size_t len, uint32_t blkno, off_t offset) {
+    assert(offset >= 0 && offset < SFS_BLKSIZE && offset + len <= SFS_BLKSIZE);
+    if (!sfs_journal_enabled(sfs)) {
+        return sfs_wbuf(sfs, buf, len, blkno, offset);
+    }
+    assert(blkno < sfs->super.blocks);
+
+    struct sfs_journal *j = &(sfs->journal);
+    struct sfs_jbuf *jb;
+    int ret = 0;
+    lock_sfs_io(sfs);
+    if ((jb = sfs_journal_lookup(j, blkno)) == NULL) {
+        // all bufs are taken: commit and checkpoint to free them
+        if (j->nbuf == SFS_JOURNAL_NBUF && (ret = sfs_journal_checkpoint_nolock(sfs)) != 0) {
+            goto out_unlock;
+        }
+        jb = j->bufs + j->nbuf;
+        if (len != SFS_BLKSIZE && (ret = sfs_rwblock_raw_nolock(sfs, jb->data, blkno, 0)) != 0) {
+            goto out_unlock;
+        }
+        jb->blkno = blkno, jb->running = 0;
+        j->nbuf ++;
+    }
+    memcpy(jb->data + offset, buf, len);
+    if (!jb->running) {
+        jb->running = 1, j->nrunning ++;
+    }
+
+out_unlock:
+    unlock_sfs_io(sfs);
+    return ret;
+}
+
+/*
+ * sfs_journal_commit - make the running transaction durable. Updates logged by other
+ *                      processes since the last commit go out in the same write.
+ */
+int
+sfs_journal_commit(struct sfs_fs *sfs) {
+    if (!sfs_journal_enabled(sfs)) {
+        return 0;
+    }
+    struct sfs_journal *j = &(sfs->journal);
+    int ret;
+    lock_sfs_io(sfs);
+    if ((ret = sfs_journal_commit_nolock(sfs)) == 0) {
+        // no room for a full transaction in the log any more
+        if (j->used + SFS_JOURNAL_NBUF + 2 > j->size) {
+            ret = sfs_journal_checkpoint_nolock(sfs);
+        }
+    }
+    unlock_sfs_io(sfs);
+    return ret;
+}
+
+/*
+ * sfs_journal_checkpoint - commit and write all journaled blocks home, used by sfs_sync
+ */
+int
+sfs_journal_checkpoint(struct sfs_fs *sfs) {
+    if (!sfs_journal_enabled(sfs)) {
+        return 0;
+    }
+    int ret;
+    lock_sfs_io(sfs);
+    ret = sfs_journal_checkpoint_nolock(sfs);
+    unlock_sfs_io(sfs);
+    return ret;
+}
+
+/*
+ * sfs_journal_read_nolock - if blkno is held by the journal, copy its newest image
+ *                           into buf and return 1
+ */
+bool
+sfs_journal_read_nolock(struct sfs_fs *sfs, void *buf, uint32_t blkno) {
+    struct sfs_jbuf *jb;
+    if ((jb = sfs_journal_lookup(&(sfs->journal), blkno)) != NULL) {
+        memcpy(buf, jb->data, SFS_BLKSIZE);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * sfs_journal_revoke_nolock - blkno is about to be written in place (e.g. a freed
+ *                             metadata block reused for data). Checkpoint first, so
+ *                             neither a later checkpoint nor replay overwrites it.
+ */
+int
+sfs_journal_revoke_nolock(struct sfs_fs *sfs, uint32_t blkno) {
+    if (sfs_journal_lookup(&(sfs->journal), blkno) != NULL) {
+        return sfs_journal_checkpoint_nolock(sfs);
+    }
+    return 0;
+}
@@ -1,16 +1,28 @@
 #include <defs.h>
 #include <sem.h>
+#include <rwsem.h>
 #include <sfs.h>
 
 
 /*
  * lock_sfs_fs - lock the process of  SFS Filesystem Rd/Wr Disk Block
  *
- * called by: sfs_load_inode, sfs_sync, sfs_reclaim
+ * called by: sfs_load_inode, sfs_reclaim
  */
 void
 lock_sfs_fs(struct sfs_fs *sfs) {
-    down(&(sfs->fs_sem));
+    down_write(&(sfs->fs_sem));
+}
+
+/*
+ * lock_sfs_fs_shared - lock the inode list of SFS Filesystem for reading, lookups
+ *                      of loaded inodes and sync run in parallel
+ *
+ * called by: sfs_load_inode, sfs_sync
+ */
+void
+lock_sfs_fs_shared(struct sfs_fs *sfs) {
+    down_read(&(sfs->fs_sem));
 }
 
 /*
@@ -26,11 +38,21 @@ lock_sfs_io(struct sfs_fs *sfs) {
 /*
  * unlock_sfs_fs - unlock the process of  SFS Filesystem Rd/Wr Disk Block
  *
- * called by: sfs_load_inode, sfs_sync, sfs_reclaim
+ * called by: sfs_load_inode, sfs_reclaim
  */
 void
 unlock_sfs_fs(struct sfs_fs *sfs) {
-    up(&(sfs->fs_sem));
+    up_write(&(sfs->fs_sem));
+}
+
+/*
+ * unlock_sfs_fs_shared - unlock the inode list of SFS Filesystem for reading
+ *
+ * called by: sfs_load_inode, sfs_sync
+ */
+void
+unlock_sfs_fs_shared(struct sfs_fs *sfs) {
+    up_read(&(sfs->fs_sem));
 }
 
 /*
@@ -0,0 +1,119 @@
+#include <defs.h>
+#include <string.h>
+#include <stdio.h>
+#include <wait.h>
+#include <sync.h>
+#include <proc.h>
+#include <sched.h>
+#include <sfs.h>
+#include <assert.h>
+
+/*
+ * Asynchronous readahead for SFS.
+ *
+ * sfs_read detects sequential access and hands the disk blocks of the next
+ * readahead window to sfs_readahead. The requests are queued here and the
+ * "sfs_readahead" kernel daemon reads them into the block cache, so the reader
+ * finds them in memory instead of waiting for the disk.
+ */
+
+#define SFS_RA_NREQ                 8           /* # of queued readahead requests */
+
+struct sfs_ra_req {
+    struct sfs_fs *sfs;
+    uint32_t nblks;
+    uint32_t blknos[SFS_RA_MAX];
+};
+
+static struct sfs_ra_req ra_queue[SFS_RA_NREQ];
+static int ra_head, ra_count;
+static wait_queue_t ra_wait_queue;
+static int ra_pid = 0;
+
+/*
+ * sfs_readahead - queue disk blocks blknos[0..nblks) for the readahead daemon.
+ *                 Readahead is only a hint: if the queue is full the request is dropped.
+ */
+void
+sfs_readahead(struct sfs_fs *sfs, uint32_t *blknos, uint32_t nblks) {
+    assert(nblks <= SFS_RA_MAX);
+    if (ra_pid <= 0 || nblks == 0) {
+        return;
+    }
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if (ra_count < SFS_RA_NREQ) {
+            struct sfs_ra_req *req = ra_queue + (ra_head + ra_count) % SFS_RA_NREQ;
+            req->sfs = sfs, req->nblks = nblks;
+            memcpy(req->blknos, blknos, nblks * sizeof(uint32_t));
+            ra_count ++;
+            wakeup_queue(&ra_wait_queue, WT_DAEMON, 1);
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+/*
+ * sfs_readahead_daemon - read queued blocks into the block cache until killed
+ */
+static int
+sfs_readahead_daemon(void *arg) {
+    struct sfs_ra_req req;
+    bool intr_flag;
+    while (!(current->flags & PF_EXITING)) {
+        local_intr_save(intr_flag);
+        if (ra_count == 0) {
+            wait_t __wait, *wait = &__wait;
+            wait_current_set(&ra_wait_queue, wait, WT_DAEMON);
+            local_intr_restore(intr_flag);
+
+            schedule();
+
+            local_intr_save(intr_flag);
+            wait_current_del(&ra_wait_queue, wait);
+            local_intr_restore(intr_flag);
+            continue;
+        }
+        req = ra_queue[ra_head];
+        ra_head = (ra_head + 1) % SFS_RA_NREQ, ra_count --;
+        local_intr_restore(intr_flag);
+
+        uint32_t i;
+        for (i = 0; i < req.nblks; i ++) {
+            int ret;
+            lock_sfs_io(req.sfs);
+            ret = sfs_cache_fill_nolock(req.sfs, req.blknos[i]);
+            unlock_sfs_io(req.sfs);
+            if (ret != 0) {
+                warn("sfs: readahead block %u failed: %e.\n", req.blknos[i], ret);
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * sfs_readahead_init - start the readahead daemon
+ */
+void
+sfs_readahead_init(void) {
+    wait_queue_init(&ra_wait_queue);
+    ra_head = ra_count = 0;
+    if ((ra_pid = kernel_daemon(sfs_readahead_daemon, NULL, "sfs_readahead")) <= 0) {
+        warn("sfs: start readahead daemon failed: %e.\n", ra_pid);
+    }
+}
+
+/*
+ * sfs_readahead_cleanup - stop the readahead daemon, pending requests are dropped
+ */
+void
+sfs_readahead_cleanup(void) {
+    if (ra_pid > 0) {
+        int pid = ra_pid;
+        ra_pid = 0;
+        kernel_daemon_stop(pid);
+    }
+}
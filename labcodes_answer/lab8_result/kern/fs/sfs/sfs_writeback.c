@@ -0,0 +1,161 @@
+#include <defs.h>
+#include <stdio.h>
+#include <list.h>
+#include <kmalloc.h>
+#include <wait.h>
+#include <sync.h>
+#include <proc.h>
+#include <sched.h>
+#include <vfs.h>
+#include <sfs.h>
+#include <error.h>
+#include <assert.h>
+
+/*
+ * Write-back of file data for SFS.
+ *
+ * sfs_write copies data into dirty blocks taken from a fixed pool and linked to
+ * the inode; no disk block is allocated until the inode is flushed (fsync, close,
+ * reclaim, truncate, or the periodic "sfs_flusher" daemon). Flushing allocates
+ * the disk blocks in file order and writes runs of contiguous blocks with one
+ * request, see sfs_dirty_flush_nolock in sfs_inode.c.
+ */
+
+static wait_queue_t wb_wait_queue;
+static timer_t wb_timer;
+static int wb_pid = 0;
+
+/*
+ * sfs_wb_init - allocate the write-back buffers of sfs, called in sfs_do_mount
+ */
+int
+sfs_wb_init(struct sfs_fs *sfs) {
+    struct sfs_wb *wb = &(sfs->wb);
+    void *buffer, *chunk;
+    if ((buffer = kmalloc(SFS_WB_NBUF * SFS_BLKSIZE)) == NULL) {
+        return -E_NO_MEM;
+    }
+    if ((chunk = kmalloc(SFS_WB_CHUNK * SFS_BLKSIZE)) == NULL) {
+        kfree(buffer);
+        return -E_NO_MEM;
+    }
+    wb->buffer = buffer, wb->chunk = chunk;
+    sem_init(&(wb->chunk_sem), 1);
+    list_init(&(wb->free_list));
+    int i;
+    for (i = 0; i < SFS_WB_NBUF; i ++) {
+        struct sfs_dblock *db = wb->blocks + i;
+        db->data = buffer + i * SFS_BLKSIZE;
+        list_add(&(wb->free_list), &(db->dirty_link));
+    }
+    wb->nfree = SFS_WB_NBUF;
+    return 0;
+}
+
+/*
+ * sfs_wb_destroy - free the write-back buffers of sfs, all of them must be clean
+ */
+void
+sfs_wb_destroy(struct sfs_fs *sfs) {
+    struct sfs_wb *wb = &(sfs->wb);
+    assert(wb->nfree == SFS_WB_NBUF);
+    kfree(wb->buffer);
+    kfree(wb->chunk);
+}
+
+/*
+ * sfs_dblock_alloc - get a free dirty block, NULL if the pool is used up.
+ *                    Wake the flusher once a quarter of the pool is left.
+ */
+struct sfs_dblock *
+sfs_dblock_alloc(struct sfs_fs *sfs) {
+    struct sfs_wb *wb = &(sfs->wb);
+    struct sfs_dblock *db = NULL;
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if (!list_empty(&(wb->free_list))) {
+            list_entry_t *le = list_next(&(wb->free_list));
+            list_del(le);
+            db = le2dblock(le, dirty_link);
+            wb->nfree --;
+        }
+        if (wb->nfree < SFS_WB_NBUF / 4 && !wait_queue_empty(&wb_wait_queue)) {
+            del_timer(&wb_timer);
+            wakeup_queue(&wb_wait_queue, WT_DAEMON, 1);
+        }
+    }
+    local_intr_restore(intr_flag);
+    return db;
+}
+
+/*
+ * sfs_dblock_free - give a written back (or discarded) dirty block back to the pool
+ */
+void
+sfs_dblock_free(struct sfs_fs *sfs, struct sfs_dblock *db) {
+    struct sfs_wb *wb = &(sfs->wb);
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        list_add(&(wb->free_list), &(db->dirty_link));
+        wb->nfree ++;
+    }
+    local_intr_restore(intr_flag);
+}
+
+/*
+ * sfs_flusher_daemon - sync all fs every SFS_WB_INTERVAL ticks, or sooner when the
+ *                      write-back buffers run low, until killed
+ */
+static int
+sfs_flusher_daemon(void *arg) {
+    bool intr_flag;
+    while (1) {
+        wait_t __wait, *wait = &__wait;
+        local_intr_save(intr_flag);
+        wait_current_set(&wb_wait_queue, wait, WT_DAEMON);
+        add_timer(timer_init(&wb_timer, current, SFS_WB_INTERVAL));
+        local_intr_restore(intr_flag);
+
+        schedule();
+
+        local_intr_save(intr_flag);
+        del_timer(&wb_timer);
+        wait_current_del(&wb_wait_queue, wait);
+        local_intr_restore(intr_flag);
+
+        if (current->flags & PF_EXITING) {
+            break;
+        }
+        int ret;
+        if ((ret = vfs_sync()) != 0) {
+            warn("sfs: write-back failed: %e.\n", ret);
+        }
+    }
+    return 0;
+}
+
+/*
+ * sfs_writeback_init - start the flusher daemon
+ */
+void
+sfs_writeback_init(void) {
+    wait_queue_init(&wb_wait_queue);
+    list_init(&(wb_timer.timer_link));
+    if ((wb_pid = kernel_daemon(sfs_flusher_daemon, NULL, "sfs_flusher")) <= 0) {
+        warn("sfs: start flusher daemon failed: %e.\n", wb_pid);
+    }
+}
+
+/*
+ * sfs_writeback_cleanup - stop the flusher daemon, fs_cleanup syncs what is left
+ */
+void
+sfs_writeback_cleanup(void) {
+    if (wb_pid > 0) {
+        int pid = wb_pid;
+        wb_pid = 0;
+        kernel_daemon_stop(pid);
+    }
+}
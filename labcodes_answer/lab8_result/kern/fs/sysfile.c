@@ -9,6 +9,7 @@
 #include <sysfile.h>
 #include <stat.h>
 #include <dirent.h>
+#include <uio.h>
 #include <unistd.h>
 #include <error.h>
 #include <assert.h>
@@ -23,12 +24,12 @@ copy_path(char **to, const char *from) {
     if ((buffer = kmalloc(FS_MAX_FPATH_LEN + 1)) == NULL) {
         return -E_NO_MEM;
     }
-    lock_mm(mm);
+    lock_mm_shared(mm);
     if (!copy_string(mm, buffer, from, FS_MAX_FPATH_LEN + 1)) {
-        unlock_mm(mm);
+        unlock_mm_shared(mm);
         goto failed_cleanup;
     }
-    unlock_mm(mm);
+    unlock_mm_shared(mm);
     *to = buffer;
     return 0;
 
@@ -56,6 +57,19 @@ sysfile_close(int fd) {
     return file_close(fd);
 }
 
+/* sysfile_pipe_io - read/write a pipe, the data goes straight between user memory
+ *                   and the pipe buffer instead of through a kernel bounce buffer
+ */
+static int
+sysfile_pipe_io(int fd, void *base, size_t len, bool write) {
+    size_t copied;
+    int ret = file_pipe_io(fd, base, len, write, &copied);
+    if (copied != 0) {
+        return copied;
+    }
+    return ret;
+}
+
 /* sysfile_read - read file */
 int
 sysfile_read(int fd, void *base, size_t len) {
@@ -66,6 +80,9 @@ sysfile_read(int fd, void *base, size_t len) {
     if (!file_testfd(fd, 1, 0)) {
         return -E_INVAL;
     }
+    if (file_ispipe(fd)) {
+        return sysfile_pipe_io(fd, base, len, 0);
+    }
     void *buffer;
     if ((buffer = kmalloc(IOBUF_SIZE)) == NULL) {
         return -E_NO_MEM;
@@ -79,7 +96,7 @@ sysfile_read(int fd, void *base, size_t len) {
         }
         ret = file_read(fd, buffer, alen, &alen);
         if (alen != 0) {
-            lock_mm(mm);
+            lock_mm_shared(mm);
             {
                 if (copy_to_user(mm, base, buffer, alen)) {
                     assert(len >= alen);
@@ -89,7 +106,7 @@ sysfile_read(int fd, void *base, size_t len) {
                     ret = -E_INVAL;
                 }
             }
-            unlock_mm(mm);
+            unlock_mm_shared(mm);
         }
         if (ret != 0 || alen == 0) {
             goto out;
@@ -114,6 +131,9 @@ sysfile_write(int fd, void *base, size_t len) {
     if (!file_testfd(fd, 0, 1)) {
         return -E_INVAL;
     }
+    if (file_ispipe(fd)) {
+        return sysfile_pipe_io(fd, base, len, 1);
+    }
     void *buffer;
     if ((buffer = kmalloc(IOBUF_SIZE)) == NULL) {
         return -E_NO_MEM;
@@ -125,13 +145,13 @@ sysfile_write(int fd, void *base, size_t len) {
         if ((alen = IOBUF_SIZE) > len) {
             alen = len;
         }
-        lock_mm(mm);
+        lock_mm_shared(mm);
         {
             if (!copy_from_user(mm, buffer, base, alen, 0)) {
                 ret = -E_INVAL;
             }
         }
-        unlock_mm(mm);
+        unlock_mm_shared(mm);
         if (ret == 0) {
             ret = file_write(fd, buffer, alen, &alen);
             if (alen != 0) {
@@ -152,6 +172,121 @@ out:
     return ret;
 }
 
+/* sysfile_iov_check - check the segments of a readv (write to user memory) or writev */
+static bool
+sysfile_iov_check(struct mm_struct *mm, struct iovec *iov, int iovcnt, bool write) {
+    int i;
+    for (i = 0; i < iovcnt; i ++) {
+        if (!user_mem_check(mm, (uintptr_t)iov[i].iov_base, iov[i].iov_len, write)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* sysfile_iov_io - read file into (write file from) the iovcnt user segments in iov.
+ *                  The data goes through one bounce buffer, which is scattered to
+ *                  (gathered from) the segments by an iobuf over all of them.
+ */
+static int
+sysfile_iov_io(int fd, const struct iovec *__iov, int iovcnt, bool write) {
+    struct mm_struct *mm = current->mm;
+    if (iovcnt <= 0 || iovcnt > UIO_MAXIOV) {
+        return -E_INVAL;
+    }
+    if (!file_testfd(fd, !write, write)) {
+        return -E_INVAL;
+    }
+
+    struct iovec iov[UIO_MAXIOV];
+    bool ok;
+    lock_mm_shared(mm);
+    {
+        ok = copy_from_user(mm, iov, __iov, sizeof(struct iovec) * iovcnt, 0)
+            && sysfile_iov_check(mm, iov, iovcnt, !write);
+    }
+    unlock_mm_shared(mm);
+    if (!ok) {
+        return -E_INVAL;
+    }
+
+    struct iobuf __uiob, *uiob = iobuf_init_iov(&__uiob, iov, iovcnt, 0);
+    if (uiob->io_resid == 0) {
+        return 0;
+    }
+
+    void *buffer;
+    if ((buffer = kmalloc(IOBUF_SIZE)) == NULL) {
+        return -E_NO_MEM;
+    }
+
+    // a read from a pipe returns what is there, instead of waiting to fill all segments
+    bool once = (!write && file_ispipe(fd));
+
+    int ret = 0;
+    size_t copied = 0, len, alen;
+    while (uiob->io_resid != 0) {
+        if ((len = IOBUF_SIZE) > uiob->io_resid) {
+            len = uiob->io_resid;
+        }
+        if (write) {
+            lock_mm_shared(mm);
+            {
+                if (sysfile_iov_check(mm, iov, iovcnt, 0)) {
+                    iobuf_move(uiob, buffer, len, 0, NULL);
+                }
+                else {
+                    ret = -E_INVAL;
+                }
+            }
+            unlock_mm_shared(mm);
+            if (ret != 0) {
+                goto out;
+            }
+            ret = file_write(fd, buffer, len, &alen);
+            copied += alen;
+        }
+        else {
+            ret = file_read(fd, buffer, len, &alen);
+            if (alen != 0) {
+                lock_mm_shared(mm);
+                {
+                    if (sysfile_iov_check(mm, iov, iovcnt, 1)) {
+                        iobuf_move(uiob, buffer, alen, 1, NULL);
+                        copied += alen;
+                    }
+                    else if (ret == 0) {
+                        ret = -E_INVAL;
+                    }
+                }
+                unlock_mm_shared(mm);
+            }
+        }
+        if (ret != 0 || alen < len || once) {
+            goto out;
+        }
+    }
+
+out:
+    kfree(buffer);
+    if (copied != 0) {
+        return copied;
+    }
+    return ret;
+}
+
+/* sysfile_readv - read file into several user buffers */
+int
+sysfile_readv(int fd, const struct iovec *iov, int iovcnt) {
+    return sysfile_iov_io(fd, iov, iovcnt, 0);
+}
+
+/* sysfile_writev - write file from several user buffers */
+int
+sysfile_writev(int fd, const struct iovec *iov, int iovcnt) {
+    return sysfile_iov_io(fd, iov, iovcnt, 1);
+}
+
 /* sysfile_seek - seek file */
 int
 sysfile_seek(int fd, off_t pos, int whence) {
@@ -168,13 +303,13 @@ sysfile_fstat(int fd, struct stat *__stat) {
         return ret;
     }
 
-    lock_mm(mm);
+    lock_mm_shared(mm);
     {
         if (!copy_to_user(mm, __stat, stat, sizeof(struct stat))) {
             ret = -E_INVAL;
         }
     }
-    unlock_mm(mm);
+    unlock_mm_shared(mm);
     return ret;
 }
 
@@ -253,14 +388,14 @@ sysfile_getcwd(char *buf, size_t len) {
     }
 
     int ret = -E_INVAL;
-    lock_mm(mm);
+    lock_mm_shared(mm);
     {
         if (user_mem_check(mm, (uintptr_t)buf, len, 1)) {
             struct iobuf __iob, *iob = iobuf_init(&__iob, buf, len, 0);
             ret = vfs_getcwd(iob);
         }
     }
-    unlock_mm(mm);
+    unlock_mm_shared(mm);
     return ret;
 }
 
@@ -274,25 +409,25 @@ sysfile_getdirentry(int fd, struct dirent *__direntp) {
     }
 
     int ret = 0;
-    lock_mm(mm);
+    lock_mm_shared(mm);
     {
         if (!copy_from_user(mm, &(direntp->offset), &(__direntp->offset), sizeof(direntp->offset), 1)) {
             ret = -E_INVAL;
         }
     }
-    unlock_mm(mm);
+    unlock_mm_shared(mm);
 
     if (ret != 0 || (ret = file_getdirentry(fd, direntp)) != 0) {
         goto out;
     }
 
-    lock_mm(mm);
+    lock_mm_shared(mm);
     {
         if (!copy_to_user(mm, __direntp, direntp, sizeof(struct dirent))) {
             ret = -E_INVAL;
         }
     }
-    unlock_mm(mm);
+    unlock_mm_shared(mm);
 
 out:
     kfree(direntp);
@@ -305,13 +440,40 @@ sysfile_dup(int fd1, int fd2) {
     return file_dup(fd1, fd2);
 }
 
+/* sysfile_pipe - create a pipe, store its read and write end in fd_store[0], fd_store[1] */
 int
 sysfile_pipe(int *fd_store) {
-    return -E_UNIMP;
+    struct mm_struct *mm = current->mm;
+    int ret, fd[2];
+    if (!user_mem_check(mm, (uintptr_t)fd_store, sizeof(fd), 1)) {
+        return -E_INVAL;
+    }
+    if ((ret = file_pipe(fd)) != 0) {
+        return ret;
+    }
+    lock_mm_shared(mm);
+    {
+        if (!copy_to_user(mm, fd_store, fd, sizeof(fd))) {
+            ret = -E_INVAL;
+        }
+    }
+    unlock_mm_shared(mm);
+    if (ret != 0) {
+        file_close(fd[0]), file_close(fd[1]);
+    }
+    return ret;
 }
 
+/* sysfile_mkfifo - open an end of the named pipe __name, created if it does not exist */
 int
 sysfile_mkfifo(const char *__name, uint32_t open_flags) {
-    return -E_UNIMP;
+    int ret;
+    char *name;
+    if ((ret = copy_path(&name, __name)) != 0) {
+        return ret;
+    }
+    ret = file_mkfifo(name, open_flags);
+    kfree(name);
+    return ret;
 }
 
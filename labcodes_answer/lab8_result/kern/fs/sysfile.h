@@ -5,11 +5,14 @@
 
 struct stat;
 struct dirent;
+struct iovec;
 
 int sysfile_open(const char *path, uint32_t open_flags);        // Open or create a file. FLAGS/MODE per the syscall.
 int sysfile_close(int fd);                                      // Close a vnode opened  
 int sysfile_read(int fd, void *base, size_t len);               // Read file
 int sysfile_write(int fd, void *base, size_t len);              // Write file
+int sysfile_readv(int fd, const struct iovec *iov, int iovcnt); // Read file into several buffers
+int sysfile_writev(int fd, const struct iovec *iov, int iovcnt);// Write file from several buffers
 int sysfile_seek(int fd, off_t pos, int whence);                // Seek file  
 int sysfile_fstat(int fd, struct stat *stat);                   // Stat file 
 int sysfile_fsync(int fd);                                      // Sync file
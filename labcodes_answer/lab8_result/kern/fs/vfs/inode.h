@@ -4,6 +4,7 @@
 #include <defs.h>
 #include <dev.h>
 #include <sfs.h>
+#include <pipe.h>
 #include <atomic.h>
 #include <assert.h>
 
@@ -30,10 +31,12 @@ struct inode {
     union {
         struct device __device_info;
         struct sfs_inode __sfs_inode_info;
+        struct pipe_inode __pipe_inode_info;
     } in_info;
     enum {
         inode_type_device_info = 0x1234,
         inode_type_sfs_inode_info,
+        inode_type_pipe_inode_info,
     } in_type;
     int ref_count;
     int open_count;
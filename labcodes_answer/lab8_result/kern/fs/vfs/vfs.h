@@ -78,6 +78,7 @@ struct fs *__alloc_fs(int type);
  */
 void vfs_init(void);
 void vfs_cleanup(void);
+int vfs_sync(void);
 void vfs_devlist_init(void);
 
 /*
@@ -60,6 +60,29 @@ vfs_cleanup(void) {
     }
 }
 
+// vfs_sync - flush all dirty buffers of every mounted fs to disk
+int
+vfs_sync(void) {
+    int ret = 0;
+    if (!list_empty(&vdev_list)) {
+        lock_vdev_list();
+        {
+            list_entry_t *list = &vdev_list, *le = list;
+            while ((le = list_next(le)) != list) {
+                vfs_dev_t *vdev = le2vdev(le, vdev_link);
+                if (vdev->fs != NULL) {
+                    int err;
+                    if ((err = fsop_sync(vdev->fs)) != 0) {
+                        ret = err;
+                    }
+                }
+            }
+        }
+        unlock_vdev_list();
+    }
+    return ret;
+}
+
 /*
  * vfs_get_root - Given a device name (stdin, stdout, etc.), hand
  *                back an appropriate inode.
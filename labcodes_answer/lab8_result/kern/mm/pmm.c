@@ -11,6 +11,8 @@
 #include <swap.h>
 #include <vmm.h>
 #include <kmalloc.h>
+#include <sched.h>
+#include <zeropage.h>
 
 /* *
  * Task State Segment:
@@ -109,14 +111,42 @@ lgdt(struct pseudodesc *pd) {
     asm volatile ("ljmp %0, $1f\n 1:\n" :: "i" (KERNEL_CS));
 }
 
+// the cpu supports sysenter/sysexit, and it is set up
+bool sysenter_enabled = 0;
+
 /* *
  * load_esp0 - change the ESP0 in default task state segment,
  * so that we can use different kernel stack when we trap frame
- * user to kernel.
+ * user to kernel. sysenter uses the same kernel stack.
  * */
 void
 load_esp0(uintptr_t esp0) {
     ts.ts_esp0 = esp0;
+    if (sysenter_enabled) {
+        wrmsr(MSR_IA32_SYSENTER_ESP, esp0);
+    }
+}
+
+/* *
+ * sysenter_init - set up the sysenter/sysexit syscall path if the cpu has it.
+ * sysenter loads CS and SS from MSR_IA32_SYSENTER_CS (+8), sysexit the user CS
+ * and SS from it (+16, +24), which is just the order of the segments in gdt.
+ * */
+static void
+sysenter_init(void) {
+    extern char __sysenter[];
+    uint32_t eax, edx;
+    cpuid(1, &eax, NULL, NULL, &edx);
+    uint32_t family = (eax >> 8) & 0xF, model = (eax >> 4) & 0xF, stepping = eax & 0xF;
+    // early Pentium Pros report SEP without supporting it
+    if (!(edx & CPUID_FEAT_SEP) || (family == 6 && model < 3 && stepping < 3)) {
+        return;
+    }
+    static_assert(GD_KDATA == GD_KTEXT + 8 && GD_UTEXT == GD_KTEXT + 16 && GD_UDATA == GD_KTEXT + 24);
+    wrmsr(MSR_IA32_SYSENTER_CS, GD_KTEXT);
+    wrmsr(MSR_IA32_SYSENTER_ESP, ts.ts_esp0);
+    wrmsr(MSR_IA32_SYSENTER_EIP, (uintptr_t)__sysenter);
+    sysenter_enabled = 1;
 }
 
 /* gdt_init - initialize the default GDT and TSS */
@@ -134,6 +164,8 @@ gdt_init(void) {
 
     // load the TSS
     ltr(GD_TSS);
+
+    sysenter_init();
 }
 
 //init_pmm_manager - initialize a pmm_manager instance
@@ -150,6 +182,83 @@ init_memmap(struct Page *base, size_t n) {
     pmm_manager->init_memmap(base, n);
 }
 
+/* *
+ * Deferred memmap initialization.
+ *
+ * page_init gives only the first PMM_EAGER_NPAGE free pages to the pmm_manager;
+ * the struct Pages of the rest of free memory are not touched at boot, they are
+ * kept in defer_ranges. After pmm_defer_start (called by init_main, once the boot
+ * time self checks are over) they are initialized and given to the pmm_manager
+ * PMM_DEFER_CHUNK pages at a time: by alloc_pages when it runs out of pages, and
+ * by the pmm_initd kernel thread in the background.
+ * */
+#define PMM_EAGER_NPAGE             8192                    // 32M
+#define PMM_DEFER_CHUNK             4096                    // 16M
+
+static struct defer_range {
+    size_t begin, end;                                      // page numbers
+} defer_ranges[E820MAX];
+
+static int defer_next, ndefer;
+static size_t defer_npage;                                  // # of deferred pages left
+static bool defer_started;
+
+/* *
+ * defer_grow - initialize the next chunk (at least n pages if possible) of the
+ * deferred pages and give it to pmm. Called with interrupts disabled, returns
+ * false if there is nothing (more) to give.
+ * */
+static bool
+defer_grow(size_t n) {
+    if (!defer_started || defer_next == ndefer) {
+        return 0;
+    }
+    struct defer_range *range = defer_ranges + defer_next;
+    size_t chunk = (n > PMM_DEFER_CHUNK) ? n : PMM_DEFER_CHUNK;
+    if (chunk > range->end - range->begin) {
+        chunk = range->end - range->begin;
+    }
+    struct Page *base = pages + range->begin, *p;
+    for (p = base; p < base + chunk; p ++) {
+        p->flags = 0;
+        SetPageReserved(p);
+    }
+    init_memmap(base, chunk);
+    defer_npage -= chunk;
+    if ((range->begin += chunk) == range->end) {
+        defer_next ++;
+    }
+    return 1;
+}
+
+// nr_deferred_pages - the # of free pages not given to pmm yet
+size_t
+nr_deferred_pages(void) {
+    return defer_npage;
+}
+
+// pmm_defer_start - let alloc_pages take the deferred pages from now on
+void
+pmm_defer_start(void) {
+    defer_started = 1;
+    cprintf("pmm: %u pages deferred.\n", defer_npage);
+}
+
+// pmm_initd - kernel thread to give all deferred pages to pmm, one chunk at a time
+int
+pmm_initd(void *arg) {
+    bool intr_flag, more;
+    do {
+        local_intr_save(intr_flag);
+        {
+            more = defer_grow(PMM_DEFER_CHUNK);
+        }
+        local_intr_restore(intr_flag);
+        schedule();
+    } while (more);
+    return 0;
+}
+
 //alloc_pages - call pmm->alloc_pages to allocate a continuous n*PAGESIZE memory 
 struct Page *
 alloc_pages(size_t n) {
@@ -161,6 +270,10 @@ alloc_pages(size_t n) {
          local_intr_save(intr_flag);
          {
               page = pmm_manager->alloc_pages(n);
+              // out of initialized pages, give more of the deferred ones to pmm
+              while (page == NULL && defer_grow(n)) {
+                   page = pmm_manager->alloc_pages(n);
+              }
          }
          local_intr_restore(intr_flag);
 
@@ -226,12 +339,12 @@ page_init(void) {
     npage = maxpa / PGSIZE;
     pages = (struct Page *)ROUNDUP((void *)end, PGSIZE);
 
-    for (i = 0; i < npage; i ++) {
-        SetPageReserved(pages + i);
-    }
-
     uintptr_t freemem = PADDR((uintptr_t)pages + sizeof(struct Page) * npage);
 
+    // the free memory ranges, in page numbers; the first PMM_EAGER_NPAGE pages
+    // of them are given to pmm now, the rest are deferred
+    struct defer_range free_ranges[E820MAX];
+    int j, nfree = 0;
     for (i = 0; i < memmap->nr_map; i ++) {
         uint64_t begin = memmap->map[i].addr, end = begin + memmap->map[i].size;
         if (memmap->map[i].type == E820_ARM) {
@@ -245,11 +358,54 @@ page_init(void) {
                 begin = ROUNDUP(begin, PGSIZE);
                 end = ROUNDDOWN(end, PGSIZE);
                 if (begin < end) {
-                    init_memmap(pa2page(begin), (end - begin) / PGSIZE);
+                    free_ranges[nfree].begin = begin / PGSIZE, free_ranges[nfree].end = end / PGSIZE;
+                    nfree ++;
                 }
             }
         }
     }
+
+    // sorted by address, so pmm gets its pages in address order
+    for (i = 1; i < nfree; i ++) {
+        struct defer_range range = free_ranges[i];
+        for (j = i; j > 0 && free_ranges[j - 1].begin > range.begin; j --) {
+            free_ranges[j] = free_ranges[j - 1];
+        }
+        free_ranges[j] = range;
+    }
+
+    size_t eager = PMM_EAGER_NPAGE, next = 0;
+    ndefer = defer_next = 0, defer_npage = 0, defer_started = 0;
+    for (i = 0; i < nfree; i ++) {
+        struct defer_range *range = free_ranges + i;
+        size_t n = range->end - range->begin;
+        if (n > eager) {
+            n = eager;
+        }
+        eager -= n;
+        if (range->begin + n < range->end) {
+            defer_ranges[ndefer].begin = range->begin + n, defer_ranges[ndefer].end = range->end;
+            defer_npage += range->end - range->begin - n;
+            ndefer ++;
+        }
+        range->end = range->begin + n;
+    }
+
+    // every other page is reserved, the deferred ones are left alone
+    for (i = 0; i <= ndefer; i ++) {
+        size_t limit = (i < ndefer) ? defer_ranges[i].begin : npage;
+        for (; next < limit; next ++) {
+            SetPageReserved(pages + next);
+        }
+        if (i < ndefer) {
+            next = defer_ranges[i].end;
+        }
+    }
+    for (j = 0; j < nfree; j ++) {
+        if (free_ranges[j].begin < free_ranges[j].end) {
+            init_memmap(pages + free_ranges[j].begin, free_ranges[j].end - free_ranges[j].begin);
+        }
+    }
 }
 
 static void
@@ -310,14 +466,14 @@ pmm_init(void) {
     page_init();
 
     //use pmm->check to verify the correctness of the alloc/free function in a pmm
-    check_alloc_page();
+    self_check(check_alloc_page());
 
     // create boot_pgdir, an initial page directory(Page Directory Table, PDT)
     boot_pgdir = boot_alloc_page();
     memset(boot_pgdir, 0, PGSIZE);
     boot_cr3 = PADDR(boot_pgdir);
 
-    check_pgdir();
+    self_check(check_pgdir());
 
     static_assert(KERNBASE % PTSIZE == 0 && KERNTOP % PTSIZE == 0);
 
@@ -346,7 +502,7 @@ pmm_init(void) {
 
     //now the basic virtual memory map(see memalyout.h) is established.
     //check the correctness of the basic virtual memory map.
-    check_boot_pgdir();
+    self_check(check_boot_pgdir());
 
     print_pgdir();
     
@@ -523,11 +679,18 @@ copy_range(pde_t *to, pde_t *from, uintptr_t start, uintptr_t end, bool share) {
         uint32_t perm = (*ptep & PTE_USER);
         //get page from ptep
         struct Page *page = pte2page(*ptep);
+        assert(page!=NULL);
+        int ret=0;
+        // the zero page is shared read-only, process B copies it on its first write
+        if (page == zero_page) {
+            ret = page_insert(to, zero_page, start, perm);
+            assert(ret == 0);
+            start += PGSIZE;
+            continue ;
+        }
         // alloc a page for process B
         struct Page *npage=alloc_page();
-        assert(page!=NULL);
         assert(npage!=NULL);
-        int ret=0;
         /* LAB5:EXERCISE2 YOUR CODE
          * replicate content of page to npage, build the map of phy addr of nage with the linear addr start
          *
@@ -0,0 +1,58 @@
+#include <defs.h>
+#include <string.h>
+#include <kmalloc.h>
+#include <pmm.h>
+#include <shmem.h>
+#include <assert.h>
+
+// shmem_create - alloc a shared memory object of len bytes (rounded up to pages), no page is allocated yet
+struct shmem_struct *
+shmem_create(size_t len) {
+    size_t npages = ROUNDUP(len, PGSIZE) / PGSIZE;
+    struct shmem_struct *shmem;
+    if (npages == 0 || (shmem = kmalloc(sizeof(struct shmem_struct))) == NULL) {
+        return NULL;
+    }
+    if ((shmem->pages = kmalloc(npages * sizeof(struct Page *))) == NULL) {
+        kfree(shmem);
+        return NULL;
+    }
+    memset(shmem->pages, 0, npages * sizeof(struct Page *));
+    shmem->npages = npages;
+    shmem->ref_count = 0;
+    sem_init(&(shmem->sem), 1);
+    return shmem;
+}
+
+// shmem_destroy - drop the references of the object to its pages, and free it
+void
+shmem_destroy(struct shmem_struct *shmem) {
+    assert(shmem->ref_count == 0);
+    size_t i;
+    for (i = 0; i < shmem->npages; i ++) {
+        struct Page *page;
+        if ((page = shmem->pages[i]) != NULL && page_ref_dec(page) == 0) {
+            free_page(page);
+        }
+    }
+    kfree(shmem->pages);
+    kfree(shmem);
+}
+
+// shmem_get_page - get the index-th page of the object, alloc a zeroed one on first use
+struct Page *
+shmem_get_page(struct shmem_struct *shmem, size_t index) {
+    assert(index < shmem->npages);
+    struct Page *page;
+    down(&(shmem->sem));
+    if ((page = shmem->pages[index]) == NULL) {
+        if ((page = alloc_page()) != NULL) {
+            memset(page2kva(page), 0, PGSIZE);
+            page_ref_inc(page);
+            shmem->pages[index] = page;
+        }
+    }
+    up(&(shmem->sem));
+    return page;
+}
+
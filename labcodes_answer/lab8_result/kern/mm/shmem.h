@@ -0,0 +1,39 @@
+#ifndef __KERN_MM_SHMEM_H__
+#define __KERN_MM_SHMEM_H__
+
+#include <defs.h>
+#include <sem.h>
+
+struct Page;
+
+/*
+ * shmem_struct - a shared memory object. Its pages are allocated on the first
+ * page fault and then mapped by every vma (in any mm_struct) that maps the object;
+ * the object holds one reference to each page, so a page lives until the last
+ * vma mapping the object is gone.
+ */
+struct shmem_struct {
+    size_t npages;                  // size of the object, in pages
+    struct Page **pages;            // pages[i] is the i-th page, NULL if not allocated yet
+    int ref_count;                  // # of vmas mapping the object
+    semaphore_t sem;                // mutex for allocating pages
+};
+
+struct shmem_struct *shmem_create(size_t len);
+void shmem_destroy(struct shmem_struct *shmem);
+struct Page *shmem_get_page(struct shmem_struct *shmem, size_t index);
+
+static inline int
+shmem_ref_inc(struct shmem_struct *shmem) {
+    shmem->ref_count += 1;
+    return shmem->ref_count;
+}
+
+static inline int
+shmem_ref_dec(struct shmem_struct *shmem) {
+    shmem->ref_count -= 1;
+    return shmem->ref_count;
+}
+
+#endif /* !__KERN_MM_SHMEM_H__ */
+
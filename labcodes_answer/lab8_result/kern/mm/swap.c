@@ -47,7 +47,7 @@ swap_init(void)
      {
           swap_init_ok = 1;
           cprintf("SWAP: manager = %s\n", sm->name);
-          check_swap();
+          self_check(check_swap());
      }
 
      return r;
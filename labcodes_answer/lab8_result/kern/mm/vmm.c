@@ -8,6 +8,11 @@
 #include <x86.h>
 #include <swap.h>
 #include <kmalloc.h>
+#include <shmem.h>
+#include <inode.h>
+#include <iobuf.h>
+#include <trace.h>
+#include <zeropage.h>
 
 /* 
   vmm design include two parts: mm_struct (mm) & vma_struct (vma)
@@ -26,8 +31,11 @@
      struct vma_struct * vma_create (uintptr_t vm_start, uintptr_t vm_end,...)
      void insert_vma_struct(struct mm_struct *mm, struct vma_struct *vma)
      struct vma_struct * find_vma(struct mm_struct *mm, uintptr_t addr)
+     int mm_map(struct mm_struct *mm, uintptr_t addr, size_t len, uint32_t vm_flags, ...)
+     int mm_unmap(struct mm_struct *mm, uintptr_t addr, size_t len)
    local functions
      inline void check_vma_overlap(struct vma_struct *prev, struct vma_struct *next)
+     void vma_destroy(struct vma_struct *vma)
 ---------------
    check correctness functions
      void check_vmm(void);
@@ -54,7 +62,7 @@ mm_create(void) {
         else mm->sm_priv = NULL;
         
         set_mm_count(mm, 0);
-        sem_init(&(mm->mm_sem), 1);
+        rwsem_init(&(mm->mm_sem));
     }    
     return mm;
 }
@@ -68,10 +76,54 @@ vma_create(uintptr_t vm_start, uintptr_t vm_end, uint32_t vm_flags) {
         vma->vm_start = vm_start;
         vma->vm_end = vm_end;
         vma->vm_flags = vm_flags;
+        vma->shmem = NULL;
+        vma->vm_file = NULL;
+        vma->vm_pgoff = 0;
     }
     return vma;
 }
 
+// vma_set_shmem - let vma map the shared memory object shmem from its page pgoff on
+void
+vma_set_shmem(struct vma_struct *vma, struct shmem_struct *shmem, size_t pgoff) {
+    assert(vma->shmem == NULL && vma->vm_file == NULL);
+    shmem_ref_inc(shmem);
+    vma->shmem = shmem, vma->vm_pgoff = pgoff;
+    vma->vm_flags |= VM_SHARE;
+}
+
+// vma_set_file - let vma map (privately) the file node from its page pgoff on
+void
+vma_set_file(struct vma_struct *vma, struct inode *node, size_t pgoff) {
+    assert(vma->shmem == NULL && vma->vm_file == NULL);
+    vop_ref_inc(node);
+    vma->vm_file = node, vma->vm_pgoff = pgoff;
+}
+
+// vma_copy_backing - let vma map the same shmem/file as from, from start on
+static void
+vma_copy_backing(struct vma_struct *vma, struct vma_struct *from, uintptr_t start) {
+    size_t pgoff = from->vm_pgoff + (start - from->vm_start) / PGSIZE;
+    if (from->shmem != NULL) {
+        vma_set_shmem(vma, from->shmem, pgoff);
+    }
+    if (from->vm_file != NULL) {
+        vma_set_file(vma, from->vm_file, pgoff);
+    }
+}
+
+// vma_destroy - drop the references of vma to its shmem/file, and free it
+static void
+vma_destroy(struct vma_struct *vma) {
+    if (vma->shmem != NULL && shmem_ref_dec(vma->shmem) == 0) {
+        shmem_destroy(vma->shmem);
+    }
+    if (vma->vm_file != NULL) {
+        vop_ref_dec(vma->vm_file);
+    }
+    kfree(vma);
+}
+
 
 // find_vma - find a vma  (vma->vm_start <= addr <= vma_vm_end)
 struct vma_struct *
@@ -101,6 +153,22 @@ find_vma(struct mm_struct *mm, uintptr_t addr) {
 }
 
 
+// find_vma_intersection - find the first vma overlapping [start, end)
+static struct vma_struct *
+find_vma_intersection(struct mm_struct *mm, uintptr_t start, uintptr_t end) {
+    list_entry_t *list = &(mm->mmap_list), *le = list;
+    while ((le = list_next(le)) != list) {
+        struct vma_struct *vma = le2vma(le, list_link);
+        if (vma->vm_start >= end) {
+            break;
+        }
+        if (vma->vm_end > start) {
+            return vma;
+        }
+    }
+    return NULL;
+}
+
 // check_vma_overlap - check if vma1 overlaps vma2 ?
 static inline void
 check_vma_overlap(struct vma_struct *prev, struct vma_struct *next) {
@@ -150,7 +218,7 @@ mm_destroy(struct mm_struct *mm) {
     list_entry_t *list = &(mm->mmap_list), *le;
     while ((le = list_next(list)) != list) {
         list_del(le);
-        kfree(le2vma(le, list_link));  //kfree vma        
+        vma_destroy(le2vma(le, list_link));  //kfree vma
     }
     kfree(mm); //kfree mm
     mm=NULL;
@@ -169,7 +237,7 @@ mm_map(struct mm_struct *mm, uintptr_t addr, size_t len, uint32_t vm_flags,
     int ret = -E_INVAL;
 
     struct vma_struct *vma;
-    if ((vma = find_vma(mm, start)) != NULL && end > vma->vm_start) {
+    if (find_vma_intersection(mm, start, end) != NULL) {
         goto out;
     }
     ret = -E_NO_MEM;
@@ -187,6 +255,94 @@ out:
     return ret;
 }
 
+// mm_free_ptables - free the page tables in [start, end) which no vma uses any more
+static void
+mm_free_ptables(struct mm_struct *mm, uintptr_t start, uintptr_t end) {
+    uintptr_t la = ROUNDDOWN(start, PTSIZE);
+    for (; la < end; la += PTSIZE) {
+        uintptr_t pt_start = (la < USERBASE) ? USERBASE : la, pt_end = la + PTSIZE;
+        if (find_vma_intersection(mm, pt_start, pt_end) == NULL) {
+            exit_range(mm->pgdir, pt_start, pt_end);
+            tlb_invalidate(mm->pgdir, pt_start);
+        }
+    }
+}
+
+// mm_unmap - remove the mapping of [addr, addr + len), vmas partly in the range are shrunk or split
+int
+mm_unmap(struct mm_struct *mm, uintptr_t addr, size_t len) {
+    uintptr_t start = ROUNDDOWN(addr, PGSIZE), end = ROUNDUP(addr + len, PGSIZE);
+    if (!USER_ACCESS(start, end)) {
+        return -E_INVAL;
+    }
+
+    assert(mm != NULL);
+
+    struct vma_struct *vma, *nvma;
+    if ((vma = find_vma_intersection(mm, start, end)) == NULL) {
+        return 0;
+    }
+    // the range is in the middle of vma: keep the head in a new vma, vma becomes the tail
+    if (vma->vm_start < start && end < vma->vm_end) {
+        if ((nvma = vma_create(vma->vm_start, start, vma->vm_flags & ~VM_SHARE)) == NULL) {
+            return -E_NO_MEM;
+        }
+        vma_copy_backing(nvma, vma, vma->vm_start);
+        vma->vm_pgoff += (end - vma->vm_start) / PGSIZE;
+        vma->vm_start = end;
+        insert_vma_struct(mm, nvma);
+        unmap_range(mm->pgdir, start, end);
+        mm_free_ptables(mm, start, end);
+        return 0;
+    }
+
+    list_entry_t *list = &(mm->mmap_list), *le = &(vma->list_link);
+    while (le != list && (vma = le2vma(le, list_link))->vm_start < end) {
+        le = list_next(le);
+        uintptr_t un_start = (vma->vm_start < start) ? start : vma->vm_start;
+        uintptr_t un_end = (vma->vm_end > end) ? end : vma->vm_end;
+        unmap_range(mm->pgdir, un_start, un_end);
+        if (vma->vm_start < un_start) {
+            vma->vm_end = un_start;
+        }
+        else if (un_end < vma->vm_end) {
+            vma->vm_pgoff += (un_end - vma->vm_start) / PGSIZE;
+            vma->vm_start = un_end;
+        }
+        else {
+            list_del(&(vma->list_link));
+            mm->map_count --;
+            vma_destroy(vma);
+        }
+    }
+    mm->mmap_cache = NULL;
+    mm_free_ptables(mm, start, end);
+    return 0;
+}
+
+// get_unmapped_area - find a free range of len bytes, as high as possible below the user stack
+uintptr_t
+get_unmapped_area(struct mm_struct *mm, size_t len) {
+    if (len == 0 || len > USTACKTOP - USTACKSIZE - UTEXT) {
+        return 0;
+    }
+    uintptr_t start = USTACKTOP - USTACKSIZE - len;
+    list_entry_t *list = &(mm->mmap_list), *le = list;
+    while ((le = list_prev(le)) != list) {
+        struct vma_struct *vma = le2vma(le, list_link);
+        if (start >= vma->vm_end) {
+            break;
+        }
+        if (start + len > vma->vm_start) {
+            if (vma->vm_start < UTEXT + len) {
+                return 0;
+            }
+            start = vma->vm_start - len;
+        }
+    }
+    return (start >= UTEXT) ? start : 0;
+}
+
 int
 dup_mmap(struct mm_struct *to, struct mm_struct *from) {
     assert(to != NULL && from != NULL);
@@ -194,13 +350,18 @@ dup_mmap(struct mm_struct *to, struct mm_struct *from) {
     while ((le = list_prev(le)) != list) {
         struct vma_struct *vma, *nvma;
         vma = le2vma(le, list_link);
-        nvma = vma_create(vma->vm_start, vma->vm_end, vma->vm_flags);
+        nvma = vma_create(vma->vm_start, vma->vm_end, vma->vm_flags & ~VM_SHARE);
         if (nvma == NULL) {
             return -E_NO_MEM;
         }
+        vma_copy_backing(nvma, vma, vma->vm_start);
 
         insert_vma_struct(to, nvma);
 
+        // pages of a shared memory object are mapped from the object on page fault
+        if (nvma->shmem != NULL) {
+            continue;
+        }
         bool share = 0;
         if (copy_range(to->pgdir, from->pgdir, vma->vm_start, vma->vm_end, share) != 0) {
             return -E_NO_MEM;
@@ -246,7 +407,8 @@ copy_to_user(struct mm_struct *mm, void *dst, const void *src, size_t len) {
 //          - now just call check_vmm to check correctness of vmm
 void
 vmm_init(void) {
-    check_vmm();
+    zero_page_init();
+    self_check(check_vmm());
 }
 
 // check_vmm - check correctness of vmm
@@ -392,12 +554,53 @@ volatile unsigned int pgfault_num=0;
  *         -- The U/S flag (bit 2) indicates whether the processor was executing at user mode (1)
  *            or supervisor mode (0) at the time of the exception.
  */
+/* vma_fill_page - fill the new page at addr of vma: read it from the mapped file
+ *                 (zero past the end of file), or zero it for anonymous memory
+ */
+static int
+vma_fill_page(struct vma_struct *vma, uintptr_t addr, void *kva) {
+    size_t copied = 0;
+    int ret = 0;
+    if (vma->vm_file != NULL) {
+        off_t offset = (vma->vm_pgoff + (addr - vma->vm_start) / PGSIZE) * PGSIZE;
+        struct iobuf __iob, *iob = iobuf_init(&__iob, kva, PGSIZE, offset);
+        ret = vop_read(vma->vm_file, iob);
+        copied = iobuf_used(iob);
+    }
+    memset(kva + copied, 0, PGSIZE - copied);
+    return ret;
+}
+
+/*
+ * vma_zeroed_page - map a page of zeros at addr for a write to an anonymous page,
+ *                   replacing the zero_page if it is mapped there
+ */
+static int
+vma_zeroed_page(struct mm_struct *mm, uintptr_t addr, uint32_t perm) {
+    int ret;
+    struct Page *page;
+    if ((page = alloc_zeroed_page()) == NULL) {
+        cprintf("alloc_zeroed_page in do_pgfault failed\n");
+        return -E_NO_MEM;
+    }
+    if ((ret = page_insert(mm->pgdir, page, addr, perm)) != 0) {
+        free_page(page);
+        return ret;
+    }
+    if (swap_init_ok && mm == check_mm_struct) {
+        swap_map_swappable(mm, addr, page, 0);
+        page->pra_vaddr = addr;
+    }
+    return 0;
+}
+
 int
 do_pgfault(struct mm_struct *mm, uint32_t error_code, uintptr_t addr) {
     int ret = -E_INVAL;
     //try to find a vma which include addr
     struct vma_struct *vma = find_vma(mm, addr);
 
+    trace(TRACE_PGFAULT, addr, error_code, 0, 0);
     pgfault_num++;
     //If the addr is in the range of a mm's vma?
     if (vma == NULL || vma->vm_start > addr) {
@@ -505,23 +708,57 @@ do_pgfault(struct mm_struct *mm, uint32_t error_code, uintptr_t addr) {
     }
     
     if (*ptep == 0) { // if the phy addr isn't exist, then alloc a page & map the phy addr with logical addr
-        if (pgdir_alloc_page(mm->pgdir, addr, perm) == NULL) {
-            cprintf("pgdir_alloc_page in do_pgfault failed\n");
-            goto failed;
+        if (vma->shmem != NULL) {
+            // map the page of the shared memory object
+            struct Page *page;
+            size_t index = vma->vm_pgoff + (addr - vma->vm_start) / PGSIZE;
+            if ((page = shmem_get_page(vma->shmem, index)) == NULL) {
+                cprintf("shmem_get_page in do_pgfault failed\n");
+                goto failed;
+            }
+            if ((ret = page_insert(mm->pgdir, page, addr, perm)) != 0) {
+                goto failed;
+            }
+        }
+        else if (vma->vm_file == NULL) {
+            // anonymous: share the zero page until the first write
+            if (!(error_code & 2)) {
+                ret = page_insert(mm->pgdir, zero_page, addr, perm & ~PTE_W);
+            }
+            else {
+                ret = vma_zeroed_page(mm, addr, perm);
+            }
+            if (ret != 0) {
+                goto failed;
+            }
+        }
+        else {
+            struct Page *page;
+            if ((page = pgdir_alloc_page(mm->pgdir, addr, perm)) == NULL) {
+                cprintf("pgdir_alloc_page in do_pgfault failed\n");
+                goto failed;
+            }
+            if ((ret = vma_fill_page(vma, addr, page2kva(page))) != 0) {
+                page_remove(mm->pgdir, addr);
+                goto failed;
+            }
         }
     }
     else {
         struct Page *page=NULL;
-        cprintf("do pgfault: ptep %x, pte %x\n",ptep, *ptep);
         if (*ptep & PTE_P) {
             //if process write to this existed readonly page (PTE_P means existed), then should be here now.
-            //we can implement the delayed memory space copy for fork child process (AKA copy on write, COW).
-            //we didn't implement now, we will do it in future.
-            panic("error write a non-writable pte");
-            //page = pte2page(*ptep);
+            //only the shared zero page is copied on write, fork still copies every other page.
+            if (pte2page(*ptep) != zero_page) {
+                panic("error write a non-writable pte");
+            }
+            if ((ret = vma_zeroed_page(mm, addr, perm)) != 0) {
+                goto failed;
+            }
         } else{
            // if this pte is a swap entry, then load data from disk to a page with phy addr
            // and call page_insert to map the phy addr with logical addr
+           cprintf("do pgfault: ptep %x, pte %x\n",ptep, *ptep);
            if(swap_init_ok) {               
                if ((ret = swap_in(mm, addr, &page)) != 0) {
                    cprintf("swap_in in do_pgfault failed\n");
@@ -533,10 +770,10 @@ do_pgfault(struct mm_struct *mm, uint32_t error_code, uintptr_t addr) {
             cprintf("no swap_init_ok but ptep is %x, failed\n",*ptep);
             goto failed;
            }
+           page_insert(mm->pgdir, page, addr, perm);
+           swap_map_swappable(mm, addr, page, 1);
+           page->pra_vaddr = addr;
        } 
-       page_insert(mm->pgdir, page, addr, perm);
-       swap_map_swappable(mm, addr, page, 1);
-       page->pra_vaddr = addr;
    }
    ret = 0;
 failed:
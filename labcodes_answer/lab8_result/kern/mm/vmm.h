@@ -6,10 +6,12 @@
 #include <memlayout.h>
 #include <sync.h>
 #include <proc.h>
-#include <sem.h>
+#include <rwsem.h>
 
 //pre define
 struct mm_struct;
+struct shmem_struct;
+struct inode;
 
 // the virtual continuous memory area(vma)
 struct vma_struct {
@@ -18,6 +20,9 @@ struct vma_struct {
     uintptr_t vm_end;        // end addr of vma
     uint32_t vm_flags;       // flags of vma
     list_entry_t list_link;  // linear list link which sorted by start addr of vma
+    struct shmem_struct *shmem; // the shared memory object mapped (VM_SHARE)
+    struct inode *vm_file;   // the file mapped (private mapping), or NULL
+    size_t vm_pgoff;         // offset of vm_start in shmem / vm_file, in pages
 };
 
 #define le2vma(le, member)                  \
@@ -27,6 +32,7 @@ struct vma_struct {
 #define VM_WRITE                0x00000002
 #define VM_EXEC                 0x00000004
 #define VM_STACK                0x00000008
+#define VM_SHARE                0x00000010
 
 // the control struct for a set of vma using the same PDT
 struct mm_struct {
@@ -36,13 +42,15 @@ struct mm_struct {
     int map_count;                 // the count of these vma
     void *sm_priv;                 // the private data for swap manager
     int mm_count;                  // the number ofprocess which shared the mm
-    semaphore_t mm_sem;            // mutex for using dup_mmap fun to duplicat the mm 
-    int locked_by;                 // the lock owner process's pid
+    rwsem_t mm_sem;                // exclusive to change the vmas, shared to copy from/to user or fault
+    int locked_by;                 // the exclusive lock owner process's pid
 
 };
 
 struct vma_struct *find_vma(struct mm_struct *mm, uintptr_t addr);
 struct vma_struct *vma_create(uintptr_t vm_start, uintptr_t vm_end, uint32_t vm_flags);
+void vma_set_shmem(struct vma_struct *vma, struct shmem_struct *shmem, size_t pgoff);
+void vma_set_file(struct vma_struct *vma, struct inode *node, size_t pgoff);
 void insert_vma_struct(struct mm_struct *mm, struct vma_struct *vma);
 
 struct mm_struct *mm_create(void);
@@ -92,7 +100,7 @@ mm_count_dec(struct mm_struct *mm) {
 static inline void
 lock_mm(struct mm_struct *mm) {
     if (mm != NULL) {
-        down(&(mm->mm_sem));
+        down_write(&(mm->mm_sem));
         if (current != NULL) {
             mm->locked_by = current->pid;
         }
@@ -102,8 +110,26 @@ lock_mm(struct mm_struct *mm) {
 static inline void
 unlock_mm(struct mm_struct *mm) {
     if (mm != NULL) {
-        up(&(mm->mm_sem));
         mm->locked_by = 0;
+        up_write(&(mm->mm_sem));
+    }
+}
+
+/*
+ * lock_mm_shared - lock mm for users that do not change its vmas, such as
+ *                  copy_from_user/copy_to_user and page faults
+ */
+static inline void
+lock_mm_shared(struct mm_struct *mm) {
+    if (mm != NULL) {
+        down_read(&(mm->mm_sem));
+    }
+}
+
+static inline void
+unlock_mm_shared(struct mm_struct *mm) {
+    if (mm != NULL) {
+        up_read(&(mm->mm_sem));
     }
 }
 
@@ -0,0 +1,165 @@
+#include <defs.h>
+#include <stdio.h>
+#include <string.h>
+#include <list.h>
+#include <wait.h>
+#include <sync.h>
+#include <pmm.h>
+#include <proc.h>
+#include <sched.h>
+#include <zeropage.h>
+#include <assert.h>
+
+/*
+ * Zero pages for anonymous memory.
+ *
+ * A read fault on an anonymous page maps zero_page read-only, the first write
+ * to it takes a page from the pool of pre-zeroed pages (see do_pgfault). The
+ * "zero_daemon" fills the pool only while no other process is runnable, so the
+ * memset of a page is mostly paid by the idle cpu instead of the faulting one.
+ */
+
+struct Page *zero_page = NULL;
+
+static list_entry_t zero_pool;
+static size_t nr_zeroed = 0;
+
+static wait_queue_t zero_wait_queue;
+static timer_t zero_timer;
+static int zero_pid = 0;
+
+/*
+ * zero_page_init - alloc the shared zero page and an empty pool, called in vmm_init
+ */
+void
+zero_page_init(void) {
+    if ((zero_page = alloc_page()) == NULL) {
+        panic("alloc zero page failed.\n");
+    }
+    memset(page2kva(zero_page), 0, PGSIZE);
+    set_page_ref(zero_page, 1);
+    list_init(&zero_pool);
+    wait_queue_init(&zero_wait_queue);
+    list_init(&(zero_timer.timer_link));
+}
+
+/*
+ * alloc_zeroed_page - alloc a page filled with zeros, from the pool if it is not
+ *                     empty. Wake the daemon once the pool runs low.
+ */
+struct Page *
+alloc_zeroed_page(void) {
+    struct Page *page = NULL;
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        if (!list_empty(&zero_pool)) {
+            list_entry_t *le = list_next(&zero_pool);
+            list_del(le);
+            page = le2page(le, page_link);
+            nr_zeroed --;
+        }
+        if (nr_zeroed < ZERO_POOL_LOW && !wait_queue_empty(&zero_wait_queue)) {
+            del_timer(&zero_timer);
+            wakeup_queue(&zero_wait_queue, WT_DAEMON, 1);
+        }
+    }
+    local_intr_restore(intr_flag);
+    if (page == NULL && (page = alloc_page()) != NULL) {
+        memset(page2kva(page), 0, PGSIZE);
+    }
+    return page;
+}
+
+/*
+ * zero_pool_fill - zero pages into the pool until it is full, memory gets short,
+ *                  or another process wants the cpu
+ */
+static void
+zero_pool_fill(void) {
+    while (nr_zeroed < ZERO_POOL_SIZE && !sched_runnable()) {
+        if ((current->flags & PF_EXITING) || nr_free_pages() < ZERO_POOL_RESERVE) {
+            break;
+        }
+        struct Page *page;
+        if ((page = alloc_page()) == NULL) {
+            break;
+        }
+        memset(page2kva(page), 0, PGSIZE);
+
+        bool intr_flag;
+        local_intr_save(intr_flag);
+        {
+            list_add(&zero_pool, &(page->page_link));
+            nr_zeroed ++;
+        }
+        local_intr_restore(intr_flag);
+    }
+}
+
+/*
+ * zero_daemon - refill the pool every ZERO_INTERVAL ticks while it is not full,
+ *               or sooner when it runs low, until killed. A full pool needs no
+ *               timer: the daemon sleeps until alloc_zeroed_page takes it
+ *               below ZERO_POOL_LOW.
+ */
+static int
+zero_daemon(void *arg) {
+    bool intr_flag;
+    while (1) {
+        wait_t __wait, *wait = &__wait;
+        local_intr_save(intr_flag);
+        wait_current_set(&zero_wait_queue, wait, WT_DAEMON);
+        if (nr_zeroed < ZERO_POOL_SIZE) {
+            add_timer(timer_init(&zero_timer, current, ZERO_INTERVAL));
+        }
+        local_intr_restore(intr_flag);
+
+        schedule();
+
+        local_intr_save(intr_flag);
+        del_timer(&zero_timer);
+        wait_current_del(&zero_wait_queue, wait);
+        local_intr_restore(intr_flag);
+
+        if (current->flags & PF_EXITING) {
+            break;
+        }
+        zero_pool_fill();
+    }
+    return 0;
+}
+
+/*
+ * zero_daemon_init - start the zeroing daemon
+ */
+void
+zero_daemon_init(void) {
+    if ((zero_pid = kernel_daemon(zero_daemon, NULL, "zero_daemon")) <= 0) {
+        warn("start zero daemon failed: %e.\n", zero_pid);
+    }
+}
+
+/*
+ * zero_daemon_cleanup - stop the zeroing daemon and give the pool back to pmm
+ */
+void
+zero_daemon_cleanup(void) {
+    if (zero_pid > 0) {
+        int pid = zero_pid;
+        zero_pid = 0;
+        kernel_daemon_stop(pid);
+    }
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        while (!list_empty(&zero_pool)) {
+            list_entry_t *le = list_next(&zero_pool);
+            list_del(le);
+            free_page(le2page(le, page_link));
+            nr_zeroed --;
+        }
+        assert(nr_zeroed == 0);
+    }
+    local_intr_restore(intr_flag);
+}
@@ -0,0 +1,25 @@
+#ifndef __KERN_MM_ZEROPAGE_H__
+#define __KERN_MM_ZEROPAGE_H__
+
+#include <defs.h>
+
+struct Page;
+
+#define ZERO_POOL_SIZE              64          // max # of pre-zeroed pages kept in the pool
+#define ZERO_POOL_LOW               16          // wake the zeroing daemon below this
+#define ZERO_POOL_RESERVE           1024        // never fill the pool below this many free pages
+#define ZERO_INTERVAL               100         // ticks between refills of the pool
+
+/*
+ * zero_page is one page of zeros shared read-only by every anonymous page that
+ * was only read so far; it holds a reference of its own and is never freed.
+ */
+extern struct Page *zero_page;
+
+void zero_page_init(void);
+struct Page *alloc_zeroed_page(void);
+void zero_daemon_init(void);
+void zero_daemon_cleanup(void);
+
+#endif /* !__KERN_MM_ZEROPAGE_H__ */
+
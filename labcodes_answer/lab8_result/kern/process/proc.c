@@ -15,6 +15,13 @@
 #include <fs.h>
 #include <vfs.h>
 #include <sysfile.h>
+#include <file.h>
+#include <inode.h>
+#include <shmem.h>
+#include <clock.h>
+#include <trace.h>
+#include <boottime.h>
+#include <zeropage.h>
 
 /* ------------- process/thread mechanism design&implementation -------------
 (an simplified Linux process/thread mechanism )
@@ -133,7 +140,15 @@ alloc_proc(void) {
         proc->lab6_run_pool.left = proc->lab6_run_pool.right = proc->lab6_run_pool.parent = NULL;
         proc->lab6_stride = 0;
         proc->lab6_priority = 0;
+        proc->cfs_vruntime = proc->cfs_exec_start = proc->cfs_slice_exec = 0;
+        proc->cfs_weight = 0;
+        proc->mlfq_level = 0;
+        proc->mlfq_boost_gen = 0;
+        memset(&(proc->sched_stat), 0, sizeof(struct schedstat));
+        proc->sched_stamp = clock_nsec();
+        proc->sched_wakeup = 0;
         proc->filesp = NULL;
+        proc->sysenter_eip = 0;
     }
     return proc;
 }
@@ -225,6 +240,8 @@ proc_run(struct proc_struct *proc) {
         struct proc_struct *prev = current, *next = proc;
         local_intr_save(intr_flag);
         {
+            trace(TRACE_SCHED_SWITCH, prev->pid, next->pid, prev->state, 0);
+            sched_stat_switch(prev, next);
             current = proc;
             load_esp0(next->kstack + KSTACKSIZE);
             lcr3(next->cr3);
@@ -284,6 +301,32 @@ kernel_thread(int (*fn)(void *), void *arg, uint32_t clone_flags) {
     return do_fork(clone_flags | CLONE_VM, 0, &tf);
 }
 
+// kernel_daemon - create a kernel thread named "name" that serves a subsystem until shutdown.
+//               - do_wait(0) does not wait for it; "fn" should return once PF_EXITING is set,
+//               - and its parent stops and reaps it with kernel_daemon_stop.
+// NOTE: daemons are started by init_main after it takes the memory snapshot, so
+//       their kernel stacks do not show up in the final memory check.
+int
+kernel_daemon(int (*fn)(void *), void *arg, const char *name) {
+    int pid;
+    if ((pid = kernel_thread(fn, arg, 0)) > 0) {
+        struct proc_struct *proc = find_proc(pid);
+        proc->flags |= PF_DAEMON;
+        set_proc_name(proc, name);
+    }
+    return pid;
+}
+
+// kernel_daemon_stop - ask daemon pid to exit and wait for it, called by its parent
+int
+kernel_daemon_stop(int pid) {
+    int ret;
+    if ((ret = do_kill(pid)) != 0) {
+        return ret;
+    }
+    return do_wait(pid, NULL);
+}
+
 // setup_kstack - alloc pages with size KSTACKPAGE as process kernel stack
 static int
 setup_kstack(struct proc_struct *proc) {
@@ -487,6 +530,7 @@ do_fork(uint32_t clone_flags, uintptr_t stack, struct trapframe *tf) {
         goto bad_fork_cleanup_fs;
     }
     copy_thread(proc, stack, tf);
+    proc->sysenter_eip = current->sysenter_eip;
 
     bool intr_flag;
     local_intr_save(intr_flag);
@@ -700,18 +744,7 @@ load_icode(int fd, int argc, char **kargv) {
             start += size;
             assert((end < la && start == end) || (end >= la && start == la));
         }
-        while (start < end) {
-            if ((page = pgdir_alloc_page(mm->pgdir, la, perm)) == NULL) {
-                ret = -E_NO_MEM;
-                goto bad_cleanup_mmap;
-            }
-            off = start - la, size = PGSIZE - off, la += PGSIZE;
-            if (end < la) {
-                size -= la - end;
-            }
-            memset(page2kva(page) + off, 0, size);
-            start += size;
-        }
+        // the rest of BSS is anonymous memory, do_pgfault maps it on first access
     }
     sysfile_close(fd);
 
@@ -723,6 +756,10 @@ load_icode(int fd, int argc, char **kargv) {
     assert(pgdir_alloc_page(mm->pgdir, USTACKTOP-2*PGSIZE , PTE_USER) != NULL);
     assert(pgdir_alloc_page(mm->pgdir, USTACKTOP-3*PGSIZE , PTE_USER) != NULL);
     assert(pgdir_alloc_page(mm->pgdir, USTACKTOP-4*PGSIZE , PTE_USER) != NULL);
+
+    if ((ret = clock_map_timepage(mm)) != 0) {
+        goto bad_cleanup_mmap;
+    }
     
     mm_count_inc(mm);
     current->mm = mm;
@@ -754,6 +791,8 @@ load_icode(int fd, int argc, char **kargv) {
     tf->tf_esp = stacktop;
     tf->tf_eip = elf->e_entry;
     tf->tf_eflags = FL_IF;
+    // the new program registers its own sysenter stub
+    current->sysenter_eip = 0;
     ret = 0;
 out:
     return ret;
@@ -819,22 +858,22 @@ do_execve(const char *name, int argc, const char **argv) {
     
     int ret = -E_INVAL;
     
-    lock_mm(mm);
+    lock_mm_shared(mm);
     if (name == NULL) {
         snprintf(local_name, sizeof(local_name), "<null> %d", current->pid);
     }
     else {
         if (!copy_string(mm, local_name, name, sizeof(local_name))) {
-            unlock_mm(mm);
+            unlock_mm_shared(mm);
             return ret;
         }
     }
     if ((ret = copy_kargv(mm, argc, kargv, argv)) != 0) {
-        unlock_mm(mm);
+        unlock_mm_shared(mm);
         return ret;
     }
     path = argv[0];
-    unlock_mm(mm);
+    unlock_mm_shared(mm);
     files_closeall(current->filesp);
 
     /* sysfile_open will check the first argument path, thus we have to use a user-space pointer, and argv[0] may be incorrect */    
@@ -900,10 +939,12 @@ repeat:
     else {
         proc = current->cptr;
         for (; proc != NULL; proc = proc->optr) {
-            haskid = 1;
             if (proc->state == PROC_ZOMBIE) {
                 goto found;
             }
+            if (!(proc->flags & PF_DAEMON)) {
+                haskid = 1;
+            }
         }
     }
     if (haskid) {
@@ -1001,24 +1042,38 @@ user_main(void *arg) {
 static int
 init_main(void *arg) {
     int ret;
-    if ((ret = vfs_set_bootfs("disk0:")) != 0) {
+    pmm_defer_start();
+    boot_phase(fs_mount_init());
+    boot_phase(ret = vfs_set_bootfs("disk0:"));
+    if (ret != 0) {
         panic("set boot fs failed: %e.\n", ret);
     }
+    boot_time_report();
     
-    size_t nr_free_pages_store = nr_free_pages();
+    // the deferred pages are free memory too, only not given to pmm yet
+    size_t nr_free_pages_store = nr_free_pages() + nr_deferred_pages();
     size_t kernel_allocated_store = kallocated();
 
+    fs_daemon_init();
+    zero_daemon_init();
+
     int pid = kernel_thread(user_main, NULL, 0);
     if (pid <= 0) {
         panic("create user_main failed.\n");
     }
+    // after user_main, so the shell starts first
+    if ((pid = kernel_thread(pmm_initd, NULL, 0)) <= 0) {
+        panic("create pmm_initd failed.\n");
+    }
+    set_proc_name(find_proc(pid), "pmm_initd");
  extern void check_sync(void);
-    check_sync();                // check philosopher sync problem
+    self_check(check_sync());    // check philosopher sync problem
 
     while (do_wait(0, NULL) == 0) {
         schedule();
     }
 
+    zero_daemon_cleanup();
     fs_cleanup();
         
     cprintf("all user-mode processes have quit.\n");
@@ -1026,7 +1081,7 @@ init_main(void *arg) {
     assert(nr_process == 2);
     assert(list_next(&proc_list) == &(initproc->list_link));
     assert(list_prev(&proc_list) == &(initproc->list_link));
-    assert(nr_free_pages_store == nr_free_pages());
+    assert(nr_free_pages_store == nr_free_pages() + nr_deferred_pages());
     assert(kernel_allocated_store == kallocated());
     cprintf("init check memory pass.\n");
     return 0;
@@ -1075,12 +1130,16 @@ proc_init(void) {
 }
 
 // cpu_idle - at the end of kern_init, the first kernel thread idleproc will do below works
+//          - with nothing to run, halt the cpu without the periodic tick (see clock_idle)
 void
 cpu_idle(void) {
     while (1) {
         if (current->need_resched) {
             schedule();
         }
+        else {
+            clock_idle();
+        }
     }
 }
 
@@ -1113,3 +1172,122 @@ do_sleep(unsigned int time) {
     del_timer(timer);
     return 0;
 }
+
+/* do_mmap_area - map len bytes at *addr_store (anywhere if *addr_store is 0) in the
+ *              - mm of current, backed by the shared memory object shmem, or by
+ *              - the file node from page pgoff on, or by zeroed anonymous memory
+ */
+static int
+do_mmap_area(uintptr_t *addr_store, size_t len, uint32_t mmap_flags,
+             struct shmem_struct *shmem, struct inode *node, size_t pgoff) {
+    struct mm_struct *mm = current->mm;
+    if (mm == NULL) {
+        panic("kernel thread call mmap!!.\n");
+    }
+    if (addr_store == NULL || len == 0) {
+        return -E_INVAL;
+    }
+
+    int ret = -E_INVAL;
+
+    uintptr_t addr;
+
+    lock_mm(mm);
+    if (!copy_from_user(mm, &addr, addr_store, sizeof(uintptr_t), 1)) {
+        goto out_unlock;
+    }
+
+    uintptr_t start = ROUNDDOWN(addr, PGSIZE), end = ROUNDUP(addr + len, PGSIZE);
+    addr = start, len = end - start;
+
+    uint32_t vm_flags = VM_READ;
+    if (mmap_flags & MMAP_WRITE) vm_flags |= VM_WRITE;
+    if (mmap_flags & MMAP_STACK) vm_flags |= VM_STACK;
+
+    ret = -E_NO_MEM;
+    if (addr == 0) {
+        if ((addr = get_unmapped_area(mm, len)) == 0) {
+            goto out_unlock;
+        }
+    }
+    struct vma_struct *vma;
+    if ((ret = mm_map(mm, addr, len, vm_flags, &vma)) != 0) {
+        goto out_unlock;
+    }
+    if (shmem != NULL) {
+        vma_set_shmem(vma, shmem, pgoff);
+    }
+    if (node != NULL) {
+        vma_set_file(vma, node, pgoff);
+    }
+    copy_to_user(mm, addr_store, &addr, sizeof(uintptr_t));
+    ret = 0;
+
+out_unlock:
+    unlock_mm(mm);
+    return ret;
+}
+
+/* do_mmap - map len bytes of anonymous memory, or of the file fd from offset on if fd
+ *         - is not negative, at *addr_store (anywhere if it is 0, and the address is
+ *         - stored back). A file is mapped privately: its pages are read on page fault,
+ *         - and writes to the mapping never go back to the file.
+ */
+int
+do_mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags, int fd, off_t offset) {
+    if (fd < 0) {
+        return do_mmap_area(addr_store, len, mmap_flags, NULL, NULL, 0);
+    }
+    if (offset < 0 || offset % PGSIZE != 0) {
+        return -E_INVAL;
+    }
+    int ret;
+    struct inode *node;
+    if ((ret = file_mmap_node(fd, &node)) != 0) {
+        return ret;
+    }
+    ret = do_mmap_area(addr_store, len, mmap_flags, NULL, node, offset / PGSIZE);
+    vop_ref_dec(node);
+    return ret;
+}
+
+// do_munmap - remove the mapping of [addr, addr + len) in the mm of current
+int
+do_munmap(uintptr_t addr, size_t len) {
+    struct mm_struct *mm = current->mm;
+    if (mm == NULL) {
+        panic("kernel thread call munmap!!.\n");
+    }
+    if (len == 0) {
+        return -E_INVAL;
+    }
+    int ret;
+    lock_mm(mm);
+    {
+        ret = mm_unmap(mm, addr, len);
+    }
+    unlock_mm(mm);
+    return ret;
+}
+
+/* do_shmem - create a shared memory object of len bytes and map it at *addr_store
+ *          - (anywhere if it is 0). The mapping is inherited by fork, so parent and
+ *          - child see the same pages.
+ */
+int
+do_shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags) {
+    if (len == 0) {
+        return -E_INVAL;
+    }
+    struct shmem_struct *shmem;
+    if ((shmem = shmem_create(len)) == NULL) {
+        return -E_NO_MEM;
+    }
+    int ret;
+    shmem_ref_inc(shmem);
+    ret = do_mmap_area(addr_store, len, mmap_flags, shmem, NULL, 0);
+    if (shmem_ref_dec(shmem) == 0) {
+        shmem_destroy(shmem);
+    }
+    return ret;
+}
@@ -6,6 +6,8 @@
 #include <trap.h>
 #include <memlayout.h>
 #include <skew_heap.h>
+#include <rb_tree.h>
+#include <schedstat.h>
 
 
 // process's state in his life cycle
@@ -66,16 +68,33 @@ struct proc_struct {
     skew_heap_entry_t lab6_run_pool;            // FOR LAB6 ONLY: the entry in the run pool
     uint32_t lab6_stride;                       // FOR LAB6 ONLY: the current stride of the process
     uint32_t lab6_priority;                     // FOR LAB6 ONLY: the priority of process, set by lab6_set_priority(uint32_t)
+    rb_node_t cfs_node;                         // CFS: the entry in the cfs tree
+    uint64_t cfs_vruntime;                      // CFS: weighted running time in nsec
+    uint64_t cfs_exec_start;                    // CFS: when the running time was last charged
+    uint64_t cfs_slice_exec;                    // CFS: nsec run since picked
+    uint32_t cfs_weight;                        // CFS: the weight counted in the run queue
+    int mlfq_level;                             // MLFQ: the queue level, 0 is the highest
+    uint32_t mlfq_boost_gen;                    // MLFQ: mlfq_boost_gen of the run queue at the last reset
+    struct schedstat sched_stat;                // scheduler accounting, see sched.c
+    uint64_t sched_stamp;                       // when the proc was last accounted
+    uint64_t sched_wakeup;                      // when the proc was woken up, 0 if not waiting to run after a wakeup
     struct files_struct *filesp;                // the file related info(pwd, files_count, files_array, fs_semaphore) of process
+    uintptr_t sysenter_eip;                     // user return address of sysenter (SYS_sysenter), 0 if not used
 };
 
 #define PF_EXITING                  0x00000001      // getting shutdown
+#define PF_DAEMON                   0x00000002      // kernel daemon, do_wait(0) does not wait for it
 
 #define WT_INTERRUPTED               0x80000000                    // the wait state could be interrupted
 #define WT_CHILD                    (0x00000001 | WT_INTERRUPTED)  // wait child process
 #define WT_KSEM                      0x00000100                    // wait kernel semaphore
+#define WT_KCV                       0x00000200                    // wait kernel condition variable
+#define WT_KRWSEM                    0x00000400                    // wait kernel reader-writer semaphore
 #define WT_TIMER                    (0x00000002 | WT_INTERRUPTED)  // wait timer
 #define WT_KBD                      (0x00000004 | WT_INTERRUPTED)  // wait the input of keyboard
+#define WT_DAEMON                   (0x00000008 | WT_INTERRUPTED)  // kernel daemon waits for work
+#define WT_PIPE                     (0x00000010 | WT_INTERRUPTED)  // wait for data or space in a pipe
+#define WT_FUTEX                    (0x00000020 | WT_INTERRUPTED)  // wait on a user futex
 
 #define le2proc(le, member)         \
     to_struct((le), struct proc_struct, member)
@@ -85,6 +104,8 @@ extern struct proc_struct *idleproc, *initproc, *current;
 void proc_init(void);
 void proc_run(struct proc_struct *proc);
 int kernel_thread(int (*fn)(void *), void *arg, uint32_t clone_flags);
+int kernel_daemon(int (*fn)(void *), void *arg, const char *name);
+int kernel_daemon_stop(int pid);
 
 char *set_proc_name(struct proc_struct *proc, const char *name);
 char *get_proc_name(struct proc_struct *proc);
@@ -100,5 +121,8 @@ int do_kill(int pid);
 //FOR LAB6, set the process's priority (bigger value will get more CPU time)
 void lab6_set_priority(uint32_t priority);
 int do_sleep(unsigned int time);
+int do_mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags, int fd, off_t offset);
+int do_munmap(uintptr_t addr, size_t len);
+int do_shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
 #endif /* !__KERN_PROCESS_PROC_H__ */
 
@@ -0,0 +1,193 @@
+#include <defs.h>
+#include <x86.h>
+#include <rb_tree.h>
+#include <timepage.h>
+#include <clock.h>
+#include <proc.h>
+#include <assert.h>
+#include <cfs_sched.h>
+
+/*
+ * Completely fair scheduler.
+ *
+ * Each process has a virtual runtime: the nsec it has run (read from the
+ * TSC clock, so not rounded to ticks), scaled down by its weight. The
+ * runnable processes are kept in a red-black tree ordered by vruntime and
+ * the leftmost one runs next. In cfs_latency nsec each runnable process
+ * gets a share of the cpu in proportion to its weight, but at least
+ * cfs_min_granularity.
+ *
+ * A process that wakes up gets its vruntime raised to cfs_min_vruntime
+ * less half of cfs_latency, so a sleeper gets a little credit but can not
+ * take the cpu for as long as it slept. A new process gets no such credit:
+ * it starts at cfs_min_vruntime, so forking can not be used to jump ahead of
+ * the running processes. A woken process preempts the current one if it is
+ * behind by more than cfs_wakeup_granularity.
+ */
+
+#define CFS_NICE_0_WEIGHT           1024                        // weight of priority 0 and 1
+#define CFS_MAX_PRIORITY            1024
+#define CFS_LATENCY                 (20 * NSEC_PER_MSEC)
+#define CFS_MIN_GRANULARITY         (4 * NSEC_PER_MSEC)
+#define CFS_WAKEUP_GRANULARITY      (1 * NSEC_PER_MSEC)
+
+#define le2cfs(node)                to_struct((node), struct proc_struct, cfs_node)
+
+static int
+cfs_vruntime_comp_f(rb_node_t *a, rb_node_t *b) {
+    int64_t c = le2cfs(a)->cfs_vruntime - le2cfs(b)->cfs_vruntime;
+    return (c < 0) ? -1 : (c > 0);
+}
+
+// cfs_weight - weight of proc, in proportion to its lab6 priority
+static uint32_t
+cfs_weight(struct proc_struct *proc) {
+    uint32_t priority = proc->lab6_priority;
+    if (priority == 0) {
+        priority = 1;
+    }
+    else if (priority > CFS_MAX_PRIORITY) {
+        priority = CFS_MAX_PRIORITY;
+    }
+    return priority * CFS_NICE_0_WEIGHT;
+}
+
+// cfs_update_curr - charge the running proc for the time since it was last charged
+static void
+cfs_update_curr(struct proc_struct *proc) {
+    uint64_t now = clock_nsec(), delta = now - proc->cfs_exec_start;
+    proc->cfs_exec_start = now;
+    proc->cfs_slice_exec += delta;
+    uint32_t weight = cfs_weight(proc);
+    if (weight != CFS_NICE_0_WEIGHT) {
+        delta *= CFS_NICE_0_WEIGHT;
+        do_div(delta, weight);
+    }
+    proc->cfs_vruntime += delta;
+}
+
+// cfs_update_min_vruntime - cfs_min_vruntime follows the smallest vruntime, never going back
+static void
+cfs_update_min_vruntime(struct run_queue *rq, struct proc_struct *curr) {
+    rb_node_t *left = rb_first(&(rq->cfs_tree));
+    uint64_t vruntime;
+    if (curr != NULL) {
+        vruntime = curr->cfs_vruntime;
+        if (left != NULL && (int64_t)(le2cfs(left)->cfs_vruntime - vruntime) < 0) {
+            vruntime = le2cfs(left)->cfs_vruntime;
+        }
+    }
+    else if (left != NULL) {
+        vruntime = le2cfs(left)->cfs_vruntime;
+    }
+    else {
+        return;
+    }
+    if ((int64_t)(vruntime - rq->cfs_min_vruntime) > 0) {
+        rq->cfs_min_vruntime = vruntime;
+    }
+}
+
+static void
+cfs_init(struct run_queue *rq) {
+    list_init(&(rq->run_list));
+    rb_tree_init(&(rq->cfs_tree));
+    rq->proc_num = 0;
+    rq->cfs_min_vruntime = 0;
+    rq->cfs_weight = 0;
+    rq->cfs_latency = CFS_LATENCY;
+    rq->cfs_min_granularity = CFS_MIN_GRANULARITY;
+    rq->cfs_wakeup_granularity = CFS_WAKEUP_GRANULARITY;
+}
+
+/*
+ * cfs_enqueue - put proc into the tree. A proc other than current is woken
+ *               up or new: place it at cfs_min_vruntime (less the sleeper
+ *               credit if it has run before, i.e. cfs_exec_start is set),
+ *               and preempt current if proc is well behind it.
+ */
+static void
+cfs_enqueue(struct run_queue *rq, struct proc_struct *proc) {
+    if (proc != current) {
+        uint64_t vruntime = rq->cfs_min_vruntime;
+        if (proc->cfs_exec_start != 0) {
+            vruntime -= rq->cfs_latency / 2;
+        }
+        if ((int64_t)(proc->cfs_vruntime - vruntime) < 0) {
+            proc->cfs_vruntime = vruntime;
+        }
+        if (current != idleproc && current->rq == rq) {
+            cfs_update_curr(current);
+            if ((int64_t)(current->cfs_vruntime - proc->cfs_vruntime) > (int64_t)rq->cfs_wakeup_granularity) {
+                current->need_resched = 1;
+            }
+        }
+    }
+    proc->cfs_weight = cfs_weight(proc);
+    rq->cfs_weight += proc->cfs_weight;
+    rb_insert(&(rq->cfs_tree), &(proc->cfs_node), cfs_vruntime_comp_f);
+    proc->rq = rq;
+    rq->proc_num ++;
+}
+
+static void
+cfs_dequeue(struct run_queue *rq, struct proc_struct *proc) {
+    assert(proc->rq == rq && rq->proc_num > 0);
+    rb_delete(&(rq->cfs_tree), &(proc->cfs_node));
+    rq->cfs_weight -= proc->cfs_weight;
+    rq->proc_num --;
+}
+
+// cfs_pick_next - the proc with the smallest vruntime, its slice starts now
+static struct proc_struct *
+cfs_pick_next(struct run_queue *rq) {
+    rb_node_t *left;
+    if ((left = rb_first(&(rq->cfs_tree))) == NULL) {
+        return NULL;
+    }
+    cfs_update_min_vruntime(rq, NULL);
+    struct proc_struct *proc = le2cfs(left);
+    uint64_t now = clock_nsec();
+    proc->cfs_exec_start = (now != 0) ? now : 1;
+    proc->cfs_slice_exec = 0;
+    return proc;
+}
+
+// cfs_put_prev - proc leaves the cpu, charge it for the rest of its run
+static void
+cfs_put_prev(struct run_queue *rq, struct proc_struct *proc) {
+    cfs_update_curr(proc);
+}
+
+/*
+ * cfs_proc_tick - charge the running proc, and reschedule once it has run
+ *                 its share of cfs_latency
+ */
+static void
+cfs_proc_tick(struct run_queue *rq, struct proc_struct *proc) {
+    cfs_update_curr(proc);
+    cfs_update_min_vruntime(rq, proc);
+    if (rq->proc_num == 0) {
+        return;
+    }
+    uint32_t weight = cfs_weight(proc);
+    uint64_t slice = (uint64_t)rq->cfs_latency * weight;
+    do_div(slice, rq->cfs_weight + weight);
+    if (slice < rq->cfs_min_granularity) {
+        slice = rq->cfs_min_granularity;
+    }
+    if (proc->cfs_slice_exec >= slice) {
+        proc->need_resched = 1;
+    }
+}
+
+struct sched_class cfs_sched_class = {
+    .name = "cfs_scheduler",
+    .init = cfs_init,
+    .enqueue = cfs_enqueue,
+    .dequeue = cfs_dequeue,
+    .pick_next = cfs_pick_next,
+    .put_prev = cfs_put_prev,
+    .proc_tick = cfs_proc_tick,
+};
+
@@ -0,0 +1,158 @@
+#include <defs.h>
+#include <list.h>
+#include <proc.h>
+#include <assert.h>
+#include <mlfq_sched.h>
+
+/*
+ * Multi-level feedback queue scheduler. It follows the rules of
+ * related_info/ostep/ostep9-mlfq.py without -S and -I, but not the script's
+ * default options (3 queues, a quantum of 10 at every level, no boost). The
+ * parameters are MLFQ_NQUEUE levels with a quantum of max_time_slice << level
+ * ticks, i.e. 5, 10, 20 and 40 (like -Q 5,10,20,40), and a boost every
+ * MLFQ_BOOST_TICKS ticks (like -B 100). The longer quanta at the lower levels
+ * keep the batch processes from switching too often; the boost keeps them
+ * from starving behind interactive ones.
+ *
+ * The rules are:
+ *
+ *   - a runnable process is in the round-robin queue of its level, and the
+ *     first process of the highest non-empty level runs. A bitmap of the
+ *     non-empty levels finds it in O(1).
+ *   - a new process starts at level 0, with an allotment of
+ *     max_time_slice << level ticks at each level. Sleeping does not give
+ *     the allotment back; once it is used up, the process moves down.
+ *   - a woken process goes to the back of its queue, and preempts the
+ *     running process if its level is higher.
+ *   - every MLFQ_BOOST_TICKS all processes go back to level 0. A sleeping
+ *     process sees the boost through mlfq_boost_gen when it wakes up.
+ */
+
+#define MLFQ_BOOST_TICKS            100
+
+#define le2mlfq(le)                 le2proc((le), run_link)
+
+static inline int
+mlfq_quantum(struct run_queue *rq, int level) {
+    return rq->max_time_slice << level;
+}
+
+// mlfq_reset - move proc to level 0 with a full allotment
+static inline void
+mlfq_reset(struct run_queue *rq, struct proc_struct *proc) {
+    proc->mlfq_level = 0;
+    proc->time_slice = mlfq_quantum(rq, 0);
+    proc->mlfq_boost_gen = rq->mlfq_boost_gen;
+}
+
+static inline void
+mlfq_queue_add(struct run_queue *rq, struct proc_struct *proc) {
+    int level = proc->mlfq_level;
+    list_add_before(&(rq->mlfq_queue[level]), &(proc->run_link));
+    rq->mlfq_bitmap |= (1 << level);
+}
+
+// mlfq_boost - put all queued processes to level 0, the others follow on wakeup
+static void
+mlfq_boost(struct run_queue *rq) {
+    rq->mlfq_boost_gen ++;
+    int level;
+    for (level = 1; level < MLFQ_NQUEUE; level ++) {
+        list_entry_t *list = &(rq->mlfq_queue[level]), *le;
+        while ((le = list_next(list)) != list) {
+            struct proc_struct *proc = le2mlfq(le);
+            list_del(le);
+            mlfq_reset(rq, proc);
+            mlfq_queue_add(rq, proc);
+        }
+    }
+    rq->mlfq_bitmap &= 1;
+}
+
+static void
+mlfq_init(struct run_queue *rq) {
+    list_init(&(rq->run_list));
+    int level;
+    for (level = 0; level < MLFQ_NQUEUE; level ++) {
+        list_init(&(rq->mlfq_queue[level]));
+    }
+    rq->mlfq_bitmap = 0;
+    rq->mlfq_boost_gen = 0;
+    rq->mlfq_boost_left = MLFQ_BOOST_TICKS;
+    rq->proc_num = 0;
+}
+
+static void
+mlfq_enqueue(struct run_queue *rq, struct proc_struct *proc) {
+    assert(list_empty(&(proc->run_link)));
+    if (proc->time_slice == 0 || proc->mlfq_boost_gen != rq->mlfq_boost_gen) {
+        mlfq_reset(rq, proc);
+    }
+    mlfq_queue_add(rq, proc);
+    if (proc != current && current != idleproc && current->rq == rq) {
+        if (proc->mlfq_level < current->mlfq_level) {
+            current->need_resched = 1;
+        }
+    }
+    proc->rq = rq;
+    rq->proc_num ++;
+}
+
+static void
+mlfq_dequeue(struct run_queue *rq, struct proc_struct *proc) {
+    assert(!list_empty(&(proc->run_link)) && proc->rq == rq);
+    list_del_init(&(proc->run_link));
+    int level = proc->mlfq_level;
+    if (list_empty(&(rq->mlfq_queue[level]))) {
+        rq->mlfq_bitmap &= ~(1 << level);
+    }
+    rq->proc_num --;
+}
+
+// mlfq_pick_next - the first process of the highest non-empty level
+static struct proc_struct *
+mlfq_pick_next(struct run_queue *rq) {
+    if (rq->mlfq_bitmap == 0) {
+        return NULL;
+    }
+    int level = __builtin_ctz(rq->mlfq_bitmap);
+    return le2mlfq(list_next(&(rq->mlfq_queue[level])));
+}
+
+/*
+ * mlfq_proc_tick - boost every MLFQ_BOOST_TICKS; charge the running proc,
+ *                  and move it down once its allotment is used up
+ */
+static void
+mlfq_proc_tick(struct run_queue *rq, struct proc_struct *proc) {
+    if (-- rq->mlfq_boost_left == 0) {
+        rq->mlfq_boost_left = MLFQ_BOOST_TICKS;
+        mlfq_boost(rq);
+    }
+    if (proc->mlfq_boost_gen != rq->mlfq_boost_gen) {
+        mlfq_reset(rq, proc);
+    }
+    if (proc->time_slice > 0) {
+        proc->time_slice --;
+    }
+    if (proc->time_slice == 0) {
+        if (proc->mlfq_level < MLFQ_NQUEUE - 1) {
+            proc->mlfq_level ++;
+        }
+        proc->time_slice = mlfq_quantum(rq, proc->mlfq_level);
+        proc->need_resched = 1;
+    }
+    if (rq->mlfq_bitmap & ((1 << proc->mlfq_level) - 1)) {
+        proc->need_resched = 1;
+    }
+}
+
+struct sched_class mlfq_sched_class = {
+    .name = "mlfq_scheduler",
+    .init = mlfq_init,
+    .enqueue = mlfq_enqueue,
+    .dequeue = mlfq_dequeue,
+    .pick_next = mlfq_pick_next,
+    .proc_tick = mlfq_proc_tick,
+};
+
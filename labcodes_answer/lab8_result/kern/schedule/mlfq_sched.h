@@ -0,0 +1,9 @@
+#ifndef __KERN_SCHEDULE_MLFQ_SCHED_H__
+#define __KERN_SCHEDULE_MLFQ_SCHED_H__
+
+#include <sched.h>
+
+extern struct sched_class mlfq_sched_class;
+
+#endif /* !__KERN_SCHEDULE_MLFQ_SCHED_H__ */
+
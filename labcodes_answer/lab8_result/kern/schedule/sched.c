@@ -4,7 +4,20 @@
 #include <sched.h>
 #include <stdio.h>
 #include <assert.h>
+#include <string.h>
+#include <x86.h>
+#include <clock.h>
+#include <error.h>
+#include <trace.h>
 #include <default_sched.h>
+#include <cfs_sched.h>
+#include <mlfq_sched.h>
+
+// the sched_class used: default_sched_class (stride), cfs_sched_class or mlfq_sched_class,
+// e.g. make "DEFS+=-DSCHED_CLASS=cfs_sched_class"
+#ifndef SCHED_CLASS
+#define SCHED_CLASS                     default_sched_class
+#endif
 
 static list_entry_t timer_list;
 
@@ -12,6 +25,81 @@ static struct sched_class *sched_class;
 
 static struct run_queue *rq;
 
+/*
+ * Scheduler accounting: the time since sched_stamp of a proc is charged to
+ * its state when the state changes, i.e. in wakeup_proc and at a context
+ * switch in proc_run (sched_stat_switch). sched_stat sums all processes but
+ * idleproc.
+ */
+static struct schedstat sched_stat;
+
+// sched_stat_charge - charge the time since the last accounting of proc to its state
+static void
+sched_stat_charge(struct proc_struct *proc, uint64_t now) {
+    uint64_t delta = now - proc->sched_stamp;
+    proc->sched_stamp = now;
+    uint64_t *pstat = &(proc->sched_stat.sleep_nsec), *gstat = &(sched_stat.sleep_nsec);
+    if (proc == current) {
+        pstat = &(proc->sched_stat.run_nsec), gstat = &(sched_stat.run_nsec);
+    }
+    else if (proc->state == PROC_RUNNABLE) {
+        pstat = &(proc->sched_stat.wait_nsec), gstat = &(sched_stat.wait_nsec);
+    }
+    *pstat += delta;
+    if (proc != idleproc) {
+        *gstat += delta;
+    }
+}
+
+// sched_stat_bucket - the bucket of a latency in the latency histogram
+static inline int
+sched_stat_bucket(uint64_t nsec) {
+    if (nsec >= (uint64_t)1000 << (SCHEDSTAT_NBUCKET - 1)) {
+        return SCHEDSTAT_NBUCKET - 1;
+    }
+    uint32_t usec = (uint32_t)nsec / 1000;
+    return (usec == 0) ? 0 : 32 - __builtin_clz(usec);
+}
+
+/*
+ * sched_stat_switch - called by proc_run before switching from prev to next:
+ *                     prev leaves the cpu, next ends its wait for the cpu
+ */
+void
+sched_stat_switch(struct proc_struct *prev, struct proc_struct *next) {
+    uint64_t now = clock_nsec();
+    assert(prev == current);
+    sched_stat_charge(prev, now);
+    sched_stat_charge(next, now);
+    if (prev->state == PROC_RUNNABLE && prev != idleproc) {
+        prev->sched_stat.npreempt ++, sched_stat.npreempt ++;
+    }
+    next->sched_stat.nswitch ++, sched_stat.nswitch ++;
+    if (next->sched_wakeup != 0) {
+        uint64_t latency = now - next->sched_wakeup;
+        int bucket = sched_stat_bucket(latency);
+        next->sched_wakeup = 0;
+        next->sched_stat.latency_hist[bucket] ++, sched_stat.latency_hist[bucket] ++;
+        if (latency > next->sched_stat.max_latency_nsec) {
+            next->sched_stat.max_latency_nsec = latency;
+        }
+        if (latency > sched_stat.max_latency_nsec) {
+            sched_stat.max_latency_nsec = latency;
+        }
+    }
+}
+
+// sched_stat_wakeup - called by wakeup_proc before proc becomes runnable
+static void
+sched_stat_wakeup(struct proc_struct *proc) {
+    uint64_t now = clock_nsec();
+    sched_stat_charge(proc, now);
+    proc->sched_stat.nwakeup ++, sched_stat.nwakeup ++;
+    if (proc != current) {
+        proc->sched_wakeup = (now != 0) ? now : 1;
+    }
+}
+
 static inline void
 sched_class_enqueue(struct proc_struct *proc) {
     if (proc != idleproc) {
@@ -29,6 +117,13 @@ sched_class_pick_next(void) {
     return sched_class->pick_next(rq);
 }
 
+static inline void
+sched_class_put_prev(struct proc_struct *proc) {
+    if (proc != idleproc && sched_class->put_prev != NULL) {
+        sched_class->put_prev(rq, proc);
+    }
+}
+
 static void
 sched_class_proc_tick(struct proc_struct *proc) {
     if (proc != idleproc) {
@@ -45,7 +140,7 @@ void
 sched_init(void) {
     list_init(&timer_list);
 
-    sched_class = &default_sched_class;
+    sched_class = &SCHED_CLASS;
 
     rq = &__rq;
     rq->max_time_slice = 5;
@@ -61,11 +156,17 @@ wakeup_proc(struct proc_struct *proc) {
     local_intr_save(intr_flag);
     {
         if (proc->state != PROC_RUNNABLE) {
+            trace(TRACE_SCHED_WAKEUP, proc->pid, proc->wait_state, 0, 0);
+            sched_stat_wakeup(proc);
             proc->state = PROC_RUNNABLE;
             proc->wait_state = 0;
             if (proc != current) {
                 sched_class_enqueue(proc);
             }
+            // let the idle process leave hlt at once
+            if (current == idleproc) {
+                idleproc->need_resched = 1;
+            }
         }
         else {
             warn("wakeup runnable process.\n");
@@ -80,7 +181,10 @@ schedule(void) {
     struct proc_struct *next;
     local_intr_save(intr_flag);
     {
+        // the ticks of a one-shot run by current are charged to it
+        clock_sync();
         current->need_resched = 0;
+        sched_class_put_prev(current);
         if (current->state == PROC_RUNNABLE) {
             sched_class_enqueue(current);
         }
@@ -98,11 +202,19 @@ schedule(void) {
     local_intr_restore(intr_flag);
 }
 
+// sched_runnable - is any process other than current waiting to run
+bool
+sched_runnable(void) {
+    return rq->proc_num != 0;
+}
+
 void
 add_timer(timer_t *timer) {
     bool intr_flag;
     local_intr_save(intr_flag);
     {
+        // expires counts from now, not from the start of a running one-shot
+        clock_sync();
         assert(timer->expires > 0 && timer->proc != NULL);
         assert(list_empty(&(timer->timer_link)));
         list_entry_t *le = list_next(&timer_list);
@@ -139,16 +251,42 @@ del_timer(timer_t *timer) {
     local_intr_restore(intr_flag);
 }
 
-void
-run_timer_list(void) {
+// timer_next_expires - # of ticks until the first timer expires, 0 if there is none
+unsigned int
+timer_next_expires(void) {
+    unsigned int expires = 0;
     bool intr_flag;
     local_intr_save(intr_flag);
     {
         list_entry_t *le = list_next(&timer_list);
         if (le != &timer_list) {
+            expires = le2timer(le, timer_link)->expires;
+        }
+    }
+    local_intr_restore(intr_flag);
+    return expires;
+}
+
+// run_timer_list - nticks have passed (more than one after a one-shot of the clock)
+void
+run_timer_list(unsigned int nticks) {
+    if (nticks == 0) {
+        return;
+    }
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        unsigned int i, ntotal = nticks;
+        list_entry_t *le;
+        while (nticks > 0 && (le = list_next(&timer_list)) != &timer_list) {
             timer_t *timer = le2timer(le, timer_link);
             assert(timer->expires != 0);
-            timer->expires --;
+            if (timer->expires > nticks) {
+                timer->expires -= nticks;
+                break;
+            }
+            nticks -= timer->expires;
+            timer->expires = 0;
             while (timer->expires == 0) {
                 le = list_next(le);
                 struct proc_struct *proc = timer->proc;
@@ -166,7 +304,83 @@ run_timer_list(void) {
                 timer = le2timer(le, timer_link);
             }
         }
-        sched_class_proc_tick(current);
+        // each tick is charged, a time_slice runs out at the same tick as without one-shots
+        unsigned int nrunnable = rq->proc_num;
+        if (nrunnable >= SCHEDSTAT_NBUCKET) {
+            nrunnable = SCHEDSTAT_NBUCKET - 1;
+        }
+        for (i = 0; i < ntotal; i ++) {
+            sched_class_proc_tick(current);
+            sched_stat.nrunnable_hist[nrunnable] ++;
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+/*
+ * sched_getstat - copy the scheduler accounting of process pid, or of all
+ *                 processes if pid is 0, to stat
+ */
+int
+sched_getstat(int pid, struct schedstat *stat) {
+    int ret = 0;
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        struct proc_struct *proc;
+        if (pid == 0) {
+            *stat = sched_stat;
+        }
+        else if ((proc = find_proc(pid)) != NULL) {
+            sched_stat_charge(proc, clock_nsec());
+            *stat = proc->sched_stat;
+        }
+        else {
+            ret = -E_INVAL;
+        }
+    }
+    local_intr_restore(intr_flag);
+    return ret;
+}
+
+static void
+sched_print_one(const char *name, int pid, struct schedstat *stat) {
+    uint64_t run = stat->run_nsec, wait = stat->wait_nsec, sleep = stat->sleep_nsec;
+    uint64_t latency = stat->max_latency_nsec;
+    do_div(run, 1000), do_div(wait, 1000), do_div(sleep, 1000), do_div(latency, 1000);
+    cprintf("%5d %-12s %10llu %10llu %10llu %7u %7u %7u %8llu\n", pid, name, run, wait,
+            sleep, stat->nswitch, stat->npreempt, stat->nwakeup, latency);
+}
+
+static void
+sched_print_hist(const char *name, uint32_t *hist) {
+    int i;
+    cprintf("%s:", name);
+    for (i = 0; i < SCHEDSTAT_NBUCKET; i ++) {
+        cprintf(" %u", hist[i]);
+    }
+    cprintf("\n");
+}
+
+// sched_print_stat - print the scheduler accounting of all processes, times in usec
+void
+sched_print_stat(void) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        uint64_t now = clock_nsec();
+        cprintf("  pid name                run       wait      sleep  switch preempt  wakeup  max lat\n");
+        sched_stat_charge(idleproc, now);
+        sched_print_one(idleproc->name, idleproc->pid, &(idleproc->sched_stat));
+        list_entry_t *list = &proc_list, *le = list;
+        while ((le = list_next(le)) != list) {
+            struct proc_struct *proc = le2proc(le, list_link);
+            sched_stat_charge(proc, now);
+            sched_print_one(proc->name, proc->pid, &(proc->sched_stat));
+        }
+        sched_print_one("(all)", 0, &sched_stat);
+        sched_print_hist("wakeup latency (log2 usec)", sched_stat.latency_hist);
+        sched_print_hist("runnable procs at tick", sched_stat.nrunnable_hist);
     }
     local_intr_restore(intr_flag);
 }
@@ -4,6 +4,8 @@
 #include <defs.h>
 #include <list.h>
 #include <skew_heap.h>
+#include <rb_tree.h>
+#include <schedstat.h>
 
 struct proc_struct;
 
@@ -40,6 +42,8 @@ struct sched_class {
     void (*dequeue)(struct run_queue *rq, struct proc_struct *proc);
     // choose the next runnable task
     struct proc_struct *(*pick_next)(struct run_queue *rq);
+    // the proc leaves the cpu, before it is put into runqueue again (may be NULL)
+    void (*put_prev)(struct run_queue *rq, struct proc_struct *proc);
     // dealer of the time-tick
     void (*proc_tick)(struct run_queue *rq, struct proc_struct *proc);
     /* for SMP support in the future
@@ -51,20 +55,40 @@ struct sched_class {
      */
 };
 
+#define MLFQ_NQUEUE                     4       // # of levels of the mlfq scheduler
+
 struct run_queue {
     list_entry_t run_list;
     unsigned int proc_num;
     int max_time_slice;
     // For LAB6 ONLY
     skew_heap_entry_t *lab6_run_pool;
+    // For the cfs scheduler, times in nsec
+    rb_tree_t cfs_tree;
+    uint64_t cfs_min_vruntime;
+    uint32_t cfs_weight;                // total weight of the procs in cfs_tree
+    uint32_t cfs_latency;               // each runnable proc runs once in this time
+    uint32_t cfs_min_granularity;       // shortest time to run before preempted
+    uint32_t cfs_wakeup_granularity;    // a woken proc preempts if behind by more
+    // For the mlfq scheduler
+    list_entry_t mlfq_queue[MLFQ_NQUEUE];
+    uint32_t mlfq_bitmap;               // bit i is set if mlfq_queue[i] is not empty
+    uint32_t mlfq_boost_gen;            // # of priority boosts
+    int mlfq_boost_left;                // ticks until the next boost
 };
 
 void sched_init(void);
 void wakeup_proc(struct proc_struct *proc);
 void schedule(void);
+bool sched_runnable(void);
 void add_timer(timer_t *timer);
 void del_timer(timer_t *timer);
-void run_timer_list(void);
+unsigned int timer_next_expires(void);
+void run_timer_list(unsigned int nticks);
+
+void sched_stat_switch(struct proc_struct *prev, struct proc_struct *next);
+int sched_getstat(int pid, struct schedstat *stat);
+void sched_print_stat(void);
 
 #endif /* !__KERN_SCHEDULE_SCHED_H__ */
 
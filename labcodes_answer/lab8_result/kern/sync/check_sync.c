@@ -2,6 +2,8 @@
 #include <proc.h>
 #include <sem.h>
 #include <monitor.h>
+#include <cv.h>
+#include <sched.h>
 #include <assert.h>
 
 #define N 5 /* 哲学家数目 */
@@ -241,6 +243,173 @@ int philosopher_using_condvar(void * arg) { /* arg is the No. of philosopher 0~N
     return 0;    
 }
 
+//---------- philosophers using Mesa condition variables ----------------------
+/* The same as the monitor, but a signal only wakes the neighbor up: it takes the
+ * mutex again when it runs, and checks its state in a loop.
+ */
+struct proc_struct *philosopher_proc_cv[N];
+int state_cv[N];
+semaphore_t cv_mutex;
+cv_t self_cv[N];
+
+void phi_test_cv(int i) {
+    if(state_cv[i]==HUNGRY&&state_cv[LEFT]!=EATING
+            &&state_cv[RIGHT]!=EATING) {
+        state_cv[i] = EATING;
+        cv_signal(&self_cv[i]);
+    }
+}
+
+void phi_take_forks_cv(int i) {
+    down(&cv_mutex);
+    state_cv[i]=HUNGRY;
+    phi_test_cv(i);
+    while (state_cv[i] != EATING) {
+        cv_wait(&self_cv[i], &cv_mutex);
+    }
+    up(&cv_mutex);
+}
+
+void phi_put_forks_cv(int i) {
+    down(&cv_mutex);
+    state_cv[i]=THINKING;
+    phi_test_cv(LEFT);
+    phi_test_cv(RIGHT);
+    up(&cv_mutex);
+}
+
+int philosopher_using_cv(void * arg) { /* arg is the No. of philosopher 0~N-1*/
+    int i, iter=0;
+    i=(int)arg;
+    cprintf("I am No.%d philosopher_cv\n",i);
+    while(iter++<TIMES)
+    {
+        cprintf("Iter %d, No.%d philosopher_cv is thinking\n",iter,i);
+        do_sleep(SLEEP_TIME);
+        phi_take_forks_cv(i);
+        cprintf("Iter %d, No.%d philosopher_cv is eating\n",iter,i);
+        do_sleep(SLEEP_TIME);
+        phi_put_forks_cv(i);
+    }
+    cprintf("No.%d philosopher_cv quit\n",i);
+    return 0;
+}
+
+//---------- bounded buffer: context switches of monitor vs Mesa condvar ----------
+/* A producer and a consumer pass BB_NITEM items through a buffer of BB_SIZE
+ * slots, once in a monitor and once with cv_t. The context switches to both
+ * threads are counted from their schedstat.
+ */
+#define BB_SIZE     4
+#define BB_NITEM    256
+
+static int bb_buf[BB_SIZE], bb_count, bb_in, bb_out;
+static monitor_t bb_mt;                         // cv[0]: not full, cv[1]: not empty
+static semaphore_t bb_mutex;
+static cv_t bb_notfull, bb_notempty;
+static semaphore_t bb_done;
+static int bb_nswitch;
+
+static void bb_account(void) {
+    struct schedstat stat;
+    if (sched_getstat(current->pid, &stat) == 0) {
+        bb_nswitch += stat.nswitch;
+    }
+    up(&bb_done);
+}
+
+static void bb_leave_monitor(void) {
+    if(bb_mt.next_count>0)
+        up(&(bb_mt.next));
+    else
+        up(&(bb_mt.mutex));
+}
+
+static int bb_producer_monitor(void *arg) {
+    int i;
+    for (i = 0; i < BB_NITEM; i ++) {
+        down(&(bb_mt.mutex));
+        if (bb_count == BB_SIZE) {
+            cond_wait(&(bb_mt.cv[0]));
+        }
+        bb_buf[bb_in ++ % BB_SIZE] = i, bb_count ++;
+        cond_signal(&(bb_mt.cv[1]));
+        bb_leave_monitor();
+    }
+    bb_account();
+    return 0;
+}
+
+static int bb_consumer_monitor(void *arg) {
+    int i;
+    for (i = 0; i < BB_NITEM; i ++) {
+        down(&(bb_mt.mutex));
+        if (bb_count == 0) {
+            cond_wait(&(bb_mt.cv[1]));
+        }
+        assert(bb_buf[bb_out ++ % BB_SIZE] == i);
+        bb_count --;
+        cond_signal(&(bb_mt.cv[0]));
+        bb_leave_monitor();
+    }
+    bb_account();
+    return 0;
+}
+
+static int bb_producer_cv(void *arg) {
+    int i;
+    for (i = 0; i < BB_NITEM; i ++) {
+        down(&bb_mutex);
+        while (bb_count == BB_SIZE) {
+            cv_wait(&bb_notfull, &bb_mutex);
+        }
+        bb_buf[bb_in ++ % BB_SIZE] = i, bb_count ++;
+        cv_signal(&bb_notempty);
+        up(&bb_mutex);
+    }
+    bb_account();
+    return 0;
+}
+
+static int bb_consumer_cv(void *arg) {
+    int i;
+    for (i = 0; i < BB_NITEM; i ++) {
+        down(&bb_mutex);
+        while (bb_count == 0) {
+            cv_wait(&bb_notempty, &bb_mutex);
+        }
+        assert(bb_buf[bb_out ++ % BB_SIZE] == i);
+        bb_count --;
+        cv_signal(&bb_notfull);
+        up(&bb_mutex);
+    }
+    bb_account();
+    return 0;
+}
+
+static int bb_run(int (*producer)(void *), int (*consumer)(void *)) {
+    bb_count = bb_in = bb_out = bb_nswitch = 0;
+    if (kernel_thread(consumer, NULL, 0) <= 0 || kernel_thread(producer, NULL, 0) <= 0) {
+        panic("create bounded buffer threads failed.\n");
+    }
+    down(&bb_done);
+    down(&bb_done);
+    return bb_nswitch;
+}
+
+static int bb_bench(void *arg) {
+    sem_init(&bb_done, 0);
+    monitor_init(&bb_mt, 2);
+    int monitor_nswitch = bb_run(bb_producer_monitor, bb_consumer_monitor);
+    sem_init(&bb_mutex, 1);
+    cv_init(&bb_notfull);
+    cv_init(&bb_notempty);
+    int cv_nswitch = bb_run(bb_producer_cv, bb_consumer_cv);
+    cprintf("bounded buffer: %d items, %d switches with monitor, %d with Mesa condvar.\n",
+            BB_NITEM, monitor_nswitch, cv_nswitch);
+    return 0;
+}
+
 void check_sync(void){
 
     int i;
@@ -268,4 +437,21 @@ void check_sync(void){
         philosopher_proc_condvar[i] = find_proc(pid);
         set_proc_name(philosopher_proc_condvar[i], "philosopher_condvar_proc");
     }
+
+    //check Mesa condition variable
+    sem_init(&cv_mutex, 1);
+    for(i=0;i<N;i++){
+        state_cv[i]=THINKING;
+        cv_init(&self_cv[i]);
+        int pid = kernel_thread(philosopher_using_cv, (void *)i, 0);
+        if (pid <= 0) {
+            panic("create No.%d philosopher_using_cv failed.\n");
+        }
+        philosopher_proc_cv[i] = find_proc(pid);
+        set_proc_name(philosopher_proc_cv[i], "philosopher_cv_proc");
+    }
+
+    if (kernel_thread(bb_bench, NULL, 0) <= 0) {
+        panic("create bounded buffer bench failed.\n");
+    }
 }
@@ -0,0 +1,57 @@
+#include <defs.h>
+#include <wait.h>
+#include <sem.h>
+#include <cv.h>
+#include <proc.h>
+#include <sched.h>
+#include <sync.h>
+#include <assert.h>
+
+void
+cv_init(cv_t *cv) {
+    wait_queue_init(&(cv->wait_queue));
+}
+
+/*
+ * cv_wait - the waiter is queued before mutex is released, both with interrupts
+ *           disabled, so a cv_signal after up(mutex) can not be lost.
+ */
+void
+cv_wait(cv_t *cv, semaphore_t *mutex) {
+    bool intr_flag;
+    wait_t __wait, *wait = &__wait;
+    local_intr_save(intr_flag);
+    {
+        wait_current_set(&(cv->wait_queue), wait, WT_KCV);
+        up(mutex);
+    }
+    local_intr_restore(intr_flag);
+
+    schedule();
+
+    local_intr_save(intr_flag);
+    wait_current_del(&(cv->wait_queue), wait);
+    local_intr_restore(intr_flag);
+    assert(wait->wakeup_flags == WT_KCV);
+    down(mutex);
+}
+
+void
+cv_signal(cv_t *cv) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        wakeup_first(&(cv->wait_queue), WT_KCV, 1);
+    }
+    local_intr_restore(intr_flag);
+}
+
+void
+cv_broadcast(cv_t *cv) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        wakeup_queue(&(cv->wait_queue), WT_KCV, 1);
+    }
+    local_intr_restore(intr_flag);
+}
@@ -0,0 +1,37 @@
+#ifndef __KERN_SYNC_CV_H__
+#define __KERN_SYNC_CV_H__
+
+#include <defs.h>
+#include <wait.h>
+#include <sem.h>
+
+/*
+ * Condition variables with Mesa semantics.
+ *
+ * Unlike cond_signal of a monitor (Hoare semantics, see monitor.h), cv_signal
+ * and cv_broadcast only make the waiters runnable: the signaller keeps the
+ * mutex and runs on, and a woken waiter takes the mutex again when it gets the
+ * cpu. So the condition must be checked again after cv_wait returns:
+ *
+ *     down(&mutex);
+ *     while (!condition) {
+ *         cv_wait(&cv, &mutex);
+ *     }
+ *     ...
+ *     up(&mutex);
+ *
+ * The mutex is a kernel semaphore initialized to 1.
+ */
+typedef struct {
+    wait_queue_t wait_queue;
+} cv_t;
+
+void cv_init(cv_t *cv);
+// Atomically release mutex and sleep on cv, hold mutex again on return.
+void cv_wait(cv_t *cv, semaphore_t *mutex);
+// Wake up one waiter on cv, if any.
+void cv_signal(cv_t *cv);
+// Wake up all waiters on cv.
+void cv_broadcast(cv_t *cv);
+
+#endif /* !__KERN_SYNC_CV_H__ */
@@ -0,0 +1,178 @@
+#include <defs.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <wait.h>
+#include <sync.h>
+#include <proc.h>
+#include <sched.h>
+#include <vmm.h>
+#include <futex.h>
+#include <error.h>
+#include <assert.h>
+
+/*
+ * Futexes: a user word to sleep on. FUTEX_WAIT sleeps only if the word still
+ * holds the value the caller saw, FUTEX_WAKE wakes waiters of the word; the
+ * user side does everything else with atomic instructions (see
+ * user/libs/lock.h), so an uncontended lock never enters the kernel.
+ *
+ * A futex is named by the mm and user address of its word, or by the shmem
+ * object and offset if the word is in a shared mapping, so processes sharing
+ * memory through shmem/mmap find the same futex. The waiters hang in a hash
+ * table of wait queues.
+ *
+ * The kernel is not preempted and this is one cpu: nothing can run between
+ * reading the word and adding the waiter to its queue, so a wakeup can not
+ * get lost.
+ */
+
+#define FUTEX_HASH_SHIFT            6
+#define FUTEX_HASH_SIZE             (1 << FUTEX_HASH_SHIFT)
+
+struct futex_key {
+    void *object;                   // the mm, or the shmem of a shared mapping
+    uintptr_t offset;               // the user address, or the offset in the shmem
+};
+
+typedef struct {
+    wait_t wait;
+    struct futex_key key;
+} futex_wait_t;
+
+#define le2futex(wait)              to_struct((wait), futex_wait_t, wait)
+
+static wait_queue_t futex_queues[FUTEX_HASH_SIZE];
+
+static inline wait_queue_t *
+futex_queue(struct futex_key *key) {
+    return futex_queues + hash32((uintptr_t)key->object + key->offset, FUTEX_HASH_SHIFT);
+}
+
+/*
+ * futex_get_key - the key of the futex at uaddr in mm, and its value if
+ *                 val_store is not NULL. Called with mm locked.
+ */
+static int
+futex_get_key(struct mm_struct *mm, uintptr_t uaddr, struct futex_key *key, uint32_t *val_store) {
+    struct vma_struct *vma;
+    if (uaddr % sizeof(uint32_t) != 0) {
+        return -E_INVAL;
+    }
+    if ((vma = find_vma(mm, uaddr)) == NULL || vma->vm_start > uaddr) {
+        return -E_INVAL;
+    }
+    if (vma->shmem != NULL) {
+        key->object = vma->shmem;
+        key->offset = vma->vm_pgoff * PGSIZE + (uaddr - vma->vm_start);
+    }
+    else {
+        key->object = mm, key->offset = uaddr;
+    }
+    if (val_store != NULL && !copy_from_user(mm, val_store, (void *)uaddr, sizeof(uint32_t), 0)) {
+        return -E_INVAL;
+    }
+    return 0;
+}
+
+/*
+ * futex_wait - sleep on the futex key if *uaddr is val, at most timeout ticks
+ *              (0: no limit). Returns -E_AGAIN if the value has changed.
+ */
+static int
+futex_wait(struct futex_key *key, uint32_t cur, uint32_t val, unsigned int timeout) {
+    if (cur != val) {
+        return -E_AGAIN;
+    }
+    wait_queue_t *queue = futex_queue(key);
+    futex_wait_t __fwait, *fwait = &__fwait;
+    timer_t __timer, *timer = &__timer;
+    fwait->key = *key;
+
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    // exclusive: futex_wake takes the waiters in the order of priority
+    wait_current_set_exclusive(queue, &(fwait->wait), WT_FUTEX);
+    if (timeout != 0) {
+        add_timer(timer_init(timer, current, timeout));
+    }
+    local_intr_restore(intr_flag);
+
+    schedule();
+
+    local_intr_save(intr_flag);
+    if (timeout != 0) {
+        del_timer(timer);
+    }
+    wait_current_del(queue, &(fwait->wait));
+    local_intr_restore(intr_flag);
+
+    if (fwait->wait.wakeup_flags == WT_FUTEX) {
+        return 0;
+    }
+    return (current->flags & PF_EXITING) ? -E_KILLED : -E_TIMEOUT;
+}
+
+// futex_wake - wake at most n waiters of the futex key, returns the # woken up
+static int
+futex_wake(struct futex_key *key, uint32_t n) {
+    wait_queue_t *queue = futex_queue(key);
+    int woken = 0;
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        wait_t *wait = wait_queue_first(queue), *next;
+        for (; wait != NULL && woken < n; wait = next) {
+            next = wait_queue_next(queue, wait);
+            struct futex_key *wkey = &(le2futex(wait)->key);
+            // skip a waiter already woken by its timeout or a kill
+            if (wait->proc->wait_state != WT_FUTEX) {
+                continue;
+            }
+            if (wkey->object == key->object && wkey->offset == key->offset) {
+                wakeup_wait(queue, wait, WT_FUTEX, 1);
+                woken ++;
+            }
+        }
+    }
+    local_intr_restore(intr_flag);
+    return woken;
+}
+
+/*
+ * do_futex - FUTEX_WAIT: sleep while the user word at uaddr is val, at most
+ *            timeout ticks if not 0. FUTEX_WAKE: wake up to val waiters.
+ */
+int
+do_futex(uintptr_t uaddr, int op, uint32_t val, unsigned int timeout) {
+    struct mm_struct *mm = current->mm;
+    struct futex_key key;
+    uint32_t cur;
+    int ret;
+    if (mm == NULL) {
+        return -E_INVAL;
+    }
+    if (op != FUTEX_WAIT && op != FUTEX_WAKE) {
+        return -E_INVAL;
+    }
+    lock_mm_shared(mm);
+    {
+        ret = futex_get_key(mm, uaddr, &key, (op == FUTEX_WAIT) ? &cur : NULL);
+    }
+    unlock_mm_shared(mm);
+    if (ret != 0) {
+        return ret;
+    }
+    if (op == FUTEX_WAIT) {
+        return futex_wait(&key, cur, val, timeout);
+    }
+    return futex_wake(&key, val);
+}
+
+void
+futex_init(void) {
+    int i;
+    for (i = 0; i < FUTEX_HASH_SIZE; i ++) {
+        wait_queue_init(futex_queues + i);
+    }
+}
+
@@ -22,11 +22,12 @@ monitor_init (monitor_t * mtp, size_t num_cv) {
     }
 }
 
-// Unlock one of threads waiting on the condition variable. 
+// Unlock one of threads waiting on the condition variable. Hoare semantics: the
+// signaller hands the monitor over and sleeps on next until the waiter leaves it,
+// two context switches per signal. See cv.h for Mesa condition variables.
 void 
 cond_signal (condvar_t *cvp) {
    //LAB7 EXERCISE1: YOUR CODE
-   cprintf("cond_signal begin: cvp %x, cvp->count %d, cvp->owner->next_count %d\n", cvp, cvp->count, cvp->owner->next_count);  
   /*
    *      cond_signal(cv) {
    *          if(cv.count>0) {
@@ -43,7 +44,6 @@ cond_signal (condvar_t *cvp) {
         down(&(cvp->owner->next));
         cvp->owner->next_count --;
       }
-   cprintf("cond_signal end: cvp %x, cvp->count %d, cvp->owner->next_count %d\n", cvp, cvp->count, cvp->owner->next_count);
 }
 
 // Suspend calling thread on a condition variable waiting for condition Atomically unlocks 
@@ -51,7 +51,6 @@ cond_signal (condvar_t *cvp) {
 void
 cond_wait (condvar_t *cvp) {
     //LAB7 EXERCISE1: YOUR CODE
-    cprintf("cond_wait begin:  cvp %x, cvp->count %d, cvp->owner->next_count %d\n", cvp, cvp->count, cvp->owner->next_count);
    /*
     *         cv.count ++;
     *         if(mt.next_count>0)
@@ -68,5 +67,4 @@ cond_wait (condvar_t *cvp) {
          up(&(cvp->owner->mutex));
       down(&(cvp->sem));
       cvp->count --;
-    cprintf("cond_wait end:  cvp %x, cvp->count %d, cvp->owner->next_count %d\n", cvp, cvp->count, cvp->owner->next_count);
 }
@@ -0,0 +1,173 @@
+#include <defs.h>
+#include <wait.h>
+#include <rwsem.h>
+#include <proc.h>
+#include <sched.h>
+#include <sync.h>
+#include <clock.h>
+#include <assert.h>
+
+typedef struct {
+    wait_t wait;
+    bool write;                 // BOOL: waits to write (or to read)
+} rwsem_wait_t;
+
+void
+__rwsem_init(rwsem_t *rwsem, struct lock_class *class) {
+    rwsem->count = 0;
+    wait_queue_init(&(rwsem->wait_queue));
+#ifdef LOCKSTAT
+    rwsem->class = class;
+    lockstat_init_class(class, 1);
+#endif
+}
+
+#ifdef LOCKSTAT
+/*
+ * rwsem_stat_acquired - rwsem is taken, after waiting since wait_start if contended.
+ *                       The hold time is measured for writers only.
+ */
+static void
+rwsem_stat_acquired(rwsem_t *rwsem, bool write, bool contended, uint64_t wait_start) {
+    uint64_t now = clock_nsec();
+    lockstat_acquired(rwsem->class);
+    if (contended) {
+        lockstat_contended(rwsem->class, now - wait_start);
+    }
+    if (write) {
+        rwsem->hold_start = now;
+    }
+}
+
+static void
+rwsem_stat_released(rwsem_t *rwsem) {
+    lockstat_released(rwsem->class, clock_nsec() - rwsem->hold_start);
+}
+#else
+#define rwsem_stat_acquired(rwsem, write, contended, wait_start)    do { } while (0)
+#define rwsem_stat_released(rwsem)                                  do { } while (0)
+#endif
+
+/*
+ * rwsem_wake - hand rwsem over to the waiters at the head of the queue, a writer
+ *              if rwsem is free, or the readers up to the first waiting writer.
+ *              Called with interrupts disabled.
+ */
+static void
+rwsem_wake(rwsem_t *rwsem) {
+    wait_t *wait;
+    while ((wait = wait_queue_first(&(rwsem->wait_queue))) != NULL) {
+        rwsem_wait_t *rwait = to_struct(wait, rwsem_wait_t, wait);
+        if (rwait->write) {
+            if (rwsem->count == 0) {
+                rwsem->count = -1;
+                wakeup_wait(&(rwsem->wait_queue), wait, WT_KRWSEM, 1);
+            }
+            break;
+        }
+        if (rwsem->count < 0) {
+            break;
+        }
+        rwsem->count ++;
+        wakeup_wait(&(rwsem->wait_queue), wait, WT_KRWSEM, 1);
+    }
+}
+
+/*
+ * rwsem_down - wait until rwsem is handed over by rwsem_wake, called with
+ *              interrupts disabled (saved in intr_flag) and restores them
+ */
+static void
+rwsem_down(rwsem_t *rwsem, bool write, bool intr_flag) {
+#ifdef LOCKSTAT
+    uint64_t wait_start = clock_nsec();
+#endif
+    rwsem_wait_t __rwait, *rwait = &__rwait;
+    rwait->write = write;
+    wait_current_set(&(rwsem->wait_queue), &(rwait->wait), WT_KRWSEM);
+    local_intr_restore(intr_flag);
+
+    schedule();
+
+    local_intr_save(intr_flag);
+    wait_current_del(&(rwsem->wait_queue), &(rwait->wait));
+    local_intr_restore(intr_flag);
+    assert(rwait->wait.wakeup_flags == WT_KRWSEM);
+    rwsem_stat_acquired(rwsem, write, 1, wait_start);
+}
+
+void
+down_read(rwsem_t *rwsem) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    if (rwsem->count >= 0 && wait_queue_empty(&(rwsem->wait_queue))) {
+        rwsem->count ++;
+        rwsem_stat_acquired(rwsem, 0, 0, 0);
+        local_intr_restore(intr_flag);
+        return;
+    }
+    rwsem_down(rwsem, 0, intr_flag);
+}
+
+void
+down_write(rwsem_t *rwsem) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    if (rwsem->count == 0 && wait_queue_empty(&(rwsem->wait_queue))) {
+        rwsem->count = -1;
+        rwsem_stat_acquired(rwsem, 1, 0, 0);
+        local_intr_restore(intr_flag);
+        return;
+    }
+    rwsem_down(rwsem, 1, intr_flag);
+}
+
+void
+up_read(rwsem_t *rwsem) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        assert(rwsem->count > 0);
+        if (-- rwsem->count == 0) {
+            rwsem_wake(rwsem);
+        }
+    }
+    local_intr_restore(intr_flag);
+}
+
+void
+up_write(rwsem_t *rwsem) {
+    bool intr_flag;
+    local_intr_save(intr_flag);
+    {
+        assert(rwsem->count == -1);
+        rwsem_stat_released(rwsem);
+        rwsem->count = 0;
+        rwsem_wake(rwsem);
+    }
+    local_intr_restore(intr_flag);
+}
+
+bool
+try_down_read(rwsem_t *rwsem) {
+    bool intr_flag, ret = 0;
+    local_intr_save(intr_flag);
+    if (rwsem->count >= 0 && wait_queue_empty(&(rwsem->wait_queue))) {
+        rwsem->count ++, ret = 1;
+        rwsem_stat_acquired(rwsem, 0, 0, 0);
+    }
+    local_intr_restore(intr_flag);
+    return ret;
+}
+
+bool
+try_down_write(rwsem_t *rwsem) {
+    bool intr_flag, ret = 0;
+    local_intr_save(intr_flag);
+    if (rwsem->count == 0 && wait_queue_empty(&(rwsem->wait_queue))) {
+        rwsem->count = -1, ret = 1;
+        rwsem_stat_acquired(rwsem, 1, 0, 0);
+    }
+    local_intr_restore(intr_flag);
+    return ret;
+}
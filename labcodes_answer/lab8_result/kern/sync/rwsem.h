@@ -0,0 +1,35 @@
+#ifndef __KERN_SYNC_RWSEM_H__
+#define __KERN_SYNC_RWSEM_H__
+
+#include <defs.h>
+#include <wait.h>
+#include <lockstat.h>
+
+/*
+ * Reader-writer semaphores.
+ *
+ * Any number of readers or one writer hold the rwsem. Waiters sleep in one FIFO
+ * queue, and a new reader queues up behind any waiter instead of joining the
+ * readers inside, so a waiting writer is not starved by a stream of readers.
+ * The lock is handed over to the woken waiters directly: a writer at the head of
+ * the queue, or all the readers in front of the first waiting writer.
+ */
+typedef struct {
+    int count;                  // # of readers holding it, -1 if held by a writer
+    wait_queue_t wait_queue;
+#ifdef LOCKSTAT
+    struct lock_class *class;
+    uint64_t hold_start;        // when the writer took it
+#endif
+} rwsem_t;
+
+void __rwsem_init(rwsem_t *rwsem, struct lock_class *class);
+#define rwsem_init(rwsem)               __rwsem_init(rwsem, LOCK_CLASS(rwsem))
+void down_read(rwsem_t *rwsem);
+void up_read(rwsem_t *rwsem);
+void down_write(rwsem_t *rwsem);
+void up_write(rwsem_t *rwsem);
+bool try_down_read(rwsem_t *rwsem);
+bool try_down_write(rwsem_t *rwsem);
+
+#endif /* !__KERN_SYNC_RWSEM_H__ */
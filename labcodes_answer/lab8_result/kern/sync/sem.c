@@ -5,19 +5,50 @@
 #include <sem.h>
 #include <proc.h>
 #include <sync.h>
+#include <clock.h>
 #include <assert.h>
 
 void
-sem_init(semaphore_t *sem, int value) {
+__sem_init(semaphore_t *sem, int value, struct lock_class *class) {
     sem->value = value;
     wait_queue_init(&(sem->wait_queue));
+#ifdef LOCKSTAT
+    sem->class = class;
+    lockstat_init_class(class, value == 1);
+#endif
 }
 
+#ifdef LOCKSTAT
+/*
+ * sem_stat_acquired - sem is taken, after waiting since wait_start if contended
+ */
+static void
+sem_stat_acquired(semaphore_t *sem, bool contended, uint64_t wait_start) {
+    uint64_t now = clock_nsec();
+    lockstat_acquired(sem->class);
+    if (contended) {
+        lockstat_contended(sem->class, now - wait_start);
+    }
+    sem->hold_start = now;
+}
+
+static void
+sem_stat_released(semaphore_t *sem) {
+    if (sem->class->mutex) {
+        lockstat_released(sem->class, clock_nsec() - sem->hold_start);
+    }
+}
+#else
+#define sem_stat_acquired(sem, contended, wait_start)   do { } while (0)
+#define sem_stat_released(sem)                          do { } while (0)
+#endif
+
 static __noinline void __up(semaphore_t *sem, uint32_t wait_state) {
     bool intr_flag;
     local_intr_save(intr_flag);
     {
         wait_t *wait;
+        sem_stat_released(sem);
         if ((wait = wait_queue_first(&(sem->wait_queue))) == NULL) {
             sem->value ++;
         }
@@ -34,11 +65,16 @@ static __noinline uint32_t __down(semaphore_t *sem, uint32_t wait_state) {
     local_intr_save(intr_flag);
     if (sem->value > 0) {
         sem->value --;
+        sem_stat_acquired(sem, 0, 0);
         local_intr_restore(intr_flag);
         return 0;
     }
+#ifdef LOCKSTAT
+    uint64_t wait_start = clock_nsec();
+#endif
     wait_t __wait, *wait = &__wait;
-    wait_current_set(&(sem->wait_queue), wait, wait_state);
+    // exclusive: up hands the semaphore to one waiter, the one of highest priority
+    wait_current_set_exclusive(&(sem->wait_queue), wait, wait_state);
     local_intr_restore(intr_flag);
 
     schedule();
@@ -50,6 +86,7 @@ static __noinline uint32_t __down(semaphore_t *sem, uint32_t wait_state) {
     if (wait->wakeup_flags != wait_state) {
         return wait->wakeup_flags;
     }
+    sem_stat_acquired(sem, 1, wait_start);
     return 0;
 }
 
@@ -70,6 +107,7 @@ try_down(semaphore_t *sem) {
     local_intr_save(intr_flag);
     if (sem->value > 0) {
         sem->value --, ret = 1;
+        sem_stat_acquired(sem, 0, 0);
     }
     local_intr_restore(intr_flag);
     return ret;
@@ -4,13 +4,19 @@
 #include <defs.h>
 #include <atomic.h>
 #include <wait.h>
+#include <lockstat.h>
 
 typedef struct {
     int value;
     wait_queue_t wait_queue;
+#ifdef LOCKSTAT
+    struct lock_class *class;
+    uint64_t hold_start;        // when it was taken, if class->mutex
+#endif
 } semaphore_t;
 
-void sem_init(semaphore_t *sem, int value);
+void __sem_init(semaphore_t *sem, int value, struct lock_class *class);
+#define sem_init(sem, value)            __sem_init(sem, value, LOCK_CLASS(sem))
 void up(semaphore_t *sem);
 void down(semaphore_t *sem);
 bool try_down(semaphore_t *sem);
@@ -8,6 +8,7 @@ void
 wait_init(wait_t *wait, struct proc_struct *proc) {
     wait->proc = proc;
     wait->wakeup_flags = WT_INTERRUPTED;
+    wait->exclusive = 0;
     list_init(&(wait->wait_link));
 }
 
@@ -19,10 +20,30 @@ wait_queue_init(wait_queue_t *queue) {
 void
 wait_queue_add(wait_queue_t *queue, wait_t *wait) {
     assert(list_empty(&(wait->wait_link)) && wait->proc != NULL);
-    wait->wait_queue = queue;
+    wait->wait_queue = queue, wait->exclusive = 0;
     list_add_before(&(queue->wait_head), &(wait->wait_link));
 }
 
+/*
+ * wait_queue_add_exclusive - add an exclusive waiter behind all the waiters of
+ *                            the same or higher priority
+ */
+void
+wait_queue_add_exclusive(wait_queue_t *queue, wait_t *wait) {
+    assert(list_empty(&(wait->wait_link)) && wait->proc != NULL);
+    wait->wait_queue = queue, wait->exclusive = 1;
+    uint32_t priority = wait->proc->lab6_priority;
+    list_entry_t *le = list_prev(&(queue->wait_head));
+    while (le != &(queue->wait_head)) {
+        wait_t *prev = le2wait(le, wait_link);
+        if (!prev->exclusive || prev->proc->lab6_priority >= priority) {
+            break;
+        }
+        le = list_prev(le);
+    }
+    list_add_after(le, &(wait->wait_link));
+}
+
 void
 wait_queue_del(wait_queue_t *queue, wait_t *wait) {
     assert(!list_empty(&(wait->wait_link)) && wait->wait_queue == queue);
@@ -94,20 +115,22 @@ wakeup_first(wait_queue_t *queue, uint32_t wakeup_flags, bool del) {
     }
 }
 
+/*
+ * wakeup_queue - wake up all the waiters in queue, but only the first exclusive one
+ */
 void
 wakeup_queue(wait_queue_t *queue, uint32_t wakeup_flags, bool del) {
-    wait_t *wait;
-    if ((wait = wait_queue_first(queue)) != NULL) {
-        if (del) {
-            do {
-                wakeup_wait(queue, wait, wakeup_flags, 1);
-            } while ((wait = wait_queue_first(queue)) != NULL);
-        }
-        else {
-            do {
-                wakeup_wait(queue, wait, wakeup_flags, 0);
-            } while ((wait = wait_queue_next(queue, wait)) != NULL);
+    wait_t *wait, *next;
+    bool exclusive = 0;
+    for (wait = wait_queue_first(queue); wait != NULL; wait = next) {
+        next = wait_queue_next(queue, wait);
+        if (wait->exclusive) {
+            if (exclusive) {
+                continue;
+            }
+            exclusive = 1;
         }
+        wakeup_wait(queue, wait, wakeup_flags, del);
     }
 }
 
@@ -120,3 +143,11 @@ wait_current_set(wait_queue_t *queue, wait_t *wait, uint32_t wait_state) {
     wait_queue_add(queue, wait);
 }
 
+void
+wait_current_set_exclusive(wait_queue_t *queue, wait_t *wait, uint32_t wait_state) {
+    assert(current != NULL);
+    wait_init(wait, current);
+    current->state = PROC_SLEEPING;
+    current->wait_state = wait_state;
+    wait_queue_add_exclusive(queue, wait);
+}
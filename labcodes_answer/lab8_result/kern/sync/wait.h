@@ -9,9 +9,16 @@ typedef struct {
 
 struct proc_struct;
 
+/*
+ * A waiter is exclusive if one wakeup is enough for all of them, such as the
+ * waiters for a semaphore: wakeup_queue wakes up all the other waiters, but only
+ * the first exclusive one. Exclusive waiters are kept in the order of priority
+ * (lab6_priority) of their processes, FIFO among the same priority.
+ */
 typedef struct {
     struct proc_struct *proc;
     uint32_t wakeup_flags;
+    bool exclusive;
     wait_queue_t *wait_queue;
     list_entry_t wait_link;
 } wait_t;
@@ -22,6 +29,7 @@ typedef struct {
 void wait_init(wait_t *wait, struct proc_struct *proc);
 void wait_queue_init(wait_queue_t *queue);
 void wait_queue_add(wait_queue_t *queue, wait_t *wait);
+void wait_queue_add_exclusive(wait_queue_t *queue, wait_t *wait);
 void wait_queue_del(wait_queue_t *queue, wait_t *wait);
 
 wait_t *wait_queue_next(wait_queue_t *queue, wait_t *wait);
@@ -36,6 +44,7 @@ void wakeup_first(wait_queue_t *queue, uint32_t wakeup_flags, bool del);
 void wakeup_queue(wait_queue_t *queue, uint32_t wakeup_flags, bool del);
 
 void wait_current_set(wait_queue_t *queue, wait_t *wait, uint32_t wait_state);
+void wait_current_set_exclusive(wait_queue_t *queue, wait_t *wait, uint32_t wait_state);
 
 #define wait_current_del(queue, wait)                                       \
     do {                                                                    \
@@ -10,6 +10,15 @@
 #include <stat.h>
 #include <dirent.h>
 #include <sysfile.h>
+#include <uio.h>
+#include <sysreq.h>
+#include <schedstat.h>
+#include <sched.h>
+#include <perf.h>
+#include <trace.h>
+#include <futex.h>
+#include <vmm.h>
+#include <error.h>
 
 static int
 sys_exit(uint32_t arg[]) {
@@ -39,6 +48,15 @@ sys_exec(uint32_t arg[]) {
     return do_execve(name, argc, argv);
 }
 
+static int
+sys_futex(uint32_t arg[]) {
+    uintptr_t uaddr = (uintptr_t)arg[0];
+    int op = (int)arg[1];
+    uint32_t val = (uint32_t)arg[2];
+    unsigned int timeout = (unsigned int)arg[3];
+    return do_futex(uaddr, op, val, timeout);
+}
+
 static int
 sys_yield(uint32_t arg[]) {
     return do_yield();
@@ -55,6 +73,26 @@ sys_getpid(uint32_t arg[]) {
     return current->pid;
 }
 
+static int
+sys_schedstat(uint32_t arg[]) {
+    int pid = (int)arg[0];
+    struct schedstat *ustat = (struct schedstat *)arg[1];
+    struct schedstat stat;
+    int ret;
+    if ((ret = sched_getstat(pid, &stat)) != 0) {
+        return ret;
+    }
+    struct mm_struct *mm = current->mm;
+    lock_mm_shared(mm);
+    {
+        if (!copy_to_user(mm, ustat, &stat, sizeof(struct schedstat))) {
+            ret = -E_INVAL;
+        }
+    }
+    unlock_mm_shared(mm);
+    return ret;
+}
+
 static int
 sys_putc(uint32_t arg[]) {
     int c = (int)arg[0];
@@ -62,6 +100,64 @@ sys_putc(uint32_t arg[]) {
     return 0;
 }
 
+static int
+sys_cputs(uint32_t arg[]) {
+    const char *str = (const char *)arg[0];
+    size_t len = (size_t)arg[1];
+    struct mm_struct *mm = current->mm;
+    char buffer[128];
+    while (len > 0) {
+        size_t n = (len < sizeof(buffer)) ? len : sizeof(buffer);
+        bool ok;
+        lock_mm_shared(mm);
+        {
+            ok = copy_from_user(mm, buffer, str, n, 0);
+        }
+        unlock_mm_shared(mm);
+        if (!ok) {
+            return -E_INVAL;
+        }
+        size_t i;
+        for (i = 0; i < n; i ++) {
+            cputchar(buffer[i]);
+        }
+        str += n, len -= n;
+    }
+    return 0;
+}
+
+static int
+sys_sysenter(uint32_t arg[]) {
+    uintptr_t eip = (uintptr_t)arg[0];
+    if (!sysenter_enabled) {
+        return -E_UNIMP;
+    }
+    if (eip < UTEXT || eip >= USERTOP) {
+        return -E_INVAL;
+    }
+    current->sysenter_eip = eip;
+    return 0;
+}
+
+static int
+sys_perf(uint32_t arg[]) {
+    int cmd = (int)arg[0];
+    switch (cmd) {
+    case PERF_START:
+        perf_start();
+        break;
+    case PERF_STOP:
+        perf_stop();
+        break;
+    case PERF_REPORT:
+        perf_report();
+        break;
+    default:
+        return -E_INVAL;
+    }
+    return 0;
+}
+
 static int
 sys_pgdir(uint32_t arg[]) {
     print_pgdir();
@@ -70,6 +166,7 @@ sys_pgdir(uint32_t arg[]) {
 
 static uint32_t
 sys_gettime(uint32_t arg[]) {
+    clock_sync();
     return (int)ticks;
 }
 static uint32_t
@@ -115,6 +212,22 @@ sys_write(uint32_t arg[]) {
     return sysfile_write(fd, base, len);
 }
 
+static int
+sys_readv(uint32_t arg[]) {
+    int fd = (int)arg[0];
+    const struct iovec *iov = (const struct iovec *)arg[1];
+    int iovcnt = (int)arg[2];
+    return sysfile_readv(fd, iov, iovcnt);
+}
+
+static int
+sys_writev(uint32_t arg[]) {
+    int fd = (int)arg[0];
+    const struct iovec *iov = (const struct iovec *)arg[1];
+    int iovcnt = (int)arg[2];
+    return sysfile_writev(fd, iov, iovcnt);
+}
+
 static int
 sys_seek(uint32_t arg[]) {
     int fd = (int)arg[0];
@@ -157,6 +270,46 @@ sys_dup(uint32_t arg[]) {
     return sysfile_dup(fd1, fd2);
 }
 
+static int
+sys_mmap(uint32_t arg[]) {
+    uintptr_t *addr_store = (uintptr_t *)arg[0];
+    size_t len = (size_t)arg[1];
+    uint32_t mmap_flags = (uint32_t)arg[2];
+    int fd = (int)arg[3];
+    off_t offset = (off_t)arg[4];
+    return do_mmap(addr_store, len, mmap_flags, fd, offset);
+}
+
+static int
+sys_munmap(uint32_t arg[]) {
+    uintptr_t addr = (uintptr_t)arg[0];
+    size_t len = (size_t)arg[1];
+    return do_munmap(addr, len);
+}
+
+static int
+sys_shmem(uint32_t arg[]) {
+    uintptr_t *addr_store = (uintptr_t *)arg[0];
+    size_t len = (size_t)arg[1];
+    uint32_t mmap_flags = (uint32_t)arg[2];
+    return do_shmem(addr_store, len, mmap_flags);
+}
+
+static int
+sys_pipe(uint32_t arg[]) {
+    int *fd_store = (int *)arg[0];
+    return sysfile_pipe(fd_store);
+}
+
+static int
+sys_mkfifo(uint32_t arg[]) {
+    const char *name = (const char *)arg[0];
+    uint32_t open_flags = (uint32_t)arg[1];
+    return sysfile_mkfifo(name, open_flags);
+}
+
+static int sys_batch(uint32_t arg[]);
+
 static int (*syscalls[])(uint32_t arg[]) = {
     [SYS_exit]              sys_exit,
     [SYS_fork]              sys_fork,
@@ -164,26 +317,104 @@ static int (*syscalls[])(uint32_t arg[]) = {
     [SYS_exec]              sys_exec,
     [SYS_yield]             sys_yield,
     [SYS_kill]              sys_kill,
+    [SYS_futex]             sys_futex,
     [SYS_getpid]            sys_getpid,
+    [SYS_schedstat]         sys_schedstat,
     [SYS_putc]              sys_putc,
     [SYS_pgdir]             sys_pgdir,
+    [SYS_cputs]             sys_cputs,
+    [SYS_sysenter]          sys_sysenter,
+    [SYS_perf]              sys_perf,
+    [SYS_batch]             sys_batch,
     [SYS_gettime]           sys_gettime,
+    [SYS_mmap]              sys_mmap,
+    [SYS_munmap]            sys_munmap,
+    [SYS_shmem]             sys_shmem,
     [SYS_lab6_set_priority] sys_lab6_set_priority,
     [SYS_sleep]             sys_sleep,
     [SYS_open]              sys_open,
     [SYS_close]             sys_close,
     [SYS_read]              sys_read,
     [SYS_write]             sys_write,
+    [SYS_readv]             sys_readv,
+    [SYS_writev]            sys_writev,
     [SYS_seek]              sys_seek,
     [SYS_fstat]             sys_fstat,
     [SYS_fsync]             sys_fsync,
     [SYS_getcwd]            sys_getcwd,
     [SYS_getdirentry]       sys_getdirentry,
     [SYS_dup]               sys_dup,
+    [SYS_pipe]              sys_pipe,
+    [SYS_mkfifo]            sys_mkfifo,
 };
 
 #define NUM_SYSCALLS        ((sizeof(syscalls)) / (sizeof(syscalls[0])))
 
+/* sysreq_allowed - syscalls which do not return to the caller, or depend on its
+ *                  trapframe, can not be batched
+ */
+static bool
+sysreq_allowed(int num) {
+    if (num < 0 || num >= NUM_SYSCALLS || syscalls[num] == NULL) {
+        return 0;
+    }
+    switch (num) {
+    case SYS_exit: case SYS_fork: case SYS_exec: case SYS_clone: case SYS_batch:
+        return 0;
+    }
+    return 1;
+}
+
+/* sys_batch - run the nreqs requests of reqs one after another within one trap, and
+ *             store the return value of each into it. Returns the # of requests run,
+ *             which is less than nreqs if the process is killed meanwhile.
+ */
+static int
+sys_batch(uint32_t arg[]) {
+    struct sysreq *reqs = (struct sysreq *)arg[0];
+    int nreqs = (int)arg[1];
+    struct mm_struct *mm = current->mm;
+    if (nreqs <= 0 || nreqs > SYSREQ_MAX) {
+        return -E_INVAL;
+    }
+    int i, j;
+    for (i = 0; i < nreqs; i ++) {
+        struct sysreq req;
+        bool ok;
+        lock_mm_shared(mm);
+        {
+            ok = copy_from_user(mm, &req, reqs + i, sizeof(struct sysreq), 0);
+            for (j = 0; ok && j < SYSREQ_NARGS; j ++) {
+                if (req.flags & SYSREQ_RET(j)) {
+                    // pass the return value of an earlier request
+                    int from = (int)req.args[j];
+                    ok = (from >= 0 && from < i)
+                        && copy_from_user(mm, &(req.args[j]), &(reqs[from].ret), sizeof(int), 0);
+                }
+            }
+        }
+        unlock_mm_shared(mm);
+        if (!ok) {
+            return (i != 0) ? i : -E_INVAL;
+        }
+
+        req.ret = sysreq_allowed(req.num) ? syscalls[req.num](req.args) : -E_INVAL;
+
+        lock_mm_shared(mm);
+        {
+            ok = copy_to_user(mm, &(reqs[i].ret), &(req.ret), sizeof(int));
+        }
+        unlock_mm_shared(mm);
+        if (!ok) {
+            return (i != 0) ? i : -E_INVAL;
+        }
+        if (current->flags & PF_EXITING) {
+            return i + 1;
+        }
+    }
+    return nreqs;
+}
+
 void
 syscall(void) {
     struct trapframe *tf = current->tf;
@@ -196,6 +427,7 @@ syscall(void) {
             arg[2] = tf->tf_regs.reg_ebx;
             arg[3] = tf->tf_regs.reg_edi;
             arg[4] = tf->tf_regs.reg_esi;
+            trace(TRACE_SYSCALL, num, arg[0], arg[1], arg[2]);
             tf->tf_regs.reg_eax = syscalls[num](arg);
             return ;
         }
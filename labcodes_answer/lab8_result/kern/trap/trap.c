@@ -10,6 +10,7 @@
 #include <vmm.h>
 #include <swap.h>
 #include <kdebug.h>
+#include <perf.h>
 #include <unistd.h>
 #include <syscall.h>
 #include <error.h>
@@ -184,7 +185,18 @@ pgfault_handler(struct trapframe *tf) {
         }
         mm = current->mm;
     }
-    return do_pgfault(mm, tf->tf_err, rcr2());
+    // a fault in the kernel comes from copy_from_user/copy_to_user, which hold
+    // mm_sem already; faults of user code run in parallel under the shared lock
+    // (cr2 is read first, waiting for the lock may let other faults in)
+    uintptr_t addr = rcr2();
+    if (!trap_in_kernel(tf)) {
+        int ret;
+        lock_mm_shared(mm);
+        ret = do_pgfault(mm, tf->tf_err, addr);
+        unlock_mm_shared(mm);
+        return ret;
+    }
+    return do_pgfault(mm, tf->tf_err, addr);
 }
 
 static volatile int in_swap_tick_event = 0;
@@ -239,9 +251,9 @@ trap_dispatch(struct trapframe *tf) {
          *    Every tick, you should update the system time, iterate the timers, and trigger the timers which are end to call scheduler.
          *    You can use one funcitons to finish all these things.
          */
-        ticks ++;
         assert(current != NULL);
-        run_timer_list();
+        perf_sample(tf);
+        run_timer_list(clock_tick());
         break;
     case IRQ_OFFSET + IRQ_COM1:
         //c = cons_getc();
@@ -276,6 +288,20 @@ trap_dispatch(struct trapframe *tf) {
     }
 }
 
+// trap_return_user - the work due before current goes back to user mode
+static inline void
+trap_return_user(void) {
+    if (current->flags & PF_EXITING) {
+        do_exit(-E_KILLED);
+    }
+    if (current->need_resched) {
+        schedule();
+    }
+    if (!perf_running()) {
+        clock_run_slice();
+    }
+}
+
 /* *
  * trap - handles or dispatches an exception/interrupt. if and when trap() returns,
  * the code in kern/trap/trapentry.S restores the old CPU state saved in the
@@ -299,13 +325,27 @@ trap(struct trapframe *tf) {
     
         current->tf = otf;
         if (!in_kernel) {
-            if (current->flags & PF_EXITING) {
-                do_exit(-E_KILLED);
-            }
-            if (current->need_resched) {
-                schedule();
-            }
+            trap_return_user();
         }
     }
 }
 
+
+/* *
+ * sysenter_trap - called by __sysenter in kern/trap/trapentry.S with the trap
+ * frame it built. sysenter only comes from user mode and only for a syscall,
+ * so this goes to syscall() directly, without trap_dispatch and the trapframe
+ * chain of trap(). Returns nonzero if the frame can go back to the user by
+ * sysexit: it still returns to the stub registered by SYS_sysenter, which exec
+ * has not replaced.
+ * */
+bool
+sysenter_trap(struct trapframe *tf) {
+    uintptr_t eip = current->sysenter_eip;
+    tf->tf_eip = eip;
+    current->tf = tf;
+    syscall();
+    trap_return_user();
+    return eip != 0 && tf->tf_eip == eip && tf->tf_cs == USER_CS
+        && current->sysenter_eip == eip;
+}
@@ -84,6 +84,7 @@ void idt_init(void);
 void print_trapframe(struct trapframe *tf);
 void print_regs(struct pushregs *regs);
 bool trap_in_kernel(struct trapframe *tf);
+bool sysenter_trap(struct trapframe *tf);
 
 #endif /* !__KERN_TRAP_TRAP_H__ */
 
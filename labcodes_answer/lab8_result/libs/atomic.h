@@ -9,6 +9,9 @@ static inline void change_bit(int nr, volatile void *addr) __attribute__((always
 static inline bool test_and_set_bit(int nr, volatile void *addr) __attribute__((always_inline));
 static inline bool test_and_clear_bit(int nr, volatile void *addr) __attribute__((always_inline));
 static inline bool test_bit(int nr, volatile void *addr) __attribute__((always_inline));
+static inline unsigned int fetch_and_add(volatile unsigned int *addr, unsigned int val) __attribute__((always_inline));
+static inline int atomic_xchg(volatile int *addr, int val) __attribute__((always_inline));
+static inline int atomic_cmpxchg(volatile int *addr, int old, int new) __attribute__((always_inline));
 
 /* *
  * set_bit - Atomically set a bit in memory
@@ -78,5 +81,37 @@ test_and_clear_bit(int nr, volatile void *addr) {
     asm volatile ("btrl %2, %1; sbbl %0, %0" : "=r" (oldbit), "=m" (*(volatile long *)addr) : "Ir" (nr) : "memory");
     return oldbit != 0;
 }
+
+/* *
+ * fetch_and_add - Atomically add @val to *@addr and return the old value
+ * @addr:   the counter
+ * @val:    the value to add
+ * */
+static inline unsigned int
+fetch_and_add(volatile unsigned int *addr, unsigned int val) {
+    asm volatile ("xaddl %0, %1" : "+r" (val), "+m" (*addr) : : "memory");
+    return val;
+}
+
+/* *
+ * atomic_xchg - Atomically store @val in *@addr and return the old value
+ * */
+static inline int
+atomic_xchg(volatile int *addr, int val) {
+    asm volatile ("xchgl %0, %1" : "+r" (val), "+m" (*addr) : : "memory");
+    return val;
+}
+
+/* *
+ * atomic_cmpxchg - Atomically store @new in *@addr if it is @old, and
+ * return the old value of *@addr
+ * */
+static inline int
+atomic_cmpxchg(volatile int *addr, int old, int new) {
+    int prev;
+    asm volatile ("cmpxchgl %2, %1" : "=a" (prev), "+m" (*addr) : "r" (new), "0" (old) : "memory");
+    return prev;
+}
+
 #endif /* !__LIBS_ATOMIC_H__ */
 
@@ -0,0 +1,219 @@
+#include <defs.h>
+#include <rb_tree.h>
+
+/* rb_tree_init - initialize an empty tree */
+void
+rb_tree_init(rb_tree_t *tree) {
+    tree->root = tree->leftmost = NULL;
+}
+
+/* rb_set_child - let child take the place of old under parent (the root if NULL) */
+static inline void
+rb_set_child(rb_tree_t *tree, rb_node_t *parent, rb_node_t *old, rb_node_t *child) {
+    if (parent == NULL) {
+        tree->root = child;
+    }
+    else if (parent->left == old) {
+        parent->left = child;
+    }
+    else {
+        parent->right = child;
+    }
+}
+
+static void
+rb_rotate_left(rb_tree_t *tree, rb_node_t *node) {
+    rb_node_t *right = node->right;
+    if ((node->right = right->left) != NULL) {
+        right->left->parent = node;
+    }
+    right->left = node;
+    right->parent = node->parent;
+    rb_set_child(tree, node->parent, node, right);
+    node->parent = right;
+}
+
+static void
+rb_rotate_right(rb_tree_t *tree, rb_node_t *node) {
+    rb_node_t *left = node->left;
+    if ((node->left = left->right) != NULL) {
+        left->right->parent = node;
+    }
+    left->right = node;
+    left->parent = node->parent;
+    rb_set_child(tree, node->parent, node, left);
+    node->parent = left;
+}
+
+#define rb_is_red(node)         ((node) != NULL && (node)->red)
+
+/*
+ * rb_insert - insert node into the tree, ordered by comp. A node equal to
+ *             some others goes after them.
+ */
+void
+rb_insert(rb_tree_t *tree, rb_node_t *node, rb_compare_f comp) {
+    rb_node_t *parent = NULL, **link = &(tree->root);
+    bool leftmost = 1;
+    while (*link != NULL) {
+        parent = *link;
+        if (comp(node, parent) < 0) {
+            link = &(parent->left);
+        }
+        else {
+            link = &(parent->right), leftmost = 0;
+        }
+    }
+    node->parent = parent, node->left = node->right = NULL, node->red = 1;
+    *link = node;
+    if (leftmost) {
+        tree->leftmost = node;
+    }
+
+    rb_node_t *gparent, *uncle;
+    while ((parent = node->parent) != NULL && parent->red) {
+        gparent = parent->parent;
+        if (parent == gparent->left) {
+            uncle = gparent->right;
+            if (rb_is_red(uncle)) {
+                uncle->red = parent->red = 0, gparent->red = 1;
+                node = gparent;
+                continue;
+            }
+            if (parent->right == node) {
+                rb_rotate_left(tree, parent);
+                uncle = parent, parent = node, node = uncle;
+            }
+            parent->red = 0, gparent->red = 1;
+            rb_rotate_right(tree, gparent);
+        }
+        else {
+            uncle = gparent->left;
+            if (rb_is_red(uncle)) {
+                uncle->red = parent->red = 0, gparent->red = 1;
+                node = gparent;
+                continue;
+            }
+            if (parent->left == node) {
+                rb_rotate_right(tree, parent);
+                uncle = parent, parent = node, node = uncle;
+            }
+            parent->red = 0, gparent->red = 1;
+            rb_rotate_left(tree, gparent);
+        }
+    }
+    tree->root->red = 0;
+}
+
+/* rb_delete_fixup - node (may be NULL) under parent lost one black on its path */
+static void
+rb_delete_fixup(rb_tree_t *tree, rb_node_t *node, rb_node_t *parent) {
+    rb_node_t *other;
+    while (!rb_is_red(node) && node != tree->root) {
+        if (parent->left == node) {
+            other = parent->right;
+            if (other->red) {
+                other->red = 0, parent->red = 1;
+                rb_rotate_left(tree, parent);
+                other = parent->right;
+            }
+            if (!rb_is_red(other->left) && !rb_is_red(other->right)) {
+                other->red = 1;
+                node = parent, parent = node->parent;
+                continue;
+            }
+            if (!rb_is_red(other->right)) {
+                other->left->red = 0, other->red = 1;
+                rb_rotate_right(tree, other);
+                other = parent->right;
+            }
+            other->red = parent->red, parent->red = 0, other->right->red = 0;
+            rb_rotate_left(tree, parent);
+        }
+        else {
+            other = parent->left;
+            if (other->red) {
+                other->red = 0, parent->red = 1;
+                rb_rotate_right(tree, parent);
+                other = parent->left;
+            }
+            if (!rb_is_red(other->left) && !rb_is_red(other->right)) {
+                other->red = 1;
+                node = parent, parent = node->parent;
+                continue;
+            }
+            if (!rb_is_red(other->left)) {
+                other->right->red = 0, other->red = 1;
+                rb_rotate_left(tree, other);
+                other = parent->left;
+            }
+            other->red = parent->red, parent->red = 0, other->left->red = 0;
+            rb_rotate_right(tree, parent);
+        }
+        node = tree->root;
+        break;
+    }
+    if (node != NULL) {
+        node->red = 0;
+    }
+}
+
+/* rb_delete - remove node from the tree */
+void
+rb_delete(rb_tree_t *tree, rb_node_t *node) {
+    if (tree->leftmost == node) {
+        tree->leftmost = rb_next(node);
+    }
+    rb_node_t *child, *parent;
+    bool red;
+    if (node->left != NULL && node->right != NULL) {
+        // the next node takes the place of node
+        rb_node_t *next = node->right;
+        while (next->left != NULL) {
+            next = next->left;
+        }
+        child = next->right, parent = next->parent, red = next->red;
+        if (parent == node) {
+            parent = next;
+        }
+        else {
+            if (child != NULL) {
+                child->parent = parent;
+            }
+            parent->left = child;
+            next->right = node->right;
+            node->right->parent = next;
+        }
+        rb_set_child(tree, node->parent, node, next);
+        next->parent = node->parent, next->red = node->red;
+        next->left = node->left;
+        node->left->parent = next;
+    }
+    else {
+        child = (node->left != NULL) ? node->left : node->right;
+        parent = node->parent, red = node->red;
+        if (child != NULL) {
+            child->parent = parent;
+        }
+        rb_set_child(tree, parent, node, child);
+    }
+    if (!red) {
+        rb_delete_fixup(tree, child, parent);
+    }
+}
+
+/* rb_next - the node after node in order, NULL if it is the last one */
+rb_node_t *
+rb_next(rb_node_t *node) {
+    rb_node_t *next;
+    if ((next = node->right) != NULL) {
+        while (next->left != NULL) {
+            next = next->left;
+        }
+        return next;
+    }
+    while ((next = node->parent) != NULL && next->right == node) {
+        node = next;
+    }
+    return next;
+}
@@ -0,0 +1,47 @@
+#ifndef __LIBS_RB_TREE_H__
+#define __LIBS_RB_TREE_H__
+
+#include <defs.h>
+
+/*
+ * Red-black tree with the nodes embedded in the caller's structures, as
+ * list_entry_t is. The tree keeps its leftmost (smallest) node, so the
+ * first node is found in O(1); insert and delete are O(log n).
+ */
+
+struct rb_node {
+    struct rb_node *parent, *left, *right;
+    bool red;
+};
+
+typedef struct rb_node rb_node_t;
+
+typedef struct {
+    rb_node_t *root;
+    rb_node_t *leftmost;
+} rb_tree_t;
+
+/* returns <0, 0 or >0 if a is less than, equal to or greater than b */
+typedef int (*rb_compare_f)(rb_node_t *a, rb_node_t *b);
+
+void rb_tree_init(rb_tree_t *tree);
+void rb_insert(rb_tree_t *tree, rb_node_t *node, rb_compare_f comp);
+void rb_delete(rb_tree_t *tree, rb_node_t *node);
+rb_node_t *rb_next(rb_node_t *node);
+
+static inline bool rb_tree_empty(rb_tree_t *tree) __attribute__((always_inline));
+static inline rb_node_t *rb_first(rb_tree_t *tree) __attribute__((always_inline));
+
+/* rb_tree_empty - tests whether the tree has no node */
+static inline bool
+rb_tree_empty(rb_tree_t *tree) {
+    return tree->root == NULL;
+}
+
+/* rb_first - the smallest node of the tree, NULL if empty */
+static inline rb_node_t *
+rb_first(rb_tree_t *tree) {
+    return tree->leftmost;
+}
+
+#endif /* !__LIBS_RB_TREE_H__ */
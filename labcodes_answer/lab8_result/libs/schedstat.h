@@ -0,0 +1,30 @@
+#ifndef __LIBS_SCHEDSTAT_H__
+#define __LIBS_SCHEDSTAT_H__
+
+#include <defs.h>
+
+#define SCHEDSTAT_NBUCKET       16      // # of buckets of a histogram
+
+/*
+ * Scheduler accounting of a process, or of all processes (SYS_schedstat
+ * with pid 0). Times are in nsec.
+ *
+ * latency_hist[0] counts wakeup-to-run latencies under 1 usec, and
+ * latency_hist[i] those in [2^(i-1), 2^i) usec; the last bucket takes all
+ * longer ones. nrunnable_hist[i] counts the ticks that found i processes in
+ * the run queue (the last bucket: at least that many), global only.
+ */
+struct schedstat {
+    uint64_t run_nsec;                          // time on the cpu
+    uint64_t wait_nsec;                         // time runnable, waiting for the cpu
+    uint64_t sleep_nsec;                        // time blocked
+    uint32_t nswitch;                           // # of context switches to it
+    uint32_t npreempt;                          // # of times it left the cpu still runnable
+    uint32_t nwakeup;                           // # of wakeups
+    uint64_t max_latency_nsec;                  // longest wakeup-to-run latency
+    uint32_t latency_hist[SCHEDSTAT_NBUCKET];
+    uint32_t nrunnable_hist[SCHEDSTAT_NBUCKET];
+};
+
+#endif /* !__LIBS_SCHEDSTAT_H__ */
+
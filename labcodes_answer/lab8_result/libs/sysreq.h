@@ -0,0 +1,21 @@
+#ifndef __LIBS_SYSREQ_H__
+#define __LIBS_SYSREQ_H__
+
+#include <defs.h>
+
+#define SYSREQ_MAX          64          // max # of requests of a SYS_batch
+#define SYSREQ_NARGS        5
+
+/* sysreq_flags: args[i] is the index of an earlier request, whose return value is passed */
+#define SYSREQ_RET(i)       (1 << (i))
+
+/* a syscall request of SYS_batch */
+struct sysreq {
+    int num;                            // syscall number
+    uint32_t flags;                     // SYSREQ_RET flags
+    uint32_t args[SYSREQ_NARGS];        // arguments
+    int ret;                            // return value, filled by the kernel
+};
+
+#endif /* !__LIBS_SYSREQ_H__ */
+
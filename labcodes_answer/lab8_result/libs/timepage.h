@@ -0,0 +1,75 @@
+#ifndef __LIBS_TIMEPAGE_H__
+#define __LIBS_TIMEPAGE_H__
+
+#include <defs.h>
+#include <x86.h>
+
+#define UTIMEPAGE           0x007FF000      // user address of the time page, just below UTEXT
+
+#define NSEC_PER_MSEC       1000000
+#define NSEC_PER_SEC        1000000000
+
+/* *
+ * The time page is written by the kernel at every clock tick, and mapped
+ * read-only into every user process at UTIMEPAGE, so both read the clock
+ * without a trap: the time is base_nsec plus the TSC cycles since base_tsc,
+ * scaled by tsc_mult >> tsc_shift. Without a usable TSC, tsc_mult is 0 and
+ * the time only moves at ticks.
+ *
+ * seq is odd while the kernel updates the page; a reader retries if seq
+ * changed under it.
+ * */
+struct timepage {
+    volatile uint32_t seq;
+    uint32_t tsc_mult;                  // nsec per cycle << tsc_shift, 0 if no TSC
+    uint32_t tsc_shift;
+    uint32_t tsc_khz;                   // TSC frequency, for information
+    uint64_t base_tsc;                  // TSC at the last tick
+    uint64_t base_nsec;                 // nsec since boot at the last tick
+    uint64_t ticks;                     // # of clock ticks since boot
+};
+
+// mul_u64_u32_shr - (a * mul) >> shift without overflow, for shift <= 32
+static inline uint64_t
+mul_u64_u32_shr(uint64_t a, uint32_t mul, uint32_t shift) {
+    uint32_t lo = (uint32_t)a, hi = (uint32_t)(a >> 32);
+    uint64_t ret = ((uint64_t)lo * mul) >> shift;
+    if (hi != 0) {
+        ret += ((uint64_t)hi * mul) << (32 - shift);
+    }
+    return ret;
+}
+
+// timepage_nsec - the monotonic time in nsec since boot
+static inline uint64_t
+timepage_nsec(volatile struct timepage *tp) {
+    uint32_t seq;
+    uint64_t nsec;
+    do {
+        seq = tp->seq;
+        barrier();
+        nsec = tp->base_nsec;
+        if (tp->tsc_mult != 0) {
+            nsec += mul_u64_u32_shr(rdtsc() - tp->base_tsc, tp->tsc_mult, tp->tsc_shift);
+        }
+        barrier();
+    } while ((seq & 1) || seq != tp->seq);
+    return nsec;
+}
+
+// timepage_ticks - the # of clock ticks since boot
+static inline uint64_t
+timepage_ticks(volatile struct timepage *tp) {
+    uint32_t seq;
+    uint64_t ticks;
+    do {
+        seq = tp->seq;
+        barrier();
+        ticks = tp->ticks;
+        barrier();
+    } while ((seq & 1) || seq != tp->seq);
+    return ticks;
+}
+
+#endif /* !__LIBS_TIMEPAGE_H__ */
+
@@ -0,0 +1,29 @@
+#ifndef __LIBS_TRACEEVENT_H__
+#define __LIBS_TRACEEVENT_H__
+
+#include <defs.h>
+
+/* the events of the kernel trace ring, as read from the "trace:" device */
+
+/* event ids, keep tools/tracedump.c in sync */
+#define TRACE_LOST                  0       // # of events overwritten before read (made by dev_trace)
+#define TRACE_SCHED_SWITCH          1       // prev pid, next pid, prev state
+#define TRACE_SCHED_WAKEUP          2       // pid, wait state
+#define TRACE_PGFAULT               3       // addr, error code
+#define TRACE_SFS_IO                4       // ino, offset, length, write
+#define TRACE_SYSCALL               5       // num, arg0, arg1, arg2
+#define TRACE_NID                   6
+
+#define TRACE_NARG                  4
+
+/* an event in the trace ring, 32 bytes */
+struct trace_event {
+    uint64_t time;                          // clock_nsec
+    uint16_t cpu;
+    uint16_t id;
+    int32_t pid;                            // the current process, -1 if none
+    uint32_t args[TRACE_NARG];
+};
+
+#endif /* !__LIBS_TRACEEVENT_H__ */
+
@@ -0,0 +1,15 @@
+#ifndef __LIBS_UIO_H__
+#define __LIBS_UIO_H__
+
+#include <defs.h>
+
+#define UIO_MAXIOV          16          // max # of segments of a readv/writev
+
+/* a segment of a readv/writev */
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+
+#endif /* !__LIBS_UIO_H__ */
+
@@ -12,23 +12,33 @@
 #define SYS_yield           10
 #define SYS_sleep           11
 #define SYS_kill            12
+#define SYS_futex           13
 #define SYS_gettime         17
 #define SYS_getpid          18
+#define SYS_schedstat       19
 #define SYS_mmap            20
 #define SYS_munmap          21
 #define SYS_shmem           22
 #define SYS_putc            30
 #define SYS_pgdir           31
+#define SYS_cputs           32
+#define SYS_sysenter        33
+#define SYS_perf            34
+#define SYS_batch           40
 #define SYS_open            100
 #define SYS_close           101
 #define SYS_read            102
 #define SYS_write           103
+#define SYS_readv           105
+#define SYS_writev          106
 #define SYS_seek            104
 #define SYS_fstat           110
 #define SYS_fsync           111
 #define SYS_getcwd          121
 #define SYS_getdirentry     128
 #define SYS_dup             130
+#define SYS_pipe            140
+#define SYS_mkfifo          141
 /* OLNY FOR LAB6 */
 #define SYS_lab6_set_priority 255
 
@@ -37,6 +47,19 @@
 #define CLONE_THREAD        0x00000200  // thread group
 #define CLONE_FS            0x00000800  // set if shared between processes
 
+/* SYS_mmap/SYS_shmem flags */
+#define MMAP_WRITE          0x00000100  // the mapping is writable
+#define MMAP_STACK          0x00000200  // the mapping is used as a stack
+
+/* SYS_futex operations */
+#define FUTEX_WAIT          1           // sleep if the word is still the value given
+#define FUTEX_WAKE          2           // wake up to the # given of the waiters
+
+/* SYS_perf commands */
+#define PERF_START          1           // drop the old samples and start sampling
+#define PERF_STOP           2           // stop sampling
+#define PERF_REPORT         3           // print the samples by function
+
 /* VFS flags */
 // flags for open: choose one of these
 #define O_RDONLY            0           // open for reading only
@@ -20,6 +20,15 @@
 
 #define barrier() __asm__ __volatile__ ("" ::: "memory")
 
+/* CPUID.01H:EDX feature bits */
+#define CPUID_FEAT_TSC              0x00000010  // time stamp counter
+#define CPUID_FEAT_SEP              0x00000800  // sysenter/sysexit
+
+/* model specific registers */
+#define MSR_IA32_SYSENTER_CS        0x174
+#define MSR_IA32_SYSENTER_ESP       0x175
+#define MSR_IA32_SYSENTER_EIP       0x176
+
 static inline uint8_t inb(uint16_t port) __attribute__((always_inline));
 static inline uint16_t inw(uint16_t port) __attribute__((always_inline));
 static inline void insl(uint32_t port, void *addr, int cnt) __attribute__((always_inline));
@@ -50,6 +59,10 @@ static inline uintptr_t rcr1(void) __attribute__((always_inline));
 static inline uintptr_t rcr2(void) __attribute__((always_inline));
 static inline uintptr_t rcr3(void) __attribute__((always_inline));
 static inline void invlpg(void *addr) __attribute__((always_inline));
+static inline void cpuid(uint32_t info, uint32_t *eaxp, uint32_t *ebxp, uint32_t *ecxp, uint32_t *edxp) __attribute__((always_inline));
+static inline uint64_t rdmsr(uint32_t msr) __attribute__((always_inline));
+static inline void wrmsr(uint32_t msr, uint64_t val) __attribute__((always_inline));
+static inline uint64_t rdtsc(void) __attribute__((always_inline));
 
 static inline uint8_t
 inb(uint16_t port) {
@@ -208,6 +221,37 @@ invlpg(void *addr) {
     asm volatile ("invlpg (%0)" :: "r" (addr) : "memory");
 }
 
+static inline void
+cpuid(uint32_t info, uint32_t *eaxp, uint32_t *ebxp, uint32_t *ecxp, uint32_t *edxp) {
+    uint32_t eax, ebx, ecx, edx;
+    asm volatile ("cpuid"
+            : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+            : "a" (info));
+    if (eaxp != NULL) *eaxp = eax;
+    if (ebxp != NULL) *ebxp = ebx;
+    if (ecxp != NULL) *ecxp = ecx;
+    if (edxp != NULL) *edxp = edx;
+}
+
+static inline uint64_t
+rdmsr(uint32_t msr) {
+    uint64_t val;
+    asm volatile ("rdmsr" : "=A" (val) : "c" (msr));
+    return val;
+}
+
+static inline void
+wrmsr(uint32_t msr, uint64_t val) {
+    asm volatile ("wrmsr" :: "c" (msr), "A" (val));
+}
+
+static inline uint64_t
+rdtsc(void) {
+    uint64_t tsc;
+    asm volatile ("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
 static inline int __strcmp(const char *s1, const char *s2) __attribute__((always_inline));
 static inline char *__strcpy(char *dst, const char *src) __attribute__((always_inline));
 static inline void *__memset(void *s, char c, size_t n) __attribute__((always_inline));
@@ -11,6 +11,8 @@
 #include <sys/types.h>
 #include <errno.h>
 #include <assert.h>
+#include <ftw.h>
+#include <pthread.h>
 
 typedef int bool;
 
@@ -55,6 +57,24 @@ hash64(uint64_t val) {
     return __hash32((uint32_t)val, HASH_SHIFT);
 }
 
+/* FNV-1a, for file contents and path names */
+#define FNV64_OFFSET                            0xcbf29ce484222325ULL
+#define FNV64_PRIME                             0x100000001b3ULL
+
+static uint64_t
+fnv64(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *p = data;
+    while (len -- > 0) {
+        hash = (hash ^ *p ++) * FNV64_PRIME;
+    }
+    return hash;
+}
+
+static uint32_t
+hash_str(const char *str) {
+    return hash64(fnv64(FNV64_OFFSET, str, strlen(str)));
+}
+
 void *
 safe_malloc(size_t size) {
     void *ret;
@@ -123,6 +143,50 @@ safe_fchdir(int fd) {
 #define SFS_BLKN_SUPER                          0
 #define SFS_BLKN_ROOT                           1
 #define SFS_BLKN_FREEMAP                        2
+#define SFS_JOURNAL_MAGIC                       0x4a4e4c21
+#define SFS_JOURNAL_NBLKS                       64
+
+/*
+ * Incremental build.
+ *
+ * After each build, <img>.idx records the data blocks of every regular file put
+ * into the image, with its size, mtime and content hash. The next build over the
+ * same (untouched) image reserves all of those blocks first:
+ *   - a file with the same path, size and mtime keeps its blocks and is not read;
+ *   - a file with the same content as before (by hash), at its old path or moved
+ *     from a path that is gone, keeps the blocks of the old one;
+ *   - any other file is written over the old blocks of its path, then new ones.
+ * Metadata is allocated from the other blocks in (sorted) tree order, so it lands
+ * at the same place when the tree is the same. write_block skips the blocks whose
+ * content on disk is already right, so only what changed is written. The files
+ * that have to be read are loaded by a pool of threads before the tree is built.
+ */
+#define MKSFS_INDEX_MAGIC                       0x78646973              // "sidx"
+#define MKSFS_MAX_THREADS                       8
+
+/* states of a block in sfs_fs->map */
+#define MAP_FREE                                0
+#define MAP_USED                                1
+#define MAP_RESERVED                            2                       // used by a file in the index
+#define MAP_SHARED                              3                       // used by more than one file in the index
+
+struct file_record {
+    char *path;
+    uint64_t size, hash;
+    int64_t mtime;
+    uint32_t nblks;
+    uint32_t *blocks;
+    bool present;                               // the path is still in the tree
+    bool claimed;                               // the blocks are taken by the new image
+    struct file_record *hash_next, *next;
+};
+
+struct file_data {
+    char *path;
+    uint64_t size, hash;
+    char *data;
+    struct file_data *hash_next;
+};
 
 struct cache_block {
     uint32_t ino;
@@ -144,6 +208,7 @@ struct cache_inode {
     uint32_t ino;
     uint32_t nblks;
     struct cache_block *l1, *l2;
+    struct file_record *rec;
     struct cache_inode *hash_next;
 };
 
@@ -153,16 +218,25 @@ struct sfs_fs {
         uint32_t blocks;
         uint32_t unused_blocks;
         char info[SFS_MAX_INFO_LEN + 1];
+        uint32_t journal;
+        uint32_t journal_blocks;
     } super;
     struct subpath {
         struct subpath *next, *prev;
         char *subname;
     } __sp_nil, *sp_root, *sp_end;
-    int imgfd;
+    int imgfd, homefd;
     uint32_t ninos, next_ino;
+    uint8_t *map;
     struct cache_inode *root;
     struct cache_inode *inodes[HASH_LIST_SIZE];
     struct cache_block *blocks[HASH_LIST_SIZE];
+    struct file_record *records[HASH_LIST_SIZE];    // index of the old image
+    struct file_record *old_list, *new_list, **new_tail;
+    struct file_data *loaded[HASH_LIST_SIZE];
+    struct file_data **load_list;
+    uint32_t nload, load_next;
+    uint32_t nfiles, nreused, nwritten, nskipped;
 };
 
 struct sfs_entry {
@@ -172,9 +246,12 @@ struct sfs_entry {
 
 static uint32_t
 sfs_alloc_ino(struct sfs_fs *sfs) {
-    if (sfs->next_ino < sfs->ninos) {
-        sfs->super.unused_blocks --;
-        return sfs->next_ino ++;
+    while (sfs->next_ino < sfs->ninos) {
+        uint32_t ino = sfs->next_ino ++;
+        if (sfs->map[ino] == MAP_FREE) {
+            sfs->map[ino] = MAP_USED;
+            return ino;
+        }
     }
     bug("out of disk space.\n");
 }
@@ -202,7 +279,7 @@ static struct cache_inode *
 alloc_cache_inode(struct sfs_fs *sfs, ino_t real, uint32_t ino, uint16_t type) {
     struct cache_inode *ci = safe_malloc(sizeof(struct cache_inode));
     ci->ino = (ino != 0) ? ino : sfs_alloc_ino(sfs);
-    ci->real = real, ci->nblks = 0, ci->l1 = ci->l2 = NULL;
+    ci->real = real, ci->nblks = 0, ci->l1 = ci->l2 = NULL, ci->rec = NULL;
     struct inode *inode = &(ci->inode);
     memset(inode, 0, sizeof(struct inode));
     inode->type = type;
@@ -229,17 +306,21 @@ create_sfs(int imgfd) {
         warn("img file is too big (%llu bytes, only use %u blocks).\n",
                 (unsigned long long)stat->st_size, ninos);
     }
-    if ((next_ino = SFS_BLKN_FREEMAP + (ninos + SFS_BLKBITS - 1) / SFS_BLKBITS) >= ninos) {
-        bug("img file is too small (%llu bytes, %u blocks, bitmap use at least %u blocks).\n",
+    uint32_t journal = SFS_BLKN_FREEMAP + (ninos + SFS_BLKBITS - 1) / SFS_BLKBITS;
+    if ((next_ino = journal + SFS_JOURNAL_NBLKS) >= ninos) {
+        bug("img file is too small (%llu bytes, %u blocks, bitmap and journal use at least %u blocks).\n",
                 (unsigned long long)stat->st_size, ninos, next_ino - 2);
     }
 
     struct sfs_fs *sfs = safe_malloc(sizeof(struct sfs_fs));
     sfs->super.magic = SFS_MAGIC;
-    sfs->super.blocks = ninos, sfs->super.unused_blocks = ninos - next_ino;
+    sfs->super.blocks = ninos, sfs->super.unused_blocks = 0;
+    sfs->super.journal = journal, sfs->super.journal_blocks = SFS_JOURNAL_NBLKS;
     snprintf(sfs->super.info, SFS_MAX_INFO_LEN, "simple file system");
 
-    sfs->ninos = ninos, sfs->next_ino = next_ino, sfs->imgfd = imgfd;
+    sfs->ninos = ninos, sfs->next_ino = next_ino, sfs->imgfd = imgfd, sfs->homefd = -1;
+    sfs->map = memset(safe_malloc(ninos), MAP_FREE, ninos);
+    memset(sfs->map, MAP_USED, next_ino);
     sfs->sp_root = sfs->sp_end = &(sfs->__sp_nil);
     sfs->sp_end->prev = sfs->sp_end->next = NULL;
 
@@ -247,7 +328,12 @@ create_sfs(int imgfd) {
     for (i = 0; i < HASH_LIST_SIZE; i ++) {
         sfs->inodes[i] = NULL;
         sfs->blocks[i] = NULL;
+        sfs->records[i] = NULL;
+        sfs->loaded[i] = NULL;
     }
+    sfs->old_list = sfs->new_list = NULL, sfs->new_tail = &(sfs->new_list);
+    sfs->load_list = NULL, sfs->nload = sfs->load_next = 0;
+    sfs->nfiles = sfs->nreused = sfs->nwritten = sfs->nskipped = 0;
 
     sfs->root = alloc_cache_inode(sfs, 0, SFS_BLKN_ROOT, SFS_TYPE_DIR);
     return sfs;
@@ -284,19 +370,53 @@ subpath_show(FILE *fout, struct sfs_fs *sfs, const char *name) {
     fprintf(fout, "\n");
 }
 
+#define open_bug(sfs, name, ...)                                                        \
+    do {                                                                                \
+        subpath_show(stderr, sfs, name);                                                \
+        bug(__VA_ARGS__);                                                               \
+    } while (0)
+
+#define show_fullpath(sfs, name) subpath_show(stderr, sfs, name)
+
+/* path of name in the current directory, relative to home */
+static char *
+subpath_join(struct sfs_fs *sfs, const char *name) {
+    static char buffer[PATH_MAX];
+    struct subpath *subpath = sfs->sp_root;
+    size_t len = 0;
+    buffer[0] = '\0';
+    while ((subpath = subpath->next) != NULL) {
+        len += snprintf(buffer + len, sizeof(buffer) - len, "%s/", subpath->subname);
+        if (len >= sizeof(buffer)) {
+            open_bug(sfs, name, "path is too long.\n");
+        }
+    }
+    if (snprintf(buffer + len, sizeof(buffer) - len, "%s", name) >= sizeof(buffer) - len) {
+        open_bug(sfs, name, "path is too long.\n");
+    }
+    return buffer;
+}
+
+/* write a block, unless the image has the same content there already */
 static void
 write_block(struct sfs_fs *sfs, void *data, size_t len, uint32_t ino) {
     assert(len <= SFS_BLKSIZE && ino < sfs->ninos);
-    static char buffer[SFS_BLKSIZE];
+    static char buffer[SFS_BLKSIZE], ondisk[SFS_BLKSIZE];
     if (len != SFS_BLKSIZE) {
         memset(buffer, 0, sizeof(buffer));
         data = memcpy(buffer, data, len);
     }
     off_t offset = (off_t)ino * SFS_BLKSIZE;
     ssize_t ret;
+    if (pread(sfs->imgfd, ondisk, SFS_BLKSIZE, offset) == SFS_BLKSIZE
+            && memcmp(ondisk, data, SFS_BLKSIZE) == 0) {
+        sfs->nskipped ++;
+        return;
+    }
     if ((ret = pwrite(sfs->imgfd, data, SFS_BLKSIZE, offset)) != SFS_BLKSIZE) {
         bug("write %u block failed: (%d/%d).\n", ino, (int)ret, SFS_BLKSIZE);
     }
+    sfs->nwritten ++;
 }
 
 static void
@@ -313,25 +433,34 @@ void
 close_sfs(struct sfs_fs *sfs) {
     static char buffer[SFS_BLKSIZE];
     uint32_t i, j, ino = SFS_BLKN_FREEMAP;
-    uint32_t ninos = sfs->ninos, next_ino = sfs->next_ino;
+    uint32_t ninos = sfs->ninos;
+    // the reserved blocks not taken by any file are free now
     for (i = 0; i < ninos; ino ++, i += SFS_BLKBITS) {
         memset(buffer, 0, sizeof(buffer));
-        if (i + SFS_BLKBITS > next_ino) {
-            uint32_t start = 0, end = SFS_BLKBITS;
-            if (i < next_ino) {
-                start = next_ino - i;
-            }
-            if (i + SFS_BLKBITS > ninos) {
-                end = ninos - i;
-            }
-            uint32_t *data = (uint32_t *)buffer;
-            const uint32_t bits = sizeof(bits) * CHAR_BIT;
-            for (j = start; j < end; j ++) {
+        uint32_t end = SFS_BLKBITS;
+        if (i + SFS_BLKBITS > ninos) {
+            end = ninos - i;
+        }
+        uint32_t *data = (uint32_t *)buffer;
+        const uint32_t bits = sizeof(bits) * CHAR_BIT;
+        for (j = 0; j < end; j ++) {
+            if (sfs->map[i + j] != MAP_USED) {
                 data[j / bits] |= (1 << (j % bits));
+                sfs->super.unused_blocks ++;
             }
         }
         write_block(sfs, buffer, sizeof(buffer), ino);
     }
+
+    // empty journal: header first, then a zeroed log
+    memset(buffer, 0, sizeof(buffer));
+    for (i = 1; i < sfs->super.journal_blocks; i ++) {
+        write_block(sfs, buffer, sizeof(buffer), sfs->super.journal + i);
+    }
+    uint32_t *header = (uint32_t *)buffer;
+    header[0] = SFS_JOURNAL_MAGIC, header[1] = 1, header[2] = 0;
+    write_block(sfs, buffer, sizeof(buffer), sfs->super.journal);
+
     write_block(sfs, &(sfs->super), sizeof(sfs->super), SFS_BLKN_SUPER);
 
     for (i = 0; i < HASH_LIST_SIZE; i ++) {
@@ -355,22 +484,334 @@ open_img(const char *imgname) {
         bug("invalid .img file name '%s'.\n", imgname);
     }
     int imgfd;
-    if ((imgfd = open(imgname, O_WRONLY)) < 0) {
+    if ((imgfd = open(imgname, O_RDWR)) < 0) {
         bug("open '%s' failed.\n", imgname);
     }
     return create_sfs(imgfd);
 }
 
-#define open_bug(sfs, name, ...)                                                        \
-    do {                                                                                \
-        subpath_show(stderr, sfs, name);                                                \
-        bug(__VA_ARGS__);                                                               \
-    } while (0)
+static int64_t
+stat_mtime(const struct stat *stat) {
+    return (int64_t)stat->st_mtim.tv_sec * 1000000000 + stat->st_mtim.tv_nsec;
+}
 
-#define show_fullpath(sfs, name) subpath_show(stderr, sfs, name)
+struct index_header {
+    uint32_t magic;
+    uint32_t ninos;
+    uint64_t img_size, img_ino;
+    int64_t img_mtime;
+    uint32_t nrecords, unused;
+};
+
+static bool
+read_all(FILE *fin, void *data, size_t len) {
+    return len == 0 || fread(data, len, 1, fin) == 1;
+}
+
+static void
+write_all(FILE *fout, const void *data, size_t len) {
+    if (len != 0 && fwrite(data, len, 1, fout) != 1) {
+        bug("write index failed.\n");
+    }
+}
+
+static struct file_record *
+search_record(struct sfs_fs *sfs, const char *path) {
+    struct file_record *rec = sfs->records[hash_str(path)];
+    while (rec != NULL && strcmp(rec->path, path) != 0) {
+        rec = rec->hash_next;
+    }
+    return rec;
+}
+
+/* a record of the new image, its blocks are filled in by the caller */
+static struct file_record *
+new_record(struct sfs_fs *sfs, const char *path, uint64_t size, int64_t mtime, uint64_t hash) {
+    struct file_record *rec = safe_malloc(sizeof(struct file_record));
+    rec->path = safe_strdup(path);
+    rec->size = size, rec->mtime = mtime, rec->hash = hash;
+    rec->nblks = (size + SFS_BLKSIZE - 1) / SFS_BLKSIZE;
+    rec->blocks = safe_malloc(rec->nblks * sizeof(uint32_t) + 1);
+    rec->present = rec->claimed = 1;
+    rec->hash_next = rec->next = NULL;
+    *(sfs->new_tail) = rec, sfs->new_tail = &(rec->next);
+    return rec;
+}
+
+static struct file_record *
+read_record(struct sfs_fs *sfs, FILE *fin) {
+    uint32_t len, i, first = sfs->super.journal + SFS_JOURNAL_NBLKS;
+    struct file_record *rec = safe_malloc(sizeof(struct file_record));
+    if (!read_all(fin, &len, sizeof(len)) || len == 0 || len >= PATH_MAX) {
+        goto failed;
+    }
+    rec->path = safe_malloc(len + 1), rec->path[len] = '\0';
+    if (!read_all(fin, rec->path, len) || !read_all(fin, &(rec->size), sizeof(rec->size))
+            || !read_all(fin, &(rec->mtime), sizeof(rec->mtime)) || !read_all(fin, &(rec->hash), sizeof(rec->hash))
+            || !read_all(fin, &(rec->nblks), sizeof(rec->nblks))) {
+        goto failed;
+    }
+    if (rec->size > SFS_MAX_FILE_SIZE || rec->nblks != (rec->size + SFS_BLKSIZE - 1) / SFS_BLKSIZE) {
+        goto failed;
+    }
+    rec->blocks = safe_malloc(rec->nblks * sizeof(uint32_t) + 1);
+    if (!read_all(fin, rec->blocks, rec->nblks * sizeof(uint32_t))) {
+        goto failed;
+    }
+    for (i = 0; i < rec->nblks; i ++) {
+        if (rec->blocks[i] < first || rec->blocks[i] >= sfs->ninos) {
+            goto failed;
+        }
+    }
+    rec->present = rec->claimed = 0;
+    return rec;
+
+failed:
+    return NULL;
+}
+
+/*
+ * load_index - read the index of the last build, if it is for this very image (not
+ *              rewritten by dd or changed by ucore since), and reserve its blocks
+ */
+static void
+load_index(struct sfs_fs *sfs, const char *idxname) {
+    FILE *fin;
+    if ((fin = fopen(idxname, "rb")) == NULL) {
+        errno = 0;
+        return;
+    }
+    struct stat *stat = safe_fstat(sfs->imgfd);
+    struct index_header header;
+    if (!read_all(fin, &header, sizeof(header)) || header.magic != MKSFS_INDEX_MAGIC
+            || header.ninos != sfs->ninos || header.img_size != stat->st_size
+            || header.img_ino != stat->st_ino || header.img_mtime != stat_mtime(stat)) {
+        goto out;
+    }
+
+    struct file_record *list = NULL, *rec;
+    uint32_t i;
+    for (i = 0; i < header.nrecords; i ++) {
+        if ((rec = read_record(sfs, fin)) == NULL) {
+            warn("bad index '%s', build the whole image.\n", idxname);
+            goto out;
+        }
+        rec->next = list, list = rec;
+    }
+    for (rec = list; rec != NULL; rec = rec->next) {
+        struct file_record **head = sfs->records + hash_str(rec->path);
+        rec->hash_next = *head, *head = rec;
+        for (i = 0; i < rec->nblks; i ++) {
+            uint8_t *state = sfs->map + rec->blocks[i];
+            *state = (*state == MAP_FREE) ? MAP_RESERVED : MAP_SHARED;
+        }
+    }
+    // blocks of hard linked files are never reused, they are freed at last
+    for (rec = list; rec != NULL; rec = rec->next) {
+        for (i = 0; i < rec->nblks; i ++) {
+            if (sfs->map[rec->blocks[i]] == MAP_SHARED) {
+                rec->claimed = 1;
+                break;
+            }
+        }
+    }
+    sfs->old_list = list;
+
+out:
+    fclose(fin);
+}
+
+/* save_index - write the index of the new image, it's used only if complete */
+static void
+save_index(struct sfs_fs *sfs, const char *idxname) {
+    char tmpname[PATH_MAX];
+    if (snprintf(tmpname, sizeof(tmpname), "%s.tmp", idxname) >= sizeof(tmpname)) {
+        bug("index name is too long: %s\n", idxname);
+    }
+    FILE *fout;
+    if ((fout = fopen(tmpname, "wb")) == NULL) {
+        bug("open index '%s' failed.\n", tmpname);
+    }
+    struct stat *stat = safe_fstat(sfs->imgfd);
+    struct index_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MKSFS_INDEX_MAGIC, header.ninos = sfs->ninos;
+    header.img_size = stat->st_size, header.img_ino = stat->st_ino, header.img_mtime = stat_mtime(stat);
+
+    struct file_record *rec;
+    for (rec = sfs->new_list; rec != NULL; rec = rec->next) {
+        header.nrecords ++;
+    }
+    write_all(fout, &header, sizeof(header));
+    for (rec = sfs->new_list; rec != NULL; rec = rec->next) {
+        uint32_t len = strlen(rec->path);
+        write_all(fout, &len, sizeof(len));
+        write_all(fout, rec->path, len);
+        write_all(fout, &(rec->size), sizeof(rec->size));
+        write_all(fout, &(rec->mtime), sizeof(rec->mtime));
+        write_all(fout, &(rec->hash), sizeof(rec->hash));
+        write_all(fout, &(rec->nblks), sizeof(rec->nblks));
+        write_all(fout, rec->blocks, rec->nblks * sizeof(uint32_t));
+    }
+    if (fclose(fout) != 0 || rename(tmpname, idxname) != 0) {
+        bug("save index '%s' failed.\n", idxname);
+    }
+}
+
+/* the file is the one in the index, no need to read it */
+static bool
+record_unchanged(struct file_record *rec, const struct stat *stat) {
+    return !rec->claimed && rec->size == stat->st_size && rec->mtime == stat_mtime(stat);
+}
+
+/* take all blocks of rec for a file of the new image */
+static bool
+claim_record(struct sfs_fs *sfs, struct file_record *rec) {
+    uint32_t i;
+    if (rec->claimed) {
+        return 0;
+    }
+    for (i = 0; i < rec->nblks; i ++) {
+        assert(sfs->map[rec->blocks[i]] == MAP_RESERVED);
+        sfs->map[rec->blocks[i]] = MAP_USED;
+    }
+    rec->claimed = 1;
+    return 1;
+}
+
+/* a file of the index with the same content, whose path is gone */
+static struct file_record *
+search_moved(struct sfs_fs *sfs, struct file_data *fdata) {
+    struct file_record *rec;
+    for (rec = sfs->old_list; rec != NULL; rec = rec->next) {
+        if (!rec->present && !rec->claimed && rec->size == fdata->size && rec->hash == fdata->hash) {
+            return rec;
+        }
+    }
+    return NULL;
+}
+
+static struct file_data *
+search_loaded(struct sfs_fs *sfs, const char *path) {
+    struct file_data *fdata = sfs->loaded[hash_str(path)];
+    while (fdata != NULL && strcmp(fdata->path, path) != 0) {
+        fdata = fdata->hash_next;
+    }
+    return fdata;
+}
+
+static struct file_data *
+queue_file(struct sfs_fs *sfs, const char *path, uint64_t size) {
+    struct file_data *fdata = safe_malloc(sizeof(struct file_data));
+    fdata->path = safe_strdup(path), fdata->size = size;
+    fdata->hash = 0, fdata->data = NULL;
+    struct file_data **head = sfs->loaded + hash_str(path);
+    fdata->hash_next = *head, *head = fdata;
+    if ((sfs->nload & (sfs->nload - 1)) == 0) {
+        size_t n = (sfs->nload == 0) ? 1 : sfs->nload * 2;
+        if ((sfs->load_list = realloc(sfs->load_list, n * sizeof(struct file_data *))) == NULL) {
+            bug("realloc load list failed.\n");
+        }
+    }
+    sfs->load_list[sfs->nload ++] = fdata;
+    return fdata;
+}
+
+/* load_file - read a file of home into memory and hash it, may run in any thread */
+static void
+load_file(struct sfs_fs *sfs, struct file_data *fdata) {
+    int fd;
+    if ((fd = openat(sfs->homefd, fdata->path, O_RDONLY)) < 0) {
+        bug("open '%s' failed.\n", fdata->path);
+    }
+    size_t cap = fdata->size + 1, size = 0;
+    char *data = safe_malloc(cap);
+    ssize_t ret;
+    while ((ret = read(fd, data + size, cap - size)) > 0) {
+        if ((size += ret) == cap && (data = realloc(data, cap *= 2)) == NULL) {
+            bug("realloc %lu bytes failed.\n", (long unsigned)cap);
+        }
+    }
+    if (ret < 0) {
+        bug("read '%s' failed.\n", fdata->path);
+    }
+    close(fd);
+    fdata->data = data, fdata->size = size;
+    fdata->hash = fnv64(FNV64_OFFSET, data, size);
+}
+
+static void *
+load_worker(void *arg) {
+    struct sfs_fs *sfs = arg;
+    uint32_t i;
+    while ((i = __sync_fetch_and_add(&(sfs->load_next), 1)) < sfs->nload) {
+        load_file(sfs, sfs->load_list[i]);
+    }
+    return NULL;
+}
+
+static struct sfs_fs *walk_sfs;
+static size_t walk_prefix;
+
+static int
+prefetch_walk(const char *fpath, const struct stat *stat, int flag, struct FTW *ftw) {
+    struct sfs_fs *sfs = walk_sfs;
+    if (ftw->level == 0) {
+        walk_prefix = strlen(fpath);
+        return FTW_CONTINUE;
+    }
+    if (fpath[ftw->base] == '.') {
+        return (flag == FTW_D) ? FTW_SKIP_SUBTREE : FTW_CONTINUE;
+    }
+    if (flag != FTW_F || !S_ISREG(stat->st_mode)) {
+        return FTW_CONTINUE;
+    }
+    const char *path = fpath + walk_prefix;
+    while (*path == '/') {
+        path ++;
+    }
+    struct file_record *rec;
+    if ((rec = search_record(sfs, path)) != NULL) {
+        rec->present = 1;
+        if (record_unchanged(rec, stat)) {
+            return FTW_CONTINUE;
+        }
+    }
+    queue_file(sfs, path, stat->st_size);
+    return FTW_CONTINUE;
+}
+
+/*
+ * prefetch_files - find the files in home which are not in the index (or changed),
+ *                  and read them all with a pool of threads
+ */
+static void
+prefetch_files(struct sfs_fs *sfs, const char *home) {
+    walk_sfs = sfs;
+    if (nftw(home, prefetch_walk, 16, FTW_PHYS | FTW_ACTIONRETVAL) != 0) {
+        bug("walk home directory '%s' failed.\n", home);
+    }
+    long i, nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads > MKSFS_MAX_THREADS) {
+        nthreads = MKSFS_MAX_THREADS;
+    }
+    if (nthreads > sfs->nload) {
+        nthreads = sfs->nload;
+    }
+    pthread_t threads[MKSFS_MAX_THREADS];
+    for (i = 1; i < nthreads; i ++) {
+        if (pthread_create(threads + i, NULL, load_worker, sfs) != 0) {
+            bug("create thread failed.\n");
+        }
+    }
+    load_worker(sfs);
+    for (i = 1; i < nthreads; i ++) {
+        pthread_join(threads[i], NULL);
+    }
+}
 
 void open_dir(struct sfs_fs *sfs, struct cache_inode *current, struct cache_inode *parent);
-void open_file(struct sfs_fs *sfs, struct cache_inode *file, const char *filename, int fd);
+void open_file(struct sfs_fs *sfs, struct cache_inode *file, const char *filename, struct stat *stat);
 void open_link(struct sfs_fs *sfs, struct cache_inode *file, const char *filename);
 
 #define SFS_BLK_NENTRY                          (SFS_BLKSIZE / sizeof(uint32_t))
@@ -447,11 +888,17 @@ add_dir(struct sfs_fs *sfs, struct cache_inode *parent, const char *dirname, int
 }
 
 static void
-add_file(struct sfs_fs *sfs, struct cache_inode *current, const char *filename, int fd, ino_t real) {
+add_file(struct sfs_fs *sfs, struct cache_inode *current, const char *filename, struct stat *stat) {
     struct cache_inode *file;
-    if ((file = search_cache_inode(sfs, real)) == NULL) {
-        file = alloc_cache_inode(sfs, real, 0, SFS_TYPE_FILE);
-        open_file(sfs, file, filename, fd);
+    if ((file = search_cache_inode(sfs, stat->st_ino)) == NULL) {
+        file = alloc_cache_inode(sfs, stat->st_ino, 0, SFS_TYPE_FILE);
+        open_file(sfs, file, filename, stat);
+    }
+    else if (file->rec != NULL) {
+        // hard link, record the same blocks for this path
+        struct file_record *rec = file->rec;
+        rec = new_record(sfs, subpath_join(sfs, filename), rec->size, rec->mtime, rec->hash);
+        memcpy(rec->blocks, file->rec->blocks, rec->nblks * sizeof(uint32_t));
     }
     add_entry(sfs, current, file, filename);
 }
@@ -463,23 +910,29 @@ add_link(struct sfs_fs *sfs, struct cache_inode *current, const char *filename,
     add_entry(sfs, current, file, filename);
 }
 
+/* hidden files, and . and .. (added by open_dir) are skipped */
+static int
+entry_filter(const struct dirent *direntp) {
+    return direntp->d_name[0] != '.';
+}
+
+/* sort entries by name, so the layout only changes with the tree */
+static int
+entry_compare(const struct dirent **a, const struct dirent **b) {
+    return strcmp((*a)->d_name, (*b)->d_name);
+}
+
 void
 open_dir(struct sfs_fs *sfs, struct cache_inode *current, struct cache_inode *parent) {
-    DIR *dir;
-    if ((dir = opendir(".")) == NULL) {
+    struct dirent **namelist;
+    int i, n, curfd;
+    if ((curfd = open(".", O_RDONLY)) < 0 || (n = scandir(".", &namelist, entry_filter, entry_compare)) < 0) {
         open_bug(sfs, NULL, "opendir failed.\n");
     }
     add_entry(sfs, current, current, ".");
     add_entry(sfs, current, parent, "..");
-    struct dirent *direntp;
-    while ((direntp = readdir(dir)) != NULL) {
-        const char *name = direntp->d_name;
-        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
-            continue ;
-        }
-        if (name[0] == '.') {
-            continue ;
-        }
+    for (i = 0; i < n; i ++) {
+        const char *name = namelist[i]->d_name;
         if (strlen(name) > SFS_MAX_FNAME_LEN) {
             open_bug(sfs, NULL, "file name is too long: %s\n", name);
         }
@@ -487,46 +940,103 @@ open_dir(struct sfs_fs *sfs, struct cache_inode *current, struct cache_inode *pa
         if (S_ISLNK(stat->st_mode)) {
             add_link(sfs, current, name, stat->st_ino);
         }
-        else {
+        else if (S_ISDIR(stat->st_mode)) {
             int fd;
             if ((fd = open(name, O_RDONLY)) < 0) {
                 open_bug(sfs, NULL, "open failed: %s\n", name);
             }
-            if (S_ISDIR(stat->st_mode)) {
-                add_dir(sfs, current, name, dirfd(dir), fd, stat->st_ino);
-            }
-            else if (S_ISREG(stat->st_mode)) {
-                add_file(sfs, current, name, fd, stat->st_ino);
-            }
-            else {
-                char mode = '?';
-                if (S_ISFIFO(stat->st_mode)) mode = 'f';
-                if (S_ISSOCK(stat->st_mode)) mode = 's';
-                if (S_ISCHR(stat->st_mode)) mode = 'c';
-                if (S_ISBLK(stat->st_mode)) mode = 'b';
-                show_fullpath(sfs, NULL);
-                warn("unsupported mode %07x (%c): file %s\n", stat->st_mode, mode, name);
-            }
+            add_dir(sfs, current, name, curfd, fd, stat->st_ino);
             close(fd);
         }
+        else if (S_ISREG(stat->st_mode)) {
+            add_file(sfs, current, name, stat);
+        }
+        else {
+            char mode = '?';
+            if (S_ISFIFO(stat->st_mode)) mode = 'f';
+            if (S_ISSOCK(stat->st_mode)) mode = 's';
+            if (S_ISCHR(stat->st_mode)) mode = 'c';
+            if (S_ISBLK(stat->st_mode)) mode = 'b';
+            show_fullpath(sfs, NULL);
+            warn("unsupported mode %07x (%c): file %s\n", stat->st_mode, mode, name);
+        }
+        free(namelist[i]);
+    }
+    free(namelist);
+    close(curfd);
+}
+
+/* put the blocks of a file of the index into file, they are not written again */
+static void
+reuse_record(struct sfs_fs *sfs, struct cache_inode *file, struct file_record *from, const char *filename) {
+    uint64_t left = from->size;
+    uint32_t i;
+    for (i = 0; i < from->nblks; i ++) {
+        size_t size = (left < SFS_BLKSIZE) ? left : SFS_BLKSIZE;
+        append_block(sfs, file, size, from->blocks[i], filename);
+        left -= size;
     }
-    closedir(dir);
 }
 
 void
-open_file(struct sfs_fs *sfs, struct cache_inode *file, const char *filename, int fd) {
-    static char buffer[SFS_BLKSIZE];
-    ssize_t ret, last = SFS_BLKSIZE;
-    while ((ret = read(fd, buffer, sizeof(buffer))) != 0) {
-        assert(last == SFS_BLKSIZE);
-        uint32_t ino = sfs_alloc_ino(sfs);
-        write_block(sfs, buffer, ret, ino);
-        append_block(sfs, file, ret, ino, filename);
-        last = ret;
+open_file(struct sfs_fs *sfs, struct cache_inode *file, const char *filename, struct stat *stat) {
+    const char *path = subpath_join(sfs, filename);
+    int64_t mtime = stat_mtime(stat);
+    struct file_record *old = search_record(sfs, path), *from = NULL, *rec;
+    struct file_data *fdata = NULL;
+    sfs->nfiles ++;
+    if (old != NULL && record_unchanged(old, stat)) {
+        from = old;
     }
-    if (ret < 0) {
-        open_bug(sfs, filename, "read file failed.\n");
+    else {
+        if ((fdata = search_loaded(sfs, path)) == NULL || fdata->data == NULL) {
+            fdata = queue_file(sfs, path, stat->st_size);
+            load_file(sfs, fdata);
+        }
+        if (old != NULL && old->size == fdata->size && old->hash == fdata->hash) {
+            from = old;
+        }
+        else {
+            from = search_moved(sfs, fdata);
+        }
+    }
+    if (from != NULL && claim_record(sfs, from)) {
+        reuse_record(sfs, file, from, filename);
+        rec = new_record(sfs, path, from->size, mtime, from->hash);
+        memcpy(rec->blocks, from->blocks, rec->nblks * sizeof(uint32_t));
+        file->rec = rec, sfs->nreused ++;
+        return;
+    }
+    if (fdata == NULL) {
+        fdata = queue_file(sfs, path, stat->st_size);
+        load_file(sfs, fdata);
     }
+
+    // write the new content over the old blocks of this path first
+    bool inplace = (old != NULL && !old->claimed);
+    if (inplace) {
+        old->claimed = 1;
+    }
+    rec = new_record(sfs, path, fdata->size, mtime, fdata->hash);
+    uint64_t left = fdata->size;
+    uint32_t i;
+    for (i = 0; i < rec->nblks; i ++) {
+        size_t size = (left < SFS_BLKSIZE) ? left : SFS_BLKSIZE;
+        uint32_t ino;
+        if (inplace && i < old->nblks) {
+            ino = old->blocks[i];
+            assert(sfs->map[ino] == MAP_RESERVED);
+            sfs->map[ino] = MAP_USED;
+        }
+        else {
+            ino = sfs_alloc_ino(sfs);
+        }
+        write_block(sfs, fdata->data + (size_t)i * SFS_BLKSIZE, size, ino);
+        append_block(sfs, file, size, ino, filename);
+        rec->blocks[i] = ino, left -= size;
+    }
+    free(fdata->data), fdata->data = NULL;
+    file->rec = rec;
 }
 
 void
@@ -550,6 +1060,8 @@ create_img(struct sfs_fs *sfs, const char *home) {
     if ((homefd = open(home, O_RDONLY | O_NOFOLLOW)) < 0) {
         bug("open home directory '%s' failed.\n", home);
     }
+    sfs->homefd = homefd;
+    prefetch_files(sfs, home);
     safe_fchdir(homefd);
     open_dir(sfs, sfs->root, sfs->root);
     safe_fchdir(curfd);
@@ -569,14 +1081,29 @@ static_check(void) {
 int
 main(int argc, char **argv) {
     static_check();
+    bool full = 0;
+    if (argc == 4 && strcmp(argv[1], "-f") == 0) {
+        full = 1, argc --, argv ++;
+    }
     if (argc != 3) {
-        bug("usage: <input *.img> <input dirname>\n");
+        bug("usage: [-f] <input *.img> <input dirname>\n");
     }
     const char *imgname = argv[1], *home = argv[2];
-    if (create_img(open_img(imgname), home) != 0) {
+    char idxname[PATH_MAX];
+    if (snprintf(idxname, sizeof(idxname), "%s.idx", imgname) >= sizeof(idxname)) {
+        bug("img file name is too long: %s\n", imgname);
+    }
+
+    struct sfs_fs *sfs = open_img(imgname);
+    if (!full) {
+        load_index(sfs, idxname);
+    }
+    if (create_img(sfs, home) != 0) {
         bug("create img failed.\n");
     }
-    printf("create %s (%s) successfully.\n", imgname, home);
+    save_index(sfs, idxname);
+    printf("create %s (%s) successfully: %u files (%u reused), %u blocks written, %u unchanged.\n",
+            imgname, home, sfs->nfiles, sfs->nreused, sfs->nwritten, sfs->nskipped);
     return 0;
 }
 
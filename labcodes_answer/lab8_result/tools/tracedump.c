@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+/*
+ * tracedump - decode the kernel trace events printed by user/trace ("trace: "
+ * and 32 bytes in hex per line) from a console log, e.g.
+ *     tracedump < qemu.log
+ * The event layout and ids follow libs/traceevent.h.
+ */
+
+/* keep in sync with libs/traceevent.h */
+#define TRACE_LOST                  0
+#define TRACE_SCHED_SWITCH          1
+#define TRACE_SCHED_WAKEUP          2
+#define TRACE_PGFAULT               3
+#define TRACE_SFS_IO                4
+#define TRACE_SYSCALL               5
+
+#define TRACE_NARG                  4
+
+struct trace_event {
+    uint64_t time;
+    uint16_t cpu;
+    uint16_t id;
+    int32_t pid;
+    uint32_t args[TRACE_NARG];
+} __attribute__((packed));
+
+// print_event - the name and the arguments of ev, unknown ids in raw hex
+static void
+print_event(const struct trace_event *ev) {
+    uint32_t a[TRACE_NARG];
+    memcpy(a, ev->args, sizeof(a));
+    switch (ev->id) {
+    case TRACE_LOST:
+        printf("%-14s count=%u", "lost", a[0]);
+        break;
+    case TRACE_SCHED_SWITCH:
+        printf("%-14s prev=%d next=%d prev_state=%u", "sched_switch", (int)a[0], (int)a[1], a[2]);
+        break;
+    case TRACE_SCHED_WAKEUP:
+        printf("%-14s pid=%d wait_state=0x%x", "sched_wakeup", (int)a[0], a[1]);
+        break;
+    case TRACE_PGFAULT:
+        printf("%-14s addr=0x%08x error=0x%x", "pgfault", a[0], a[1]);
+        break;
+    case TRACE_SFS_IO:
+        printf("%-14s ino=%u offset=%u len=%u write=%u", "sfs_io", a[0], a[1], a[2], a[3]);
+        break;
+    case TRACE_SYSCALL:
+        printf("%-14s num=%u arg0=0x%x arg1=0x%x arg2=0x%x", "syscall", a[0], a[1], a[2], a[3]);
+        break;
+    default:
+        printf("event%-9u %x %x %x %x", ev->id, a[0], a[1], a[2], a[3]);
+    }
+    printf("\n");
+}
+
+static int
+parse(const char *hex, struct trace_event *ev) {
+    unsigned char *data = (unsigned char *)ev;
+    size_t i;
+    for (i = 0; i < sizeof(struct trace_event); i ++) {
+        unsigned int byte;
+        if (sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+            return -1;
+        }
+        data[i] = byte;
+    }
+    return 0;
+}
+
+int
+main(int argc, char **argv) {
+    char line[256];
+    uint64_t start = 0;
+    int first = 1;
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        char *hex = strstr(line, "trace: ");
+        struct trace_event ev;
+        if (hex == NULL || parse(hex + 7, &ev) != 0) {
+            continue;
+        }
+        if (ev.id == TRACE_LOST) {
+            printf("%14s %4s %5s ", "", "", "");
+            print_event(&ev);
+            continue;
+        }
+        if (first) {
+            start = ev.time, first = 0;
+        }
+        uint64_t nsec = ev.time - start;
+        printf("%7llu.%06llu cpu%u %5d ", (unsigned long long)(nsec / 1000000000),
+               (unsigned long long)(nsec % 1000000000 / 1000), ev.cpu, ev.pid);
+        print_event(&ev);
+    }
+    return 0;
+}
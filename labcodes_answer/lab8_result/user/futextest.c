@@ -0,0 +1,152 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <error.h>
+#include <unistd.h>
+#include <lock.h>
+
+#define NPROC                   4
+#define NLOOP                   20000
+#define NITEM                   1000
+#define NSLOT                   8
+#define NWAITER                 6
+
+// the priorities of the waiters in the order they block, and the order futex_wake must take them
+static const uint32_t wait_prio[NWAITER] = {1, 3, 2, 3, 1, 2};
+static const int wake_order[NWAITER] = {1, 3, 2, 5, 0, 4};
+
+/* shared by the processes through shmem */
+struct shared {
+    lock_t lock;
+    volatile int counter;
+    // bounded buffer on semaphores
+    usem_t empty, full;
+    lock_t buf_lock;
+    int slots[NSLOT];
+    int in, out;
+    // a flag guarded by lock and cond
+    cond_t cond;
+    volatile int ready;
+    // waiters of different priorities on one futex
+    volatile int turn;
+    volatile int nblocked, nwoken;
+    int woken[NWAITER];
+};
+
+static void
+wait_all(int *pids, int n) {
+    int i, exit_code;
+    for (i = 0; i < n; i ++) {
+        assert(waitpid(pids[i], &exit_code) == 0 && exit_code == 0);
+    }
+}
+
+int
+main(void) {
+    uintptr_t addr = 0;
+    int pids[NPROC], i, j;
+    assert(shmem(&addr, sizeof(struct shared), MMAP_WRITE) == 0);
+    struct shared *sh = (struct shared *)addr;
+    lock_init(&(sh->lock));
+    lock_init(&(sh->buf_lock));
+    usem_init(&(sh->empty), NSLOT);
+    usem_init(&(sh->full), 0);
+    cond_init(&(sh->cond));
+
+    // the futex calls fail without a waiter to sleep for, or on a bad address
+    assert(futex_wait(&(sh->counter), 1, 0) == -E_AGAIN);
+    assert(futex_wait(&(sh->counter), 0, 1) == -E_TIMEOUT);
+    assert(futex_wake(&(sh->counter), 1) == 0);
+    assert(futex_wake((int *)1, 1) == -E_INVAL);
+
+    // mutex
+    unsigned int time = clock_msec();
+    for (i = 0; i < NPROC; i ++) {
+        if ((pids[i] = fork()) == 0) {
+            for (j = 0; j < NLOOP; j ++) {
+                lock(&(sh->lock));
+                sh->counter ++;
+                unlock(&(sh->lock));
+            }
+            exit(0);
+        }
+        assert(pids[i] > 0);
+    }
+    wait_all(pids, NPROC);
+    assert(sh->counter == NPROC * NLOOP);
+    cprintf("mutex: %d locks in %d msecs.\n", NPROC * NLOOP, clock_msec() - time);
+
+    // producers and a consumer on semaphores
+    for (i = 0; i < NPROC; i ++) {
+        if ((pids[i] = fork()) == 0) {
+            for (j = 0; j < NITEM; j ++) {
+                usem_wait(&(sh->empty));
+                lock(&(sh->buf_lock));
+                sh->slots[sh->in ++ % NSLOT] = j;
+                unlock(&(sh->buf_lock));
+                usem_post(&(sh->full));
+            }
+            exit(0);
+        }
+        assert(pids[i] > 0);
+    }
+    int sum = 0;
+    for (i = 0; i < NPROC * NITEM; i ++) {
+        usem_wait(&(sh->full));
+        lock(&(sh->buf_lock));
+        sum += sh->slots[sh->out ++ % NSLOT];
+        unlock(&(sh->buf_lock));
+        usem_post(&(sh->empty));
+    }
+    wait_all(pids, NPROC);
+    assert(sum == NPROC * (NITEM * (NITEM - 1) / 2));
+
+    // condition variable
+    for (i = 0; i < NPROC; i ++) {
+        if ((pids[i] = fork()) == 0) {
+            lock(&(sh->lock));
+            while (!sh->ready) {
+                cond_wait(&(sh->cond), &(sh->lock));
+            }
+            unlock(&(sh->lock));
+            exit(0);
+        }
+        assert(pids[i] > 0);
+    }
+    sleep(2);
+    lock(&(sh->lock));
+    sh->ready = 1;
+    cond_broadcast(&(sh->cond));
+    unlock(&(sh->lock));
+    wait_all(pids, NPROC);
+
+    // wake one at a time: highest priority first, in blocking order within a priority
+    int wpids[NWAITER];
+    for (i = 0; i < NWAITER; i ++) {
+        if ((wpids[i] = fork()) == 0) {
+            lab6_set_priority(wait_prio[i]);
+            sh->nblocked ++;
+            assert(futex_wait(&(sh->turn), 0, 0) == 0);
+            sh->woken[sh->nwoken ++] = i;
+            exit(0);
+        }
+        assert(wpids[i] > 0);
+        while (sh->nblocked != i + 1) {
+            yield();
+        }
+        // let it get from nblocked into futex_wait before the next one blocks
+        sleep(2);
+    }
+    for (i = 0; i < NWAITER; i ++) {
+        sh->turn = i + 1;
+        assert(futex_wake(&(sh->turn), 1) == 1);
+        while (sh->nwoken != i + 1) {
+            yield();
+        }
+        assert(sh->woken[i] == wake_order[i]);
+    }
+    assert(futex_wake(&(sh->turn), 1) == 0);
+    wait_all(wpids, NWAITER);
+
+    cprintf("futextest pass.\n");
+    return 0;
+}
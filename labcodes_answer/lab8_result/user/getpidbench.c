@@ -0,0 +1,33 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <x86.h>
+
+#define LOOPS                   200000
+
+// bench - the average cost of getpid, in nanoseconds
+static unsigned int
+bench(void) {
+    uint64_t time = gettime_nsec();
+    int i;
+    for (i = 0; i < LOOPS; i ++) {
+        getpid();
+    }
+    time = gettime_nsec() - time;
+    do_div(time, LOOPS);
+    return (unsigned int)time;
+}
+
+int
+main(void) {
+    sys_use_sysenter(0);
+    cprintf("getpid by int $0x80: %d ns/call.\n", bench());
+    if (sys_use_sysenter(1)) {
+        cprintf("getpid by sysenter:  %d ns/call.\n", bench());
+    }
+    else {
+        cprintf("sysenter is not supported.\n");
+    }
+    cprintf("getpidbench pass.\n");
+    return 0;
+}
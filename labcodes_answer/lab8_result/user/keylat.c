@@ -0,0 +1,88 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <x86.h>
+#include <file.h>
+#include <unistd.h>
+
+/*
+ * Keystroke latency under load: a typist process writes a timestamp to a
+ * pipe once a tick, like a key pressed on the console, and an editor process
+ * blocked in read picks it up. NHOG processes spin all the time. The latency of
+ * a keystroke is the time from the write to the return of the read; under a
+ * scheduler that favours interactive processes it stays well below a tick
+ * whatever the spinning load.
+ */
+
+#define NHOG                    4
+#define NKEY                    200
+
+static void
+hog(void) {
+    volatile int j = 0;
+    while (1) {
+        j = !j;
+    }
+}
+
+static void
+typist(int fd) {
+    int i;
+    for (i = 0; i < NKEY; i ++) {
+        sleep(1);
+        uint64_t stamp = gettime_nsec();
+        assert(write(fd, &stamp, sizeof(stamp)) == sizeof(stamp));
+    }
+    close(fd);
+    exit(0);
+}
+
+// editor - read the keystrokes, exit with the average latency in usec
+static void
+editor(int fd) {
+    uint64_t stamp, total = 0, max = 0;
+    int n = 0, ret;
+    while ((ret = read(fd, &stamp, sizeof(stamp))) == sizeof(stamp)) {
+        uint64_t nsec = gettime_nsec() - stamp;
+        total += nsec, n ++;
+        if (nsec > max) {
+            max = nsec;
+        }
+    }
+    assert(ret == 0 && n == NKEY);
+    do_div(total, n * 1000);
+    do_div(max, 1000);
+    cprintf("editor: %d keystrokes, max latency %d us.\n", n, (int)max);
+    exit((int)total);
+}
+
+int
+main(void) {
+    int p[2], pids[NHOG], typist_pid, editor_pid, i, code;
+    for (i = 0; i < NHOG; i ++) {
+        if ((pids[i] = fork()) == 0) {
+            hog();
+        }
+        assert(pids[i] > 0);
+    }
+    assert(pipe(p) == 0);
+    if ((typist_pid = fork()) == 0) {
+        close(p[0]);
+        typist(p[1]);
+    }
+    assert(typist_pid > 0);
+    if ((editor_pid = fork()) == 0) {
+        close(p[1]);
+        editor(p[0]);
+    }
+    assert(editor_pid > 0);
+    close(p[0]), close(p[1]);
+
+    assert(waitpid(typist_pid, &code) == 0 && code == 0);
+    assert(waitpid(editor_pid, &code) == 0);
+    cprintf("editor: average latency %d us.\n", code);
+    for (i = 0; i < NHOG; i ++) {
+        assert(kill(pids[i]) == 0 && waitpid(pids[i], NULL) == 0);
+    }
+    cprintf("keylat pass.\n");
+    return 0;
+}
@@ -5,6 +5,7 @@
 #include <stat.h>
 #include <error.h>
 #include <unistd.h>
+#include <ulib.h>
 
 int
 open(const char *path, uint32_t open_flags) {
@@ -13,21 +14,37 @@ open(const char *path, uint32_t open_flags) {
 
 int
 close(int fd) {
+    fbuf_reset(fd);
     return sys_close(fd);
 }
 
 int
 read(int fd, void *base, size_t len) {
+    fflush_all();
     return sys_read(fd, base, len);
 }
 
 int
 write(int fd, void *base, size_t len) {
+    fflush(fd);
     return sys_write(fd, base, len);
 }
 
+int
+readv(int fd, const struct iovec *iov, int iovcnt) {
+    fflush_all();
+    return sys_readv(fd, iov, iovcnt);
+}
+
+int
+writev(int fd, const struct iovec *iov, int iovcnt) {
+    fflush(fd);
+    return sys_writev(fd, iov, iovcnt);
+}
+
 int
 seek(int fd, off_t pos, int whence) {
+    fflush(fd);
     return sys_seek(fd, pos, whence);
 }
 
@@ -38,14 +55,26 @@ fstat(int fd, struct stat *stat) {
 
 int
 fsync(int fd) {
+    fflush(fd);
     return sys_fsync(fd);
 }
 
 int
 dup2(int fd1, int fd2) {
+    fflush(fd1), fbuf_reset(fd2);
     return sys_dup(fd1, fd2);
 }
 
+int
+pipe(int *fd_store) {
+    return sys_pipe(fd_store);
+}
+
+int
+mkfifo(const char *name, uint32_t open_flags) {
+    return sys_mkfifo(name, open_flags);
+}
+
 static char
 transmode(struct stat *stat) {
     uint32_t mode = stat->st_mode;
@@ -54,6 +83,7 @@ transmode(struct stat *stat) {
     if (S_ISLNK(mode)) return 'l';
     if (S_ISCHR(mode)) return 'c';
     if (S_ISBLK(mode)) return 'b';
+    if (S_ISFIFO(mode)) return 'p';
     return '-';
 }
 
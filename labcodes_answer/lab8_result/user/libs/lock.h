@@ -5,38 +5,122 @@
 #include <atomic.h>
 #include <ulib.h>
 
+/*
+ * Locks on futexes: the fast paths are atomic instructions in user space,
+ * only a process that has to wait (or wake a waiter) enters the kernel.
+ * They work between threads and, in shared memory, between processes.
+ */
+
+/* lock_t - a mutex: 0 unlocked, 1 locked, 2 locked and maybe waited for */
 #define INIT_LOCK           {0}
 
-typedef volatile bool lock_t;
+typedef struct {
+    volatile int val;
+} lock_t;
 
 static inline void
 lock_init(lock_t *l) {
-    *l = 0;
+    l->val = 0;
 }
 
+/* try_lock - take the lock if it is free, returns whether it was already locked */
 static inline bool
 try_lock(lock_t *l) {
-    return test_and_set_bit(0, l);
+    return atomic_cmpxchg(&(l->val), 0, 1) != 0;
 }
 
 static inline void
 lock(lock_t *l) {
-    if (try_lock(l)) {
-        int step = 0;
-        do {
-            yield();
-            if (++ step == 100) {
-                step = 0;
-                sleep(10);
-            }
-        } while (try_lock(l));
+    int c;
+    if ((c = atomic_cmpxchg(&(l->val), 0, 1)) != 0) {
+        if (c != 2) {
+            c = atomic_xchg(&(l->val), 2);
+        }
+        while (c != 0) {
+            futex_wait(&(l->val), 2, 0);
+            c = atomic_xchg(&(l->val), 2);
+        }
     }
 }
 
 static inline void
 unlock(lock_t *l) {
-    test_and_clear_bit(0, l);
+    if (atomic_xchg(&(l->val), 0) == 2) {
+        futex_wake(&(l->val), 1);
+    }
 }
 
-#endif /* !__USER_LIBS_LOCK_H__ */
+/* cond_t - a condition variable, used with a lock_t */
+#define INIT_COND           {0}
+
+typedef struct {
+    volatile int seq;
+} cond_t;
 
+static inline void
+cond_init(cond_t *c) {
+    c->seq = 0;
+}
+
+/* cond_wait - unlock l, wait for a signal, and lock l again */
+static inline void
+cond_wait(cond_t *c, lock_t *l) {
+    int seq = c->seq;
+    unlock(l);
+    futex_wait(&(c->seq), seq, 0);
+    // other waiters may be woken with us, lock as contended
+    while (atomic_xchg(&(l->val), 2) != 0) {
+        futex_wait(&(l->val), 2, 0);
+    }
+}
+
+static inline void
+cond_signal(cond_t *c) {
+    fetch_and_add((volatile unsigned int *)&(c->seq), 1);
+    futex_wake(&(c->seq), 1);
+}
+
+static inline void
+cond_broadcast(cond_t *c) {
+    fetch_and_add((volatile unsigned int *)&(c->seq), 1);
+    futex_wake(&(c->seq), 0x7FFFFFFF);
+}
+
+/* usem_t - a counting semaphore */
+#define INIT_USEM(value)    {(value), 0}
+
+typedef struct {
+    volatile int count;
+    volatile int nwaiters;
+} usem_t;
+
+static inline void
+usem_init(usem_t *s, int value) {
+    s->count = value, s->nwaiters = 0;
+}
+
+static inline void
+usem_wait(usem_t *s) {
+    while (1) {
+        int c = s->count;
+        if (c > 0) {
+            if (atomic_cmpxchg(&(s->count), c, c - 1) == c) {
+                return;
+            }
+            continue;
+        }
+        fetch_and_add((volatile unsigned int *)&(s->nwaiters), 1);
+        futex_wait(&(s->count), 0, 0);
+        fetch_and_add((volatile unsigned int *)&(s->nwaiters), -1);
+    }
+}
+
+static inline void
+usem_post(usem_t *s) {
+    fetch_and_add((volatile unsigned int *)&(s->count), 1);
+    if (s->nwaiters != 0) {
+        futex_wake(&(s->count), 1);
+    }
+}
+
+#endif /* !__USER_LIBS_LOCK_H__ */
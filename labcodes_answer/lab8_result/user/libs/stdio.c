@@ -5,13 +5,158 @@
 #include <ulib.h>
 #include <unistd.h>
 
+/* *
+ * Buffered output.
+ *
+ * Each of the first FBUF_NFD fds has an output buffer that vprintfmt renders
+ * into. The console used by cprintf (NO_FD) shares the buffer of stdout, which
+ * is the console too unless redirected: the buffer remembers the fd of the bytes
+ * in it and is written out before bytes for the other one go in, so cprintf and
+ * fprintf(1, ...) come out in the order they were called. A buffer is written
+ * out with one syscall when it is full, at the end of a line if it is line
+ * buffered, at the end of each call if it is unbuffered, by fflush, and before a
+ * write to its fd. All buffers are flushed before read, fork, exec and exit, so
+ * a prompt shows up before the input it asks for.
+ * */
+
+#define FBUF_SIZE                       512
+#define FBUF_NFD                        8
+
+struct fbuf {
+    int mode;                   // _IOFBF, _IOLBF, _IONBF, or 0 for the default
+    int fd;                     // the fd the buffered bytes go to, NO_FD for the console
+    size_t len;                 // # of bytes buffered
+    char buf[FBUF_SIZE];
+};
+
+static struct fbuf fbufs[FBUF_NFD];
+
+// fd2fbuf - the buffer of fd, NULL if fd is not buffered; the console shares stdout's
+static struct fbuf *
+fd2fbuf(int fd) {
+    if (fd == NO_FD) {
+        fd = 1;
+    }
+    if (fd >= 0 && fd < FBUF_NFD) {
+        return fbufs + fd;
+    }
+    return NULL;
+}
+
+// fbuf_mode - the console and stdout are line buffered by default, other fds fully buffered
+static int
+fbuf_mode(int fd, struct fbuf *fb) {
+    if (fb->mode != 0) {
+        return fb->mode;
+    }
+    return (fd == NO_FD || fd == 1) ? _IOLBF : _IOFBF;
+}
+
+// fbuf_write - write out the bytes buffered in fb
+static int
+fbuf_write(struct fbuf *fb) {
+    int ret = 0;
+    size_t pos = 0;
+    if (fb->fd == NO_FD) {
+        ret = sys_cputs(fb->buf, fb->len);
+    }
+    else {
+        while (pos < fb->len) {
+            if ((ret = sys_write(fb->fd, fb->buf + pos, fb->len - pos)) <= 0) {
+                break;
+            }
+            pos += ret, ret = 0;
+        }
+    }
+    fb->len = 0;
+    return ret;
+}
+
+// fbuf_putc - buffer c for fd, and write the buffer out if it is full or the line ends
+static void
+fbuf_putc(int fd, char c) {
+    struct fbuf *fb;
+    if ((fb = fd2fbuf(fd)) == NULL) {
+        sys_write(fd, &c, sizeof(char));
+        return;
+    }
+    if (fb->len != 0 && fb->fd != fd) {
+        fbuf_write(fb);
+    }
+    fb->fd = fd;
+    fb->buf[fb->len ++] = c;
+    if (fb->len == FBUF_SIZE || (c == '\n' && fbuf_mode(fd, fb) == _IOLBF)) {
+        fbuf_write(fb);
+    }
+}
+
+// fbuf_end - called at the end of each output call, an unbuffered fd is written out now
+static void
+fbuf_end(int fd) {
+    struct fbuf *fb;
+    if ((fb = fd2fbuf(fd)) != NULL && fb->len != 0 && fbuf_mode(fd, fb) == _IONBF) {
+        fbuf_write(fb);
+    }
+}
+
+/* *
+ * fflush - write out the output buffered for @fd (NO_FD for the console)
+ * */
+int
+fflush(int fd) {
+    struct fbuf *fb;
+    if ((fb = fd2fbuf(fd)) != NULL && fb->len != 0) {
+        return fbuf_write(fb);
+    }
+    return 0;
+}
+
+/* *
+ * fflush_all - write out the output buffered for all fds and the console
+ * */
+void
+fflush_all(void) {
+    int fd;
+    for (fd = 0; fd < FBUF_NFD; fd ++) {
+        fflush(fd);
+    }
+}
+
+/* *
+ * setvbuf - set the buffering @mode of @fd to _IOFBF, _IOLBF or _IONBF,
+ * the output buffered so far is written out first
+ * */
+int
+setvbuf(int fd, int mode) {
+    struct fbuf *fb;
+    if ((fb = fd2fbuf(fd)) == NULL || (mode != _IOFBF && mode != _IOLBF && mode != _IONBF)) {
+        return -1;
+    }
+    fflush(fd);
+    fb->mode = mode;
+    return 0;
+}
+
+/* *
+ * fbuf_reset - @fd is closed (or reopened by dup2), write out its buffer and
+ * fall back to the default mode
+ * */
+void
+fbuf_reset(int fd) {
+    struct fbuf *fb;
+    if ((fb = fd2fbuf(fd)) != NULL) {
+        fflush(fd);
+        fb->mode = 0;
+    }
+}
+
 /* *
  * cputch - writes a single character @c to stdout, and it will
  * increace the value of counter pointed by @cnt.
  * */
 static void
 cputch(int c, int *cnt) {
-    sys_putc(c);
+    fbuf_putc(NO_FD, c);
     (*cnt) ++;
 }
 
@@ -28,6 +173,7 @@ int
 vcprintf(const char *fmt, va_list ap) {
     int cnt = 0;
     vprintfmt((void*)cputch, NO_FD, &cnt, fmt, ap);
+    fbuf_end(NO_FD);
     return cnt;
 }
 
@@ -60,13 +206,14 @@ cputs(const char *str) {
         cputch(c, &cnt);
     }
     cputch('\n', &cnt);
+    fbuf_end(NO_FD);
     return cnt;
 }
 
 
 static void
 fputch(char c, int *cnt, int fd) {
-    write(fd, &c, sizeof(char));
+    fbuf_putc(fd, c);
     (*cnt) ++;
 }
 
@@ -74,6 +221,7 @@ int
 vfprintf(int fd, const char *fmt, va_list ap) {
     int cnt = 0;
     vprintfmt((void*)fputch, fd, &cnt, fmt, ap);
+    fbuf_end(fd);
     return cnt;
 }
 
@@ -8,6 +8,12 @@
 
 #define MAX_ARGS            5
 
+int sysenter_call(int num, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4);
+extern char sysenter_return[];
+
+// syscalls go through sysenter instead of int $T_SYSCALL, see sys_use_sysenter
+static bool use_sysenter = 0;
+
 static inline int
 syscall(int num, ...) {
     va_list ap;
@@ -19,6 +25,10 @@ syscall(int num, ...) {
     }
     va_end(ap);
 
+    if (use_sysenter) {
+        return sysenter_call(num, a[0], a[1], a[2], a[3], a[4]);
+    }
+
     asm volatile (
         "int %1;"
         : "=a" (ret)
@@ -33,6 +43,18 @@ syscall(int num, ...) {
     return ret;
 }
 
+/* sys_use_sysenter - make syscalls through sysenter if enable is set and the kernel
+ * supports it, otherwise through int $T_SYSCALL. Returns whether sysenter is used.
+ */
+bool
+sys_use_sysenter(bool enable) {
+    use_sysenter = 0;
+    if (enable && syscall(SYS_sysenter, sysenter_return) == 0) {
+        use_sysenter = 1;
+    }
+    return use_sysenter;
+}
+
 int
 sys_exit(int error_code) {
     return syscall(SYS_exit, error_code);
@@ -63,6 +85,21 @@ sys_getpid(void) {
     return syscall(SYS_getpid);
 }
 
+int
+sys_futex(volatile int *uaddr, int op, int val, unsigned int timeout) {
+    return syscall(SYS_futex, uaddr, op, val, timeout);
+}
+
+int
+sys_perf(int cmd) {
+    return syscall(SYS_perf, cmd);
+}
+
+int
+sys_schedstat(int pid, struct schedstat *stat) {
+    return syscall(SYS_schedstat, pid, stat);
+}
+
 int
 sys_putc(int c) {
     return syscall(SYS_putc, c);
@@ -79,6 +116,11 @@ sys_lab6_set_priority(uint32_t priority)
     syscall(SYS_lab6_set_priority, priority);
 }
 
+int
+sys_cputs(const char *str, size_t len) {
+    return syscall(SYS_cputs, str, len);
+}
+
 int
 sys_sleep(unsigned int time) {
     return syscall(SYS_sleep, time);
@@ -89,6 +131,21 @@ sys_gettime(void) {
     return syscall(SYS_gettime);
 }
 
+int
+sys_mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags, int fd, off_t offset) {
+    return syscall(SYS_mmap, addr_store, len, mmap_flags, fd, offset);
+}
+
+int
+sys_munmap(uintptr_t addr, size_t len) {
+    return syscall(SYS_munmap, addr, len);
+}
+
+int
+sys_shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags) {
+    return syscall(SYS_shmem, addr_store, len, mmap_flags);
+}
+
 int
 sys_exec(const char *name, int argc, const char **argv) {
     return syscall(SYS_exec, name, argc, argv);
@@ -114,6 +171,16 @@ sys_write(int fd, void *base, size_t len) {
     return syscall(SYS_write, fd, base, len);
 }
 
+int
+sys_readv(int fd, const struct iovec *iov, int iovcnt) {
+    return syscall(SYS_readv, fd, iov, iovcnt);
+}
+
+int
+sys_writev(int fd, const struct iovec *iov, int iovcnt) {
+    return syscall(SYS_writev, fd, iov, iovcnt);
+}
+
 int
 sys_seek(int fd, off_t pos, int whence) {
     return syscall(SYS_seek, fd, pos, whence);
@@ -143,3 +210,18 @@ int
 sys_dup(int fd1, int fd2) {
     return syscall(SYS_dup, fd1, fd2);
 }
+
+int
+sys_pipe(int *fd_store) {
+    return syscall(SYS_pipe, fd_store);
+}
+
+int
+sys_mkfifo(const char *name, uint32_t open_flags) {
+    return syscall(SYS_mkfifo, name, open_flags);
+}
+
+int
+sys_batch(struct sysreq *reqs, int nreqs) {
+    return syscall(SYS_batch, reqs, nreqs);
+}
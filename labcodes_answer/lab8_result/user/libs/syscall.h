@@ -1,31 +1,48 @@
 #ifndef __USER_LIBS_SYSCALL_H__
 #define __USER_LIBS_SYSCALL_H__
 
+bool sys_use_sysenter(bool enable);
 int sys_exit(int error_code);
 int sys_fork(void);
 int sys_wait(int pid, int *store);
 int sys_exec(const char *name, int argc, const char **argv);
 int sys_yield(void);
 int sys_kill(int pid);
+int sys_futex(volatile int *uaddr, int op, int val, unsigned int timeout);
 int sys_getpid(void);
 int sys_putc(int c);
+int sys_cputs(const char *str, size_t len);
 int sys_pgdir(void);
+int sys_perf(int cmd);
 int sys_sleep(unsigned int time);
 size_t sys_gettime(void);
+int sys_mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags, int fd, off_t offset);
+int sys_munmap(uintptr_t addr, size_t len);
+int sys_shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
 
 struct stat;
 struct dirent;
+struct iovec;
+struct sysreq;
+struct schedstat;
+
+int sys_schedstat(int pid, struct schedstat *stat);
 
 int sys_open(const char *path, uint32_t open_flags);
 int sys_close(int fd);
 int sys_read(int fd, void *base, size_t len);
 int sys_write(int fd, void *base, size_t len);
+int sys_readv(int fd, const struct iovec *iov, int iovcnt);
+int sys_writev(int fd, const struct iovec *iov, int iovcnt);
 int sys_seek(int fd, off_t pos, int whence);
 int sys_fstat(int fd, struct stat *stat);
 int sys_fsync(int fd);
 int sys_getcwd(char *buffer, size_t len);
 int sys_getdirentry(int fd, struct dirent *dirent);
 int sys_dup(int fd1, int fd2);
+int sys_pipe(int *fd_store);
+int sys_mkfifo(const char *name, uint32_t open_flags);
+int sys_batch(struct sysreq *reqs, int nreqs);
 void sys_lab6_set_priority(uint32_t priority); //only for lab6
 
 
@@ -1,10 +1,13 @@
 #include <defs.h>
 #include <syscall.h>
+#include <unistd.h>
 #include <stdio.h>
 #include <ulib.h>
 #include <stat.h>
 #include <string.h>
 #include <lock.h>
+#include <x86.h>
+#include <timepage.h>
 
 static lock_t fork_lock = INIT_LOCK;
 
@@ -20,6 +23,7 @@ unlock_fork(void) {
 
 void
 exit(int error_code) {
+    fflush_all();
     sys_exit(error_code);
     cprintf("BUG: exit failed.\n");
     while (1);
@@ -27,6 +31,7 @@ exit(int error_code) {
 
 int
 fork(void) {
+    fflush_all();
     return sys_fork();
 }
 
@@ -50,6 +55,18 @@ kill(int pid) {
     return sys_kill(pid);
 }
 
+// futex_wait - sleep while *uaddr is val, at most timeout ticks (0: no limit)
+int
+futex_wait(volatile int *uaddr, int val, unsigned int timeout) {
+    return sys_futex(uaddr, FUTEX_WAIT, val, timeout);
+}
+
+// futex_wake - wake up at most n processes waiting on uaddr
+int
+futex_wake(volatile int *uaddr, int n) {
+    return sys_futex(uaddr, FUTEX_WAKE, n, 0);
+}
+
 int
 getpid(void) {
     return sys_getpid();
@@ -61,6 +78,11 @@ print_pgdir(void) {
     sys_pgdir();
 }
 
+int
+perf(int cmd) {
+    return sys_perf(cmd);
+}
+
 void
 lab6_set_priority(uint32_t priority)
 {
@@ -72,9 +94,49 @@ sleep(unsigned int time) {
     return sys_sleep(time);
 }
 
+// gettime_nsec - nsec since boot, read from the time page without a syscall
+uint64_t
+gettime_nsec(void) {
+    return timepage_nsec((volatile struct timepage *)UTIMEPAGE);
+}
+
+int
+schedstat(int pid, struct schedstat *stat) {
+    return sys_schedstat(pid, stat);
+}
+
+// gettime_msec - clock ticks since boot, as SYS_gettime, read from the time page
 unsigned int
 gettime_msec(void) {
-    return (unsigned int)sys_gettime();
+    return (unsigned int)timepage_ticks((volatile struct timepage *)UTIMEPAGE);
+}
+
+// clock_msec - real msec since boot, from gettime_nsec
+unsigned int
+clock_msec(void) {
+    uint64_t nsec = gettime_nsec();
+    do_div(nsec, NSEC_PER_MSEC);
+    return (unsigned int)nsec;
+}
+
+int
+sysbatch(struct sysreq *reqs, int nreqs) {
+    return sys_batch(reqs, nreqs);
+}
+
+int
+mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags, int fd, off_t offset) {
+    return sys_mmap(addr_store, len, mmap_flags, fd, offset);
+}
+
+int
+munmap(uintptr_t addr, size_t len) {
+    return sys_munmap(addr, len);
+}
+
+int
+shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags) {
+    return sys_shmem(addr_store, len, mmap_flags);
 }
 
 int
@@ -83,5 +145,6 @@ __exec(const char *name, const char **argv) {
     while (argv[argc] != NULL) {
         argc ++;
     }
+    fflush_all();
     return sys_exec(name, argc, argv);
 }
@@ -23,7 +23,16 @@ void __noreturn __panic(const char *file, int line, const char *fmt, ...);
 #define static_assert(x)                                \
     switch (x) { case 0: case (x): ; }
 
+/* buffering modes of setvbuf */
+#define _IOFBF                                          1   // fully buffered
+#define _IOLBF                                          2   // line buffered
+#define _IONBF                                          3   // unbuffered
+
 int fprintf(int fd, const char *fmt, ...);
+int fflush(int fd);
+void fflush_all(void);
+int setvbuf(int fd, int mode);
+void fbuf_reset(int fd);
 
 void __noreturn exit(int error_code);
 int fork(void);
@@ -31,10 +40,22 @@ int wait(void);
 int waitpid(int pid, int *store);
 void yield(void);
 int kill(int pid);
+int futex_wait(volatile int *uaddr, int val, unsigned int timeout);
+int futex_wake(volatile int *uaddr, int n);
 int getpid(void);
+struct schedstat;
+int schedstat(int pid, struct schedstat *stat);
 void print_pgdir(void);
+int perf(int cmd);
 int sleep(unsigned int time);
 unsigned int gettime_msec(void);
+uint64_t gettime_nsec(void);
+unsigned int clock_msec(void);
+struct sysreq;
+int sysbatch(struct sysreq *reqs, int nreqs);
+int mmap(uintptr_t *addr_store, size_t len, uint32_t mmap_flags, int fd, off_t offset);
+int munmap(uintptr_t addr, size_t len);
+int shmem(uintptr_t *addr_store, size_t len, uint32_t mmap_flags);
 int __exec(const char *name, const char **argv);
 
 #define __exec0(name, path, ...)                \
@@ -2,6 +2,7 @@
 #include <unistd.h>
 #include <file.h>
 #include <stat.h>
+#include <syscall.h>
 
 int main(int argc, char *argv[]);
 
@@ -21,6 +22,7 @@ initfd(int fd2, const char *path, uint32_t open_flags) {
 
 void
 umain(int argc, char *argv[]) {
+    sys_use_sysenter(1);
     int fd;
     if ((fd = initfd(0, "stdin:", O_RDONLY)) < 0) {
         warn("open <stdin> failed: %e.\n", fd);
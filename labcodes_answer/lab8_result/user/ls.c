@@ -5,6 +5,7 @@
 #include <file.h>
 #include <stat.h>
 #include <dirent.h>
+#include <sysreq.h>
 #include <unistd.h>
 
 #define printf(...)                     fprintf(1, __VA_ARGS__)
@@ -21,15 +22,19 @@ getmode(uint32_t st_mode) {
     return mode;
 }
 
+// getstat - open, fstat and close name with one SYS_batch
 static int
 getstat(const char *name, struct stat *stat) {
-    int fd, ret;
-    if ((fd = open(name, O_RDONLY)) < 0) {
-        return fd;
+    struct sysreq reqs[3] = {
+        {SYS_open,  0,             {(uint32_t)name, O_RDONLY}},
+        {SYS_fstat, SYSREQ_RET(0), {0, (uint32_t)stat}},
+        {SYS_close, SYSREQ_RET(0), {0}},
+    };
+    int ret;
+    if ((ret = sysbatch(reqs, 3)) < 0) {
+        return ret;
     }
-    ret = fstat(fd, stat);
-    close(fd);
-    return ret;
+    return (reqs[0].ret < 0) ? reqs[0].ret : reqs[1].ret;
 }
 
 void
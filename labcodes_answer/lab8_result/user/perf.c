@@ -0,0 +1,48 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define printf(...)                     fprintf(1, __VA_ARGS__)
+
+static void
+usage(void) {
+    printf("usage: perf start|stop|report\n");
+    printf("       perf run <path> [args...]\n");
+}
+
+// perf_run - profile the program path while it runs
+static int
+perf_run(const char **argv) {
+    int pid, exit_code;
+    perf(PERF_START);
+    if ((pid = fork()) == 0) {
+        exit(__exec(NULL, argv));
+    }
+    if (pid > 0) {
+        waitpid(pid, &exit_code);
+    }
+    perf(PERF_STOP);
+    if (pid < 0) {
+        return pid;
+    }
+    return perf(PERF_REPORT);
+}
+
+int
+main(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "start") == 0) {
+        return perf(PERF_START);
+    }
+    if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+        return perf(PERF_STOP);
+    }
+    if (argc == 2 && strcmp(argv[1], "report") == 0) {
+        return perf(PERF_REPORT);
+    }
+    if (argc >= 3 && strcmp(argv[1], "run") == 0) {
+        return perf_run((const char **)argv + 2);
+    }
+    usage();
+    return -1;
+}
@@ -0,0 +1,87 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <string.h>
+#include <file.h>
+#include <error.h>
+#include <unistd.h>
+
+#define BUFSIZE                 4096
+#define TOTAL                   (4 * 1024 * 1024)
+
+static char buffer[BUFSIZE];
+
+static void
+fill(char *buf, int off, int len) {
+    int i;
+    for (i = 0; i < len; i ++) {
+        buf[i] = (char)((off + i) * 7);
+    }
+}
+
+static void
+producer(int fd) {
+    int off, ret;
+    for (off = 0; off < TOTAL; off += BUFSIZE) {
+        fill(buffer, off, BUFSIZE);
+        if ((ret = write(fd, buffer, BUFSIZE)) != BUFSIZE) {
+            panic("producer: write returns %d\n", ret);
+        }
+    }
+    close(fd);
+    exit(0);
+}
+
+static void
+consumer(int fd) {
+    static char expect[BUFSIZE];
+    int off = 0, ret;
+    while ((ret = read(fd, buffer, BUFSIZE)) > 0) {
+        fill(expect, off, ret);
+        assert(memcmp(buffer, expect, ret) == 0);
+        off += ret;
+    }
+    assert(ret == 0 && off == TOTAL);
+}
+
+int
+main(void) {
+    int p[2], pid, exit_code;
+    unsigned int time;
+
+    // anonymous pipe: a producer/consumer pipeline between two processes
+    assert(pipe(p) == 0);
+    time = clock_msec();
+    if ((pid = fork()) == 0) {
+        close(p[0]);
+        producer(p[1]);
+    }
+    assert(pid > 0);
+    close(p[1]);
+    consumer(p[0]);
+    close(p[0]);
+    assert(waitpid(pid, &exit_code) == 0 && exit_code == 0);
+    time = clock_msec() - time;
+    cprintf("pipe: %d KB in %d msecs.\n", TOTAL / 1024, time);
+
+    // the write end of a pipe without readers is broken
+    assert(pipe(p) == 0);
+    close(p[0]);
+    assert(write(p[1], buffer, 1) == -E_PIPE);
+    close(p[1]);
+
+    // named pipe
+    int rfd, wfd;
+    assert((rfd = mkfifo("pipetest", O_RDONLY)) >= 0);
+    if ((pid = fork()) == 0) {
+        assert((wfd = mkfifo("pipetest", O_WRONLY)) >= 0);
+        producer(wfd);
+    }
+    assert(pid > 0);
+    consumer(rfd);
+    close(rfd);
+    assert(waitpid(pid, &exit_code) == 0 && exit_code == 0);
+
+    cprintf("pipetest pass.\n");
+    return 0;
+}
+
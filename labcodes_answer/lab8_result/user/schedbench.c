@@ -0,0 +1,72 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <x86.h>
+
+/*
+ * Mixed interactive/batch load: NBATCH processes spin for RUN_MSEC while an
+ * interactive process sleeps for one tick at a time. A fair scheduler runs
+ * the interactive process as soon as it wakes up, whatever the batch load.
+ */
+
+#define NBATCH                  4
+#define RUN_MSEC                2000
+#define TICK_NSEC               10000000
+
+static void
+batch(void) {
+    unsigned int time = clock_msec();
+    int loops = 0;
+    volatile int j = 0;
+    while (clock_msec() - time < RUN_MSEC) {
+        int i;
+        for (i = 0; i < 1000; i ++) {
+            j = !j;
+        }
+        loops ++;
+    }
+    exit(loops);
+}
+
+// interactive - exit with the average latency of a wakeup, in usec
+static void
+interactive(void) {
+    unsigned int time = clock_msec();
+    uint64_t total = 0, max = 0;
+    int n = 0;
+    while (clock_msec() - time < RUN_MSEC) {
+        uint64_t nsec = gettime_nsec();
+        sleep(1);
+        nsec = gettime_nsec() - nsec;
+        nsec = (nsec > TICK_NSEC) ? nsec - TICK_NSEC : 0;
+        total += nsec, n ++;
+        if (nsec > max) {
+            max = nsec;
+        }
+    }
+    do_div(total, n * 1000);
+    do_div(max, 1000);
+    cprintf("interactive: %d wakeups, max latency %d us.\n", n, (int)max);
+    exit((int)total);
+}
+
+int
+main(void) {
+    int pids[NBATCH + 1], i, code;
+    for (i = 0; i <= NBATCH; i ++) {
+        if ((pids[i] = fork()) == 0) {
+            if (i == NBATCH) {
+                interactive();
+            }
+            batch();
+        }
+        assert(pids[i] > 0);
+    }
+    for (i = 0; i < NBATCH; i ++) {
+        assert(waitpid(pids[i], &code) == 0);
+        cprintf("batch %d: %d loops.\n", i, code);
+    }
+    assert(waitpid(pids[NBATCH], &code) == 0);
+    cprintf("interactive: average latency %d us.\n", code);
+    cprintf("schedbench pass.\n");
+    return 0;
+}
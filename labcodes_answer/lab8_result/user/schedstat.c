@@ -0,0 +1,58 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <string.h>
+#include <x86.h>
+#include <schedstat.h>
+
+#define printf(...)                     fprintf(1, __VA_ARGS__)
+
+// usec - nsec to usec
+static unsigned int
+usec(uint64_t nsec) {
+    do_div(nsec, 1000);
+    return (unsigned int)nsec;
+}
+
+static void
+print_hist(const char *name, uint32_t *hist) {
+    int i;
+    printf("%s:", name);
+    for (i = 0; i < SCHEDSTAT_NBUCKET; i ++) {
+        printf(" %u", hist[i]);
+    }
+    printf("\n");
+}
+
+// print_schedstat - print the scheduler accounting of pid (0: all processes), times in usec
+static int
+print_schedstat(int pid) {
+    struct schedstat stat;
+    int ret;
+    if ((ret = schedstat(pid, &stat)) != 0) {
+        printf("schedstat %d: %e.\n", pid, ret);
+        return ret;
+    }
+    printf("%s %d: run %u us, wait %u us, sleep %u us\n", (pid == 0) ? "all" : "pid", pid,
+           usec(stat.run_nsec), usec(stat.wait_nsec), usec(stat.sleep_nsec));
+    printf("  %u switches, %u preempted, %u wakeups, max latency %u us\n",
+           stat.nswitch, stat.npreempt, stat.nwakeup, usec(stat.max_latency_nsec));
+    print_hist("  wakeup latency (log2 usec)", stat.latency_hist);
+    if (pid == 0) {
+        print_hist("  runnable procs at tick", stat.nrunnable_hist);
+    }
+    return 0;
+}
+
+int
+main(int argc, char **argv) {
+    if (argc == 1) {
+        return print_schedstat(0);
+    }
+    int i, ret;
+    for (i = 1; i < argc; i ++) {
+        if ((ret = print_schedstat(strtol(argv[i], NULL, 10))) != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <string.h>
+#include <file.h>
+#include <unistd.h>
+
+#define NPAGES                  16
+#define PGSIZE                  4096
+
+int
+main(void) {
+    uintptr_t addr;
+    int pid, exit_code, i;
+
+    // anonymous memory is zeroed, and gone after munmap
+    addr = 0;
+    assert(mmap(&addr, NPAGES * PGSIZE, MMAP_WRITE, -1, 0) == 0 && addr != 0);
+    volatile int *anon = (int *)addr;
+    for (i = 0; i < NPAGES * PGSIZE / sizeof(int); i ++) {
+        assert(anon[i] == 0);
+        anon[i] = i;
+    }
+    // unmap the middle of the range, then the rest of it
+    assert(munmap(addr + PGSIZE, PGSIZE * 2) == 0);
+    assert(anon[0] == 0 && anon[PGSIZE * 3 / sizeof(int)] == PGSIZE * 3 / sizeof(int));
+    assert(munmap(addr, NPAGES * PGSIZE) == 0);
+
+    // shared memory is seen by parent and child
+    addr = 0;
+    assert(shmem(&addr, NPAGES * PGSIZE, MMAP_WRITE) == 0 && addr != 0);
+    volatile int *shared = (int *)addr;
+    if ((pid = fork()) == 0) {
+        for (i = 0; i < NPAGES; i ++) {
+            shared[i * PGSIZE / sizeof(int)] = i + 1;
+        }
+        exit(0);
+    }
+    assert(pid > 0 && waitpid(pid, &exit_code) == 0 && exit_code == 0);
+    for (i = 0; i < NPAGES; i ++) {
+        assert(shared[i * PGSIZE / sizeof(int)] == i + 1);
+    }
+    assert(munmap(addr, NPAGES * PGSIZE) == 0);
+
+    // a file mapping reads the file on page fault
+    int fd;
+    assert((fd = open("sh", O_RDONLY)) >= 0);
+    char head[4];
+    assert(read(fd, head, sizeof(head)) == sizeof(head));
+    addr = 0;
+    assert(mmap(&addr, PGSIZE * 2, 0, fd, 0) == 0 && addr != 0);
+    close(fd);
+    assert(memcmp((void *)addr, head, sizeof(head)) == 0);
+    assert(munmap(addr, PGSIZE * 2) == 0);
+
+    cprintf("shmemtest pass.\n");
+    return 0;
+}
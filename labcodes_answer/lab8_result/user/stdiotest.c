@@ -0,0 +1,66 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <string.h>
+#include <file.h>
+#include <unistd.h>
+
+/*
+ * Order of buffered output: bytes written by cprintf, fprintf and write must
+ * come out in the order of the calls, whatever is still sitting in a buffer.
+ */
+
+#define BUFSIZE                 64
+
+// check_pipe - fd 1 redirected to a pipe: fprintf and write interleave, cprintf stays on the console
+static void
+check_pipe(void) {
+    static char buf[BUFSIZE];
+    int p[2], pid, len = 0, ret, code;
+    assert(pipe(p) == 0);
+    if ((pid = fork()) == 0) {
+        close(p[0]);
+        assert(dup2(p[1], 1) == 1);
+        close(p[1]);
+        assert(setvbuf(1, _IOFBF) == 0);
+        fprintf(1, "a");
+        cprintf("stdiotest: console ");
+        assert(write(1, "b", 1) == 1);
+        fprintf(1, "c");
+        cprintf("stays on the console.\n");
+        fprintf(1, "d\n");
+        exit(0);
+    }
+    assert(pid > 0);
+    close(p[1]);
+    while ((ret = read(p[0], buf + len, BUFSIZE - 1 - len)) > 0) {
+        len += ret;
+    }
+    close(p[0]);
+    buf[len] = '\0';
+    assert(waitpid(pid, &code) == 0 && code == 0);
+    assert(strcmp(buf, "abcd\n") == 0);
+}
+
+int
+main(void) {
+    int pid, code;
+
+    // fd 1 and the console share one buffer, this must print "stdiotest: order abc."
+    cprintf("stdiotest: order a");
+    fprintf(1, "b");
+    cprintf("c");
+    fprintf(1, ".\n");
+
+    check_pipe();
+
+    // the buffer is written out before exec, hello prints its line after ours
+    if ((pid = fork()) == 0) {
+        cprintf("stdiotest: before exec, ");
+        exit(exec("/hello"));
+    }
+    assert(pid > 0);
+    assert(waitpid(pid, &code) == 0 && code == 0);
+
+    cprintf("stdiotest pass.\n");
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <x86.h>
+
+/*
+ * Timer accuracy across one-shots of the clock: sleep(n) must take n ticks
+ * (less one for the part of the tick it starts in), on an idle cpu and next to
+ * a spinning process, and the tick count must not drift from the TSC clock.
+ */
+
+#define MSEC_PER_TICK           10
+#define SPIN_TICKS              300
+
+// msec_since - real msec since nsec, from gettime_nsec
+static int
+msec_since(uint64_t nsec) {
+    nsec = gettime_nsec() - nsec;
+    do_div(nsec, 1000000);
+    return (int)nsec;
+}
+
+static void
+check_sleep(unsigned int n) {
+    uint64_t nsec = gettime_nsec();
+    sleep(n);
+    int msec = msec_since(nsec);
+    cprintf("sleep(%d): %d msecs.\n", n, msec);
+    assert(msec >= (int)(n - 1) * MSEC_PER_TICK && msec <= (int)(n + 2) * MSEC_PER_TICK);
+}
+
+// check_drift - the ticks counted over many short sleeps keep up with real time
+static void
+check_drift(const char *what) {
+    unsigned int ticks = gettime_msec();
+    uint64_t nsec = gettime_nsec();
+    int i;
+    for (i = 0; i < 20; i ++) {
+        sleep(1 + i % 7);
+    }
+    int dticks = gettime_msec() - ticks, msec = msec_since(nsec);
+    cprintf("%s: %d ticks in %d msecs.\n", what, dticks, msec);
+    assert(dticks * MSEC_PER_TICK >= msec - 2 * MSEC_PER_TICK
+            && dticks * MSEC_PER_TICK <= msec + 2 * MSEC_PER_TICK);
+}
+
+int
+main(void) {
+    unsigned int n;
+    for (n = 1; n <= 64; n *= 4) {
+        check_sleep(n);
+    }
+    check_drift("idle");
+
+    // a spinning process runs on one-shots for its time_slice
+    int pid, exit_code;
+    if ((pid = fork()) == 0) {
+        unsigned int start = gettime_msec();
+        while (gettime_msec() - start < SPIN_TICKS) {
+            /* spin */ ;
+        }
+        exit(0);
+    }
+    assert(pid > 0);
+    check_sleep(5);
+    check_drift("busy");
+    assert(waitpid(pid, &exit_code) == 0 && exit_code == 0);
+
+    cprintf("ticktest pass.\n");
+    return 0;
+}
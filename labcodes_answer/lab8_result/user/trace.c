@@ -0,0 +1,72 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <string.h>
+#include <file.h>
+#include <unistd.h>
+#include <traceevent.h>
+
+#define printf(...)                     fprintf(1, __VA_ARGS__)
+
+#define TRACE_BATCH                     32
+
+/*
+ * trace <mask> <path> [args...] - run a program with the tracepoints in mask
+ * enabled, then print the events of the trace ring in hex, one per line, for
+ * tools/tracedump on the host.
+ */
+
+static struct trace_event events[TRACE_BATCH];
+
+static int
+set_mask(int fd, uint32_t mask) {
+    int ret;
+    if ((ret = write(fd, &mask, sizeof(uint32_t))) < 0) {
+        return ret;
+    }
+    return fflush(fd);
+}
+
+// dump - print (or only drop if !print) all events in the ring
+static int
+dump(int fd, bool print) {
+    int ret, i, j;
+    while ((ret = read(fd, events, sizeof(events))) > 0) {
+        for (i = 0; print && i < ret / sizeof(struct trace_event); i ++) {
+            unsigned char *data = (unsigned char *)(events + i);
+            printf("trace: ");
+            for (j = 0; j < sizeof(struct trace_event); j ++) {
+                printf("%02x", data[j]);
+            }
+            printf("\n");
+        }
+    }
+    return ret;
+}
+
+int
+main(int argc, char **argv) {
+    if (argc < 3) {
+        printf("usage: trace <mask> <path> [args...]\n");
+        return -1;
+    }
+    int fd, ret, pid, exit_code;
+    if ((fd = open("trace:", O_RDWR)) < 0) {
+        return fd;
+    }
+    setvbuf(fd, _IONBF);
+    dump(fd, 0);
+    if ((ret = set_mask(fd, strtol(argv[1], NULL, 0))) != 0) {
+        goto out;
+    }
+    if ((pid = fork()) == 0) {
+        exit(__exec(NULL, (const char **)argv + 2));
+    }
+    if (pid > 0) {
+        waitpid(pid, &exit_code);
+    }
+    set_mask(fd, 0);
+    ret = dump(fd, 1);
+out:
+    close(fd);
+    return ret;
+}
@@ -0,0 +1,50 @@
+#include <ulib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PAGE                    4096
+#define NPAGES                  256
+
+static char bss[NPAGES * PAGE];
+
+int
+main(void) {
+    int i, pid, exit_code;
+    unsigned int time;
+
+    // reading untouched BSS maps the shared zero page
+    time = clock_msec();
+    for (i = 0; i < NPAGES * PAGE; i += PAGE) {
+        assert(bss[i] == 0 && bss[i + PAGE - 1] == 0);
+    }
+    time = clock_msec() - time;
+    cprintf("zero: read %d pages in %d msecs.\n", NPAGES, time);
+
+    // a child writing the zero page gets a private copy
+    if ((pid = fork()) == 0) {
+        for (i = 0; i < NPAGES * PAGE; i += PAGE) {
+            bss[i] = 1;
+        }
+        exit(0);
+    }
+    assert(pid > 0);
+    assert(waitpid(pid, &exit_code) == 0 && exit_code == 0);
+    for (i = 0; i < NPAGES * PAGE; i += PAGE) {
+        assert(bss[i] == 0);
+    }
+
+    // the first write replaces the zero page with a pre-zeroed one
+    time = clock_msec();
+    for (i = 0; i < NPAGES * PAGE; i += PAGE) {
+        bss[i] = (char)i;
+    }
+    time = clock_msec() - time;
+    cprintf("zero: wrote %d pages in %d msecs.\n", NPAGES, time);
+    for (i = 0; i < NPAGES * PAGE; i ++) {
+        assert(bss[i] == ((i % PAGE) ? 0 : (char)i));
+    }
+
+    cprintf("zerotest pass.\n");
+    return 0;
+}
+